@@ -403,6 +403,7 @@ static int nullb_apply_poll_queues(struct nullb_device *dev,
 
 NULLB_DEVICE_ATTR(size, ulong, NULL);
 NULLB_DEVICE_ATTR(completion_nsec, ulong, NULL);
+NULLB_DEVICE_ATTR(poll_delay_nsec, ulong, NULL);
 NULLB_DEVICE_ATTR(submit_queues, uint, nullb_apply_submit_queues);
 NULLB_DEVICE_ATTR(poll_queues, uint, nullb_apply_poll_queues);
 NULLB_DEVICE_ATTR(home_node, uint, NULL);
@@ -427,6 +428,10 @@ NULLB_DEVICE_ATTR(zone_max_active, uint, NULL);
 NULLB_DEVICE_ATTR(virt_boundary, bool, NULL);
 NULLB_DEVICE_ATTR(no_sched, bool, NULL);
 NULLB_DEVICE_ATTR(shared_tag_bitmap, bool, NULL);
+NULLB_DEVICE_ATTR(model, bool, NULL);
+NULLB_DEVICE_ATTR(model_channels, uint, NULL);
+NULLB_DEVICE_ATTR(model_rw_penalty, uint, NULL);
+NULLB_DEVICE_ATTR(model_flush_nsec, ulong, NULL);
 
 static ssize_t nullb_device_power_show(struct config_item *item, char *page)
 {
@@ -523,6 +528,40 @@ static ssize_t nullb_device_badblocks_store(struct config_item *item,
 }
 CONFIGFS_ATTR(nullb_device_, badblocks);
 
+static ssize_t nullb_device_model_read_lat_show(struct config_item *item,
+						char *page)
+{
+	return null_model_dist_show(&to_nullb_device(item)->model_read, page);
+}
+
+static ssize_t nullb_device_model_read_lat_store(struct config_item *item,
+						 const char *page, size_t count)
+{
+	struct nullb_device *dev = to_nullb_device(item);
+
+	if (test_bit(NULLB_DEV_FL_CONFIGURED, &dev->flags))
+		return -EBUSY;
+	return null_model_dist_store(&dev->model_read, page, count);
+}
+CONFIGFS_ATTR(nullb_device_, model_read_lat);
+
+static ssize_t nullb_device_model_write_lat_show(struct config_item *item,
+						 char *page)
+{
+	return null_model_dist_show(&to_nullb_device(item)->model_write, page);
+}
+
+static ssize_t nullb_device_model_write_lat_store(struct config_item *item,
+						  const char *page, size_t count)
+{
+	struct nullb_device *dev = to_nullb_device(item);
+
+	if (test_bit(NULLB_DEV_FL_CONFIGURED, &dev->flags))
+		return -EBUSY;
+	return null_model_dist_store(&dev->model_write, page, count);
+}
+CONFIGFS_ATTR(nullb_device_, model_write_lat);
+
 static ssize_t nullb_device_zone_readonly_store(struct config_item *item,
 						const char *page, size_t count)
 {
@@ -544,6 +583,7 @@ CONFIGFS_ATTR_WO(nullb_device_, zone_offline);
 static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_size,
 	&nullb_device_attr_completion_nsec,
+	&nullb_device_attr_poll_delay_nsec,
 	&nullb_device_attr_submit_queues,
 	&nullb_device_attr_poll_queues,
 	&nullb_device_attr_home_node,
@@ -572,6 +612,12 @@ static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_virt_boundary,
 	&nullb_device_attr_no_sched,
 	&nullb_device_attr_shared_tag_bitmap,
+	&nullb_device_attr_model,
+	&nullb_device_attr_model_channels,
+	&nullb_device_attr_model_rw_penalty,
+	&nullb_device_attr_model_flush_nsec,
+	&nullb_device_attr_model_read_lat,
+	&nullb_device_attr_model_write_lat,
 	NULL,
 };
 
@@ -652,8 +698,11 @@ static ssize_t memb_group_features_show(struct config_item *item, char *page)
 	return snprintf(page, PAGE_SIZE,
 			"badblocks,blocking,blocksize,cache_size,"
 			"completion_nsec,discard,home_node,hw_queue_depth,"
-			"irqmode,max_sectors,mbps,memory_backed,no_sched,"
-			"poll_queues,power,queue_mode,shared_tag_bitmap,size,"
+			"irqmode,max_sectors,mbps,memory_backed,model,"
+			"model_channels,model_flush_nsec,model_read_lat,"
+			"model_rw_penalty,model_write_lat,no_sched,"
+			"poll_delay_nsec,poll_queues,power,queue_mode,"
+			"shared_tag_bitmap,size,"
 			"submit_queues,use_per_node_hctx,virt_boundary,zoned,"
 			"zone_capacity,zone_max_active,zone_max_open,"
 			"zone_nr_conv,zone_offline,zone_readonly,zone_size\n");
@@ -739,6 +788,7 @@ static struct nullb_device *null_alloc_dev(void)
 	dev->virt_boundary = g_virt_boundary;
 	dev->no_sched = g_no_sched;
 	dev->shared_tag_bitmap = g_shared_tag_bitmap;
+	dev->model_channels = 1;
 	return dev;
 }
 
@@ -849,7 +899,11 @@ static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
 
 static void null_cmd_end_timer(struct nullb_cmd *cmd)
 {
-	ktime_t kt = cmd->nq->dev->completion_nsec;
+	struct nullb_device *dev = cmd->nq->dev;
+	ktime_t kt = dev->completion_nsec;
+
+	if (dev->model)
+		kt = null_model_delay(cmd);
 
 	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_REL);
 }
@@ -1638,25 +1692,61 @@ static void null_map_queues(struct blk_mq_tag_set *set)
 	}
 }
 
+/* Move the requests handed over by null_queue_rq() to ->poll_list */
+static void null_poll_splice(struct nullb_queue *nq)
+{
+	struct llist_node *entry;
+	struct nullb_cmd *cmd;
+
+	lockdep_assert_held(&nq->poll_lock);
+
+	entry = llist_reverse_order(llist_del_all(&nq->poll_head));
+	llist_for_each_entry(cmd, entry, poll_node)
+		list_add_tail(&cmd->rq->queuelist, &nq->poll_list);
+}
+
 static int null_poll(struct blk_mq_hw_ctx *hctx, struct io_comp_batch *iob)
 {
 	struct nullb_queue *nq = hctx->driver_data;
+	unsigned long delay = nq->dev->poll_delay_nsec;
+	struct request *req;
 	LIST_HEAD(list);
 	int nr = 0;
 
-	spin_lock(&nq->poll_lock);
-	list_splice_init(&nq->poll_list, &list);
+	if (llist_empty(&nq->poll_head) && list_empty(&nq->poll_list))
+		return 0;
+
+	/* Another poller is already completing requests of this queue */
+	if (!spin_trylock(&nq->poll_lock))
+		return 0;
+
+	null_poll_splice(nq);
+	if (delay) {
+		u64 now = ktime_get_ns();
+
+		list_for_each_entry(req, &nq->poll_list, queuelist) {
+			struct nullb_cmd *cmd = blk_mq_rq_to_pdu(req);
+
+			if (cmd->poll_deadline > now)
+				break;
+		}
+		list_cut_before(&list, &nq->poll_list, &req->queuelist);
+	} else {
+		list_splice_init(&nq->poll_list, &list);
+	}
 	spin_unlock(&nq->poll_lock);
 
 	while (!list_empty(&list)) {
 		struct nullb_cmd *cmd;
-		struct request *req;
+		blk_status_t sts;
 
 		req = list_first_entry(&list, struct request, queuelist);
 		list_del_init(&req->queuelist);
 		cmd = blk_mq_rq_to_pdu(req);
-		cmd->error = null_process_cmd(cmd, req_op(req), blk_rq_pos(req),
-						blk_rq_sectors(req));
+		sts = null_process_cmd(cmd, req_op(req), blk_rq_pos(req),
+				       blk_rq_sectors(req));
+		if (cmd->error == BLK_STS_OK)
+			cmd->error = sts;
 		if (!blk_mq_add_to_batch(req, iob, (__force int) cmd->error,
 					blk_mq_end_request_batch))
 			end_cmd(cmd);
@@ -1677,6 +1767,7 @@ static enum blk_eh_timer_return null_timeout_rq(struct request *rq)
 		struct nullb_queue *nq = hctx->driver_data;
 
 		spin_lock(&nq->poll_lock);
+		null_poll_splice(nq);
 		list_del_init(&rq->queuelist);
 		spin_unlock(&nq->poll_lock);
 	}
@@ -1731,9 +1822,10 @@ static blk_status_t null_queue_rq(struct blk_mq_hw_ctx *hctx,
 	}
 
 	if (is_poll) {
-		spin_lock(&nq->poll_lock);
-		list_add_tail(&rq->queuelist, &nq->poll_list);
-		spin_unlock(&nq->poll_lock);
+		if (nq->dev->poll_delay_nsec)
+			cmd->poll_deadline = ktime_get_ns() +
+					     nq->dev->poll_delay_nsec;
+		llist_add(&cmd->poll_node, &nq->poll_head);
 		return BLK_STS_OK;
 	}
 	if (cmd->fake_timeout)
@@ -1771,6 +1863,7 @@ static void null_init_queue(struct nullb *nullb, struct nullb_queue *nq)
 	init_waitqueue_head(&nq->wait);
 	nq->queue_depth = nullb->queue_depth;
 	nq->dev = nullb->dev;
+	init_llist_head(&nq->poll_head);
 	INIT_LIST_HEAD(&nq->poll_list);
 	spin_lock_init(&nq->poll_lock);
 }
@@ -1828,6 +1921,7 @@ static void null_del_dev(struct nullb *nullb)
 	    nullb->tag_set == &nullb->__tag_set)
 		blk_mq_free_tag_set(nullb->tag_set);
 	cleanup_queues(nullb);
+	null_free_model(nullb);
 	if (null_cache_active(nullb))
 		null_free_device_storage(nullb->dev, true);
 	kfree(nullb);
@@ -2024,6 +2118,12 @@ static int null_validate_conf(struct nullb_device *dev)
 	dev->queue_mode = min_t(unsigned int, dev->queue_mode, NULL_Q_MQ);
 	dev->irqmode = min_t(unsigned int, dev->irqmode, NULL_IRQ_TIMER);
 
+	/* The device model completes commands through the timer */
+	if (dev->model)
+		dev->irqmode = NULL_IRQ_TIMER;
+	dev->model_channels = clamp_t(unsigned int, dev->model_channels, 1,
+				      NULL_MODEL_MAX_CHANNELS);
+
 	/* Do memory allocation, so set blocking */
 	if (dev->memory_backed)
 		dev->blocking = true;
@@ -2095,6 +2195,10 @@ static int null_add_dev(struct nullb_device *dev)
 	if (rv)
 		goto out_free_nullb;
 
+	rv = null_init_model(nullb);
+	if (rv)
+		goto out_cleanup_queues;
+
 	if (dev->queue_mode == NULL_Q_MQ) {
 		if (shared_tags) {
 			nullb->tag_set = &tag_set;
@@ -2134,6 +2238,9 @@ static int null_add_dev(struct nullb_device *dev)
 	if (dev->cache_size > 0) {
 		set_bit(NULLB_DEV_FL_CACHE, &nullb->dev->flags);
 		blk_queue_write_cache(nullb->q, true, true);
+	} else if (dev->model) {
+		/* let flushes through to the model, see model_flush_nsec */
+		blk_queue_write_cache(nullb->q, true, false);
 	}
 
 	if (dev->zoned) {
@@ -2198,6 +2305,7 @@ static int null_add_dev(struct nullb_device *dev)
 		blk_mq_free_tag_set(nullb->tag_set);
 out_cleanup_queues:
 	cleanup_queues(nullb);
+	null_free_model(nullb);
 out_free_nullb:
 	kfree(nullb);
 	dev->nullb = NULL;
@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Software device model for null_blk.
+ *
+ * Instead of completing every command after the same completion_nsec, the
+ * device is modelled as model_channels independent channels. Commands are
+ * striped over the channels in NULL_MODEL_STRIPE_SECTORS chunks, and each
+ * channel serves its chunks in order, so queueing delay builds up with the
+ * load the way it does on a real device. The service time of a chunk is
+ * drawn from the read or write latency distribution.
+ *
+ * Reads and writes are queued separately on a channel, reads being served
+ * ahead of writes, but a read that runs while a write is in service on the
+ * same channel is slowed down by model_rw_penalty percent. A flush waits
+ * for all queued writes and then keeps the write side of every channel
+ * busy for model_flush_nsec.
+ */
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include "null_blk.h"
+
+#define NULL_MODEL_STRIPE_SHIFT		6	/* 32 KiB chunks */
+#define NULL_MODEL_PCT_SCALE		100000	/* 100%, in 1/1000 % */
+
+struct nullb_model_channel {
+	spinlock_t lock;
+	u64 read_busy;		/* ns, end of the last queued read chunk */
+	u64 write_busy;		/* ns, end of the last queued write chunk */
+} ____cacheline_aligned_in_smp;
+
+int null_init_model(struct nullb *nullb)
+{
+	struct nullb_device *dev = nullb->dev;
+	unsigned int i;
+
+	if (!dev->model)
+		return 0;
+
+	nullb->model_channels = kcalloc_node(dev->model_channels,
+					     sizeof(*nullb->model_channels),
+					     GFP_KERNEL, dev->home_node);
+	if (!nullb->model_channels)
+		return -ENOMEM;
+
+	for (i = 0; i < dev->model_channels; i++)
+		spin_lock_init(&nullb->model_channels[i].lock);
+	return 0;
+}
+
+void null_free_model(struct nullb *nullb)
+{
+	kfree(nullb->model_channels);
+	nullb->model_channels = NULL;
+}
+
+/*
+ * Draw a service time from @dist, interpolating linearly between two
+ * percentiles. Devices without a distribution use @def.
+ */
+static u64 null_model_sample(const struct nullb_model_dist *dist, u64 def)
+{
+	unsigned int i;
+	u32 r;
+
+	if (!dist->nr_points)
+		return def;
+
+	r = get_random_u32_below(NULL_MODEL_PCT_SCALE);
+	for (i = 0; i < dist->nr_points; i++)
+		if (r < dist->pct[i])
+			break;
+
+	if (i == 0)
+		return dist->nsec[0];
+	if (i == dist->nr_points)
+		return dist->nsec[i - 1];
+
+	return dist->nsec[i - 1] +
+		div_u64((dist->nsec[i] - dist->nsec[i - 1]) *
+			(r - dist->pct[i - 1]),
+			dist->pct[i] - dist->pct[i - 1]);
+}
+
+static u64 null_model_flush(struct nullb *nullb, u64 now)
+{
+	struct nullb_device *dev = nullb->dev;
+	struct nullb_model_channel *ch;
+	u64 done = now;
+	unsigned int i;
+
+	for (i = 0; i < dev->model_channels; i++) {
+		ch = &nullb->model_channels[i];
+		spin_lock(&ch->lock);
+		done = max(done, ch->write_busy);
+		spin_unlock(&ch->lock);
+	}
+
+	done += dev->model_flush_nsec;
+
+	for (i = 0; i < dev->model_channels; i++) {
+		ch = &nullb->model_channels[i];
+		spin_lock(&ch->lock);
+		ch->write_busy = max(ch->write_busy, done);
+		spin_unlock(&ch->lock);
+	}
+
+	return done;
+}
+
+/* Schedule @cmd on the model and return its delay from now, in ns */
+u64 null_model_delay(struct nullb_cmd *cmd)
+{
+	struct nullb_device *dev = cmd->nq->dev;
+	struct nullb *nullb = dev->nullb;
+	struct nullb_model_channel *ch;
+	u64 now = ktime_get_ns();
+	u64 done = now, start, lat;
+	sector_t sector, end, chunk;
+	enum req_op op;
+	bool write;
+
+	if (dev->queue_mode == NULL_Q_BIO) {
+		op = bio_op(cmd->bio);
+		sector = cmd->bio->bi_iter.bi_sector;
+		end = bio_end_sector(cmd->bio);
+	} else {
+		op = req_op(cmd->rq);
+		sector = blk_rq_pos(cmd->rq);
+		end = sector + blk_rq_sectors(cmd->rq);
+	}
+
+	if (op == REQ_OP_FLUSH)
+		return null_model_flush(nullb, now) - now;
+
+	write = op_is_write(op);
+	/* commands without data still take one service time */
+	do {
+		chunk = sector >> NULL_MODEL_STRIPE_SHIFT;
+		ch = &nullb->model_channels[sector_div(chunk,
+						       dev->model_channels)];
+		if (write)
+			lat = null_model_sample(&dev->model_write,
+						dev->completion_nsec);
+		else
+			lat = null_model_sample(&dev->model_read,
+						dev->completion_nsec);
+
+		spin_lock(&ch->lock);
+		if (write) {
+			start = max(now, ch->write_busy);
+			ch->write_busy = start + lat;
+		} else {
+			start = max(now, ch->read_busy);
+			if (ch->write_busy > start)
+				lat += div_u64(lat * dev->model_rw_penalty, 100);
+			ch->read_busy = start + lat;
+		}
+		spin_unlock(&ch->lock);
+
+		done = max(done, start + lat);
+		sector = round_down(sector, 1 << NULL_MODEL_STRIPE_SHIFT) +
+			 (1 << NULL_MODEL_STRIPE_SHIFT);
+	} while (sector < end);
+
+	return done - now;
+}
+
+/* Percentiles are given with up to 3 decimals, e.g. "99.99" */
+static int null_model_parse_pct(char *str, u32 *pct)
+{
+	unsigned int ip, fp = 0, digits;
+	char *frac;
+	int ret;
+
+	frac = strchr(str, '.');
+	if (frac) {
+		*frac++ = '\0';
+		digits = strlen(frac);
+		if (!digits || digits > 3)
+			return -EINVAL;
+		ret = kstrtouint(frac, 10, &fp);
+		if (ret)
+			return ret;
+		for (; digits < 3; digits++)
+			fp *= 10;
+	}
+
+	ret = kstrtouint(str, 10, &ip);
+	if (ret)
+		return ret;
+	if (ip > 100 || (ip == 100 && fp))
+		return -EINVAL;
+
+	*pct = ip * 1000 + fp;
+	return 0;
+}
+
+ssize_t null_model_dist_show(const struct nullb_model_dist *dist, char *page)
+{
+	ssize_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < dist->nr_points; i++) {
+		u32 pct = dist->pct[i];
+
+		len += scnprintf(page + len, PAGE_SIZE - len, "%s%u",
+				 i ? " " : "", pct / 1000);
+		if (pct % 1000)
+			len += scnprintf(page + len, PAGE_SIZE - len, ".%03u",
+					 pct % 1000);
+		len += scnprintf(page + len, PAGE_SIZE - len, ":%llu",
+				 dist->nsec[i]);
+	}
+	len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+/*
+ * Parse a list of "percentile:nsec" points, e.g. "50:80000 99:200000
+ * 99.9:1000000 100:3000000". Both the percentiles and the latencies must
+ * be increasing. An empty list falls back to completion_nsec.
+ */
+ssize_t null_model_dist_store(struct nullb_model_dist *dist, const char *page,
+			      size_t count)
+{
+	struct nullb_model_dist new = {};
+	char *orig, *buf, *tok, *sep;
+	unsigned int n;
+	int ret;
+
+	orig = kstrndup(page, count, GFP_KERNEL);
+	if (!orig)
+		return -ENOMEM;
+
+	buf = strstrip(orig);
+	while ((tok = strsep(&buf, " ,")) != NULL) {
+		if (!*tok)
+			continue;
+
+		ret = -EINVAL;
+		n = new.nr_points;
+		if (n == NULL_MODEL_MAX_POINTS)
+			goto out;
+		sep = strchr(tok, ':');
+		if (!sep)
+			goto out;
+		*sep = '\0';
+
+		ret = null_model_parse_pct(tok, &new.pct[n]);
+		if (ret)
+			goto out;
+		ret = kstrtoull(sep + 1, 0, &new.nsec[n]);
+		if (ret)
+			goto out;
+
+		ret = -EINVAL;
+		if (n && (new.pct[n] <= new.pct[n - 1] ||
+			  new.nsec[n] < new.nsec[n - 1]))
+			goto out;
+		new.nr_points++;
+	}
+
+	*dist = new;
+	ret = count;
+out:
+	kfree(orig);
+	return ret;
+}
@@ -14,6 +14,7 @@
 #include <linux/fault-inject.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/llist.h>
 
 struct nullb_cmd {
 	union {
@@ -25,6 +26,8 @@ struct nullb_cmd {
 	bool fake_timeout;
 	struct nullb_queue *nq;
 	struct hrtimer timer;
+	struct llist_node poll_node;
+	u64 poll_deadline; /* ns, only set with poll_delay_nsec */
 };
 
 struct nullb_queue {
@@ -34,6 +37,9 @@ struct nullb_queue {
 	struct nullb_device *dev;
 	unsigned int requeue_selection;
 
+	/* polled requests are handed over locklessly through poll_head */
+	struct llist_head poll_head;
+	/* submitted but not due yet, protected by poll_lock */
 	struct list_head poll_list;
 	spinlock_t poll_lock;
 
@@ -60,6 +66,22 @@ struct nullb_zone {
 	unsigned int capacity;
 };
 
+#define NULL_MODEL_MAX_POINTS	8
+#define NULL_MODEL_MAX_CHANNELS	1024
+
+/*
+ * Service time distribution of the device model, as latency percentiles:
+ * pct[i] (in 1/1000 of a percent) of the commands are served within
+ * nsec[i]. Service times between two points are interpolated.
+ */
+struct nullb_model_dist {
+	unsigned int nr_points;
+	u32 pct[NULL_MODEL_MAX_POINTS];
+	u64 nsec[NULL_MODEL_MAX_POINTS];
+};
+
+struct nullb_model_channel;
+
 /* Queue modes */
 enum {
 	NULL_Q_BIO	= 0,
@@ -93,6 +115,7 @@ struct nullb_device {
 
 	unsigned long size; /* device size in MB */
 	unsigned long completion_nsec; /* time in ns to complete a request */
+	unsigned long poll_delay_nsec; /* time in ns until a polled request is done */
 	unsigned long cache_size; /* disk cache size in MB */
 	unsigned long zone_size; /* zone size in MB if device is zoned */
 	unsigned long zone_capacity; /* zone capacity in MB if device is zoned */
@@ -111,6 +134,11 @@ struct nullb_device {
 	unsigned int hw_queue_depth; /* queue depth */
 	unsigned int index; /* index of the disk, only valid with a disk */
 	unsigned int mbps; /* Bandwidth throttle cap (in MB/s) */
+	unsigned int model_channels; /* parallel channels of the device model */
+	unsigned int model_rw_penalty; /* read slowdown behind writes, in % */
+	unsigned long model_flush_nsec; /* write cache flush cost */
+	struct nullb_model_dist model_read; /* read service time */
+	struct nullb_model_dist model_write; /* write service time */
 	bool blocking; /* blocking blk-mq device */
 	bool use_per_node_hctx; /* use per-node allocation for hardware context */
 	bool power; /* power on/off the device */
@@ -120,6 +148,7 @@ struct nullb_device {
 	bool virt_boundary; /* virtual boundary on/off for the device */
 	bool no_sched; /* no IO scheduler for the device */
 	bool shared_tag_bitmap; /* use hostwide shared tags */
+	bool model; /* complete commands through the device model */
 };
 
 struct nullb {
@@ -133,6 +162,7 @@ struct nullb {
 	unsigned int queue_depth;
 	atomic_long_t cur_bytes;
 	struct hrtimer bw_timer;
+	struct nullb_model_channel *model_channels;
 	unsigned long cache_flush_pos;
 	spinlock_t lock;
 
@@ -146,6 +176,13 @@ blk_status_t null_handle_discard(struct nullb_device *dev, sector_t sector,
 blk_status_t null_process_cmd(struct nullb_cmd *cmd, enum req_op op,
 			      sector_t sector, unsigned int nr_sectors);
 
+int null_init_model(struct nullb *nullb);
+void null_free_model(struct nullb *nullb);
+u64 null_model_delay(struct nullb_cmd *cmd);
+ssize_t null_model_dist_show(const struct nullb_model_dist *dist, char *page);
+ssize_t null_model_dist_store(struct nullb_model_dist *dist, const char *page,
+			      size_t count);
+
 #ifdef CONFIG_BLK_DEV_ZONED
 int null_init_zoned_dev(struct nullb_device *dev, struct request_queue *q);
 int null_register_zoned_dev(struct nullb *nullb);
@@ -11,6 +11,8 @@
 #include <linux/sched.h>
 #include <linux/cpu.h>
 #include <linux/crypto.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 
 #include "zcomp.h"
 
@@ -33,11 +35,166 @@ static const char * const backends[] = {
 #endif
 };
 
+#ifdef CONFIG_ZRAM_ZSTD_DICT
+/* Same level as the crypto zstd backend */
+#define ZCOMP_ZSTD_LEVEL	3
+
+static int zcomp_strm_init_dict(struct zcomp_strm *zstrm,
+				struct zcomp_dict *dict)
+{
+	size_t cctx_size, dctx_size;
+
+	if (!dict)
+		return 0;
+
+	cctx_size = ALIGN(zstd_cctx_workspace_bound(&dict->cparams), 8);
+	dctx_size = zstd_dctx_workspace_bound();
+	zstrm->dict_ws = kvmalloc(cctx_size + dctx_size, GFP_KERNEL);
+	if (!zstrm->dict_ws)
+		return -ENOMEM;
+
+	zstrm->cctx = zstd_init_cctx(zstrm->dict_ws, cctx_size);
+	zstrm->dctx = zstd_init_dctx(zstrm->dict_ws + cctx_size, dctx_size);
+	if (!zstrm->cctx || !zstrm->dctx) {
+		kvfree(zstrm->dict_ws);
+		zstrm->dict_ws = NULL;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void zcomp_strm_free_dict(struct zcomp_strm *zstrm)
+{
+	kvfree(zstrm->dict_ws);
+	zstrm->dict_ws = NULL;
+	zstrm->cctx = NULL;
+	zstrm->dctx = NULL;
+}
+
+static void zcomp_free_dict(struct zcomp_dict *dict)
+{
+	if (!dict)
+		return;
+
+	kvfree(dict->ws);
+	vfree(dict->data);
+	kfree(dict);
+}
+
+/*
+ * Make @data, a vmalloc()-ed buffer of @size bytes, the dictionary of
+ * @comp. zcomp owns @data on success. A dictionary can only be set once,
+ * objects compressed with it must stay readable for the lifetime of @comp.
+ */
+int zcomp_set_dict(struct zcomp *comp, void *data, size_t size)
+{
+	struct zcomp_dict *dict;
+	size_t cdict_size, ddict_size;
+	unsigned int cpu;
+	int ret;
+
+	if (strcmp(comp->name, "zstd"))
+		return -EINVAL;
+
+	if (comp->dict)
+		return -EBUSY;
+
+	dict = kzalloc(sizeof(*dict), GFP_KERNEL);
+	if (!dict)
+		return -ENOMEM;
+
+	dict->data = data;
+	dict->size = size;
+	dict->cparams = zstd_get_cparams(ZCOMP_ZSTD_LEVEL, PAGE_SIZE, size);
+
+	cdict_size = ALIGN(zstd_cdict_workspace_bound(size, &dict->cparams), 8);
+	ddict_size = zstd_ddict_workspace_bound(size);
+	ret = -ENOMEM;
+	dict->ws = kvmalloc(cdict_size + ddict_size, GFP_KERNEL);
+	if (!dict->ws)
+		goto free;
+
+	ret = -EINVAL;
+	dict->cdict = zstd_init_cdict(dict->ws, cdict_size, data, size,
+				      &dict->cparams);
+	dict->ddict = zstd_init_ddict(dict->ws + cdict_size, ddict_size,
+				      data, size);
+	if (!dict->cdict || !dict->ddict)
+		goto free;
+
+	/* Streams of CPUs brought up later see ->dict in up_prepare */
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		ret = zcomp_strm_init_dict(per_cpu_ptr(comp->stream, cpu), dict);
+		if (ret)
+			break;
+	}
+	if (ret) {
+		for_each_online_cpu(cpu)
+			zcomp_strm_free_dict(per_cpu_ptr(comp->stream, cpu));
+		cpus_read_unlock();
+		goto free;
+	}
+	/* Pairs with the acquire in zcomp_has_dict() */
+	smp_store_release(&comp->dict, dict);
+	cpus_read_unlock();
+	return 0;
+
+free:
+	dict->data = NULL;
+	zcomp_free_dict(dict);
+	return ret;
+}
+
+bool zcomp_has_dict(struct zcomp *comp)
+{
+	return smp_load_acquire(&comp->dict);
+}
+
+int zcomp_compress_dict(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const void *src, unsigned int *dst_len)
+{
+	struct zcomp_dict *dict = smp_load_acquire(&comp->dict);
+	size_t ret;
+
+	ret = zstd_compress_using_cdict(zstrm->cctx, zstrm->buffer,
+					PAGE_SIZE * 2, src, PAGE_SIZE,
+					dict->cdict);
+	if (zstd_is_error(ret))
+		return -EINVAL;
+
+	*dst_len = ret;
+	return 0;
+}
+
+int zcomp_decompress_dict(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const void *src, unsigned int src_len, void *dst)
+{
+	struct zcomp_dict *dict = smp_load_acquire(&comp->dict);
+	size_t ret;
+
+	ret = zstd_decompress_using_ddict(zstrm->dctx, dst, PAGE_SIZE,
+					  src, src_len, dict->ddict);
+	if (zstd_is_error(ret) || ret != PAGE_SIZE)
+		return -EINVAL;
+	return 0;
+}
+#else
+static int zcomp_strm_init_dict(struct zcomp_strm *zstrm,
+				struct zcomp_dict *dict)
+{
+	return 0;
+}
+static void zcomp_strm_free_dict(struct zcomp_strm *zstrm) {};
+static void zcomp_free_dict(struct zcomp_dict *dict) {};
+#endif
+
 static void zcomp_strm_free(struct zcomp_strm *zstrm)
 {
 	if (!IS_ERR_OR_NULL(zstrm->tfm))
 		crypto_free_comp(zstrm->tfm);
 	free_pages((unsigned long)zstrm->buffer, 1);
+	zcomp_strm_free_dict(zstrm);
 	zstrm->tfm = NULL;
 	zstrm->buffer = NULL;
 }
@@ -54,7 +211,8 @@ static int zcomp_strm_init(struct zcomp_strm *zstrm, struct zcomp *comp)
 	 * case when compressed size is larger than the original one
 	 */
 	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (IS_ERR_OR_NULL(zstrm->tfm) || !zstrm->buffer) {
+	if (IS_ERR_OR_NULL(zstrm->tfm) || !zstrm->buffer ||
+	    zcomp_strm_init_dict(zstrm, comp->dict)) {
 		zcomp_strm_free(zstrm);
 		return -ENOMEM;
 	}
@@ -195,6 +353,7 @@ void zcomp_destroy(struct zcomp *comp)
 {
 	cpuhp_state_remove_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
 	free_percpu(comp->stream);
+	zcomp_free_dict(comp->dict);
 	kfree(comp);
 }
 
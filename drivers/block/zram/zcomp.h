@@ -6,6 +6,7 @@
 #ifndef _ZCOMP_H_
 #define _ZCOMP_H_
 #include <linux/local_lock.h>
+#include <linux/zstd.h>
 
 struct zcomp_strm {
 	/* The members ->buffer and ->tfm are protected by ->lock. */
@@ -13,6 +14,22 @@ struct zcomp_strm {
 	/* compression/decompression buffer */
 	void *buffer;
 	struct crypto_comp *tfm;
+#ifdef CONFIG_ZRAM_ZSTD_DICT
+	/* zstd contexts, allocated once a dictionary is set */
+	void *dict_ws;
+	zstd_cctx *cctx;
+	zstd_dctx *dctx;
+#endif
+};
+
+/* raw content zstd dictionary, immutable once set */
+struct zcomp_dict {
+	void *data;
+	size_t size;
+	zstd_compression_parameters cparams;
+	void *ws;
+	const zstd_cdict *cdict;
+	const zstd_ddict *ddict;
 };
 
 /* dynamic per-device compression frontend */
@@ -20,6 +37,7 @@ struct zcomp {
 	struct zcomp_strm __percpu *stream;
 	const char *name;
 	struct hlist_node node;
+	struct zcomp_dict *dict;
 };
 
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node);
@@ -40,4 +58,38 @@ int zcomp_decompress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int src_len, void *dst);
 
 bool zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+
+#ifdef CONFIG_ZRAM_ZSTD_DICT
+int zcomp_set_dict(struct zcomp *comp, void *data, size_t size);
+bool zcomp_has_dict(struct zcomp *comp);
+
+int zcomp_compress_dict(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const void *src, unsigned int *dst_len);
+
+int zcomp_decompress_dict(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const void *src, unsigned int src_len, void *dst);
+#else
+static inline int zcomp_set_dict(struct zcomp *comp, void *data, size_t size)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline bool zcomp_has_dict(struct zcomp *comp)
+{
+	return false;
+}
+
+static inline int zcomp_compress_dict(struct zcomp *comp,
+		struct zcomp_strm *zstrm, const void *src, unsigned int *dst_len)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int zcomp_decompress_dict(struct zcomp *comp,
+		struct zcomp_strm *zstrm, const void *src, unsigned int src_len,
+		void *dst)
+{
+	return -EOPNOTSUPP;
+}
+#endif
 #endif /* _ZCOMP_H_ */
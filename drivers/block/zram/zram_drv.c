@@ -33,6 +33,8 @@
 #include <linux/debugfs.h>
 #include <linux/cpuhotplug.h>
 #include <linux/part_stat.h>
+#include <linux/workqueue.h>
+#include <linux/xxhash.h>
 
 #include "zram_drv.h"
 
@@ -941,6 +943,194 @@ static void zram_debugfs_register(struct zram *zram) {};
 static void zram_debugfs_unregister(struct zram *zram) {};
 #endif
 
+#ifdef CONFIG_ZRAM_DEDUP
+static bool zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	unsigned long i, nr;
+
+	if (!zram->use_dedup)
+		return true;
+
+	/* keep the trees shallow, a bucket per 256 pages */
+	nr = roundup_pow_of_two(max_t(size_t, num_pages >> 8, 1));
+	zram->dedup_buckets = kvmalloc_array(nr, sizeof(*zram->dedup_buckets),
+					     GFP_KERNEL);
+	if (!zram->dedup_buckets)
+		return false;
+
+	for (i = 0; i < nr; i++) {
+		spin_lock_init(&zram->dedup_buckets[i].lock);
+		zram->dedup_buckets[i].root = RB_ROOT;
+	}
+	zram->dedup_mask = nr - 1;
+	return true;
+}
+
+static void zram_dedup_fini(struct zram *zram)
+{
+	kvfree(zram->dedup_buckets);
+	zram->dedup_buckets = NULL;
+}
+
+static struct zram_dedup_bucket *zram_dedup_bucket(struct zram *zram,
+						   u64 checksum)
+{
+	return &zram->dedup_buckets[checksum & zram->dedup_mask];
+}
+
+/*
+ * Allocate the index entry of a page about to be written, before the
+ * compression stream is taken. Returns NULL if dedup is disabled or no
+ * memory is available, the page is then stored on its own.
+ */
+static struct zram_dedup_entry *zram_dedup_alloc(struct zram *zram,
+						 struct page *page)
+{
+	struct zram_dedup_entry *entry;
+	void *mem;
+
+	if (!zram->use_dedup)
+		return NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	mem = kmap_local_page(page);
+	entry->checksum = xxh64(mem, PAGE_SIZE, 0);
+	kunmap_local(mem);
+	return entry;
+}
+
+/*
+ * Look for a stored object with the checksum of @new and the same @len
+ * bytes of compressed data as @mem, and take a reference on it. Different
+ * pages may share a checksum, so every candidate is compared in full.
+ */
+static struct zram_dedup_entry *zram_dedup_get(struct zram *zram,
+					       struct zram_dedup_entry *new,
+					       const void *mem,
+					       unsigned int len)
+{
+	struct zram_dedup_bucket *bucket;
+	struct zram_dedup_entry *entry, *first = NULL;
+	struct rb_node *node;
+	bool match;
+	void *obj;
+
+	bucket = zram_dedup_bucket(zram, new->checksum);
+	spin_lock(&bucket->lock);
+	node = bucket->root.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, node);
+		if (new->checksum <= entry->checksum) {
+			if (new->checksum == entry->checksum)
+				first = entry;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	for (entry = first; entry && entry->checksum == new->checksum;
+	     entry = rb_entry_safe(rb_next(&entry->node),
+				   struct zram_dedup_entry, node)) {
+		if (entry->len != len)
+			continue;
+
+		obj = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+		match = !memcmp(obj, mem, len);
+		zs_unmap_object(zram->mem_pool, entry->handle);
+		if (match) {
+			entry->refcount++;
+			spin_unlock(&bucket->lock);
+
+			atomic64_inc(&zram->stats.dedup_hits);
+			atomic64_add(len, &zram->stats.dedup_saved);
+			return entry;
+		}
+	}
+	spin_unlock(&bucket->lock);
+
+	return NULL;
+}
+
+/* Index a newly stored object, @entry takes over @handle */
+static void zram_dedup_insert(struct zram *zram, struct zram_dedup_entry *entry,
+			      unsigned long handle, unsigned int len)
+{
+	struct zram_dedup_bucket *bucket;
+	struct rb_node **link, *parent = NULL;
+	struct zram_dedup_entry *cur;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->refcount = 1;
+
+	bucket = zram_dedup_bucket(zram, entry->checksum);
+	spin_lock(&bucket->lock);
+	link = &bucket->root.rb_node;
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zram_dedup_entry, node);
+		if (entry->checksum < cur->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&entry->node, parent, link);
+	rb_insert_color(&entry->node, &bucket->root);
+	spin_unlock(&bucket->lock);
+
+	atomic64_inc(&zram->stats.dedup_misses);
+}
+
+/* Drop a slot reference, the last one frees the shared object */
+static void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_dedup_bucket *bucket;
+	unsigned int refcount;
+
+	bucket = zram_dedup_bucket(zram, entry->checksum);
+	spin_lock(&bucket->lock);
+	refcount = --entry->refcount;
+	if (!refcount)
+		rb_erase(&entry->node, &bucket->root);
+	spin_unlock(&bucket->lock);
+
+	if (refcount) {
+		atomic64_sub(entry->len, &zram->stats.dedup_saved);
+		return;
+	}
+
+	zs_free(zram->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	kfree(entry);
+}
+#else
+static bool zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return true;
+}
+static void zram_dedup_fini(struct zram *zram) {};
+static struct zram_dedup_entry *zram_dedup_alloc(struct zram *zram,
+						 struct page *page)
+{
+	return NULL;
+}
+static struct zram_dedup_entry *zram_dedup_get(struct zram *zram,
+					       struct zram_dedup_entry *new,
+					       const void *mem,
+					       unsigned int len)
+{
+	return NULL;
+}
+static void zram_dedup_insert(struct zram *zram, struct zram_dedup_entry *entry,
+			      unsigned long handle, unsigned int len) {};
+static void zram_dedup_put(struct zram *zram,
+			   struct zram_dedup_entry *entry) {};
+#endif
+
 /*
  * We switched to per-cpu streams and this attr is not needed anymore.
  * However, we will keep it around for some time, because:
@@ -962,6 +1152,173 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	return len;
 }
 
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->async_write;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change async write mode for initialized device\n");
+		return -EBUSY;
+	}
+
+	/*
+	 * Swap waits for every write to a synchronous device, which would
+	 * leave the workers with a single page at a time.
+	 */
+	zram->async_write = val;
+	if (val)
+		blk_queue_flag_clear(QUEUE_FLAG_SYNCHRONOUS, zram->disk->queue);
+	else
+		blk_queue_flag_set(QUEUE_FLAG_SYNCHRONOUS, zram->disk->queue);
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup mode for initialized device\n");
+		return -EBUSY;
+	}
+
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+#endif
+
+#ifdef CONFIG_ZRAM_ZSTD_DICT
+#define ZRAM_DICT_MAX_SIZE	(1UL << 20)
+
+/*
+ * lib/zstd has no dictionary builder, so the dictionary is raw content:
+ * a sample of the compressible pages stored so far, spread evenly over
+ * the device. zstd matches new pages against it like against a window.
+ */
+static ssize_t train_dict_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages, index, step, seen = 0;
+	struct page *page = NULL;
+	size_t size, off = 0;
+	void *data = NULL;
+	ssize_t ret;
+
+	size = PAGE_ALIGN(memparse(buf, NULL));
+	if (!size || size > ZRAM_DICT_MAX_SIZE)
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (!init_done(zram) ||
+	    strcmp(zram->comp_algs[ZRAM_PRIMARY_COMP], "zstd")) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (zcomp_has_dict(zram->comps[ZRAM_PRIMARY_COMP])) {
+		ret = -EBUSY;
+		goto release_init_lock;
+	}
+
+	data = vmalloc(size);
+	page = alloc_page(GFP_KERNEL);
+	if (!data || !page) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	step = atomic64_read(&zram->stats.pages_stored) / (size >> PAGE_SHIFT);
+	step = max(step, 1UL);
+	for (index = 0; index < nr_pages && off < size; index++) {
+		bool sample;
+
+		zram_slot_lock(zram, index);
+		sample = zram_allocated(zram, index) &&
+			 !zram_test_flag(zram, index, ZRAM_WB) &&
+			 !zram_test_flag(zram, index, ZRAM_UNDER_WB) &&
+			 !zram_test_flag(zram, index, ZRAM_SAME) &&
+			 !zram_test_flag(zram, index, ZRAM_HUGE);
+		zram_slot_unlock(zram, index);
+
+		if (!sample || seen++ % step)
+			continue;
+
+		if (zram_read_page(zram, page, index, NULL))
+			continue;
+
+		memcpy_from_page(data + off, page, 0, PAGE_SIZE);
+		off += PAGE_SIZE;
+		cond_resched();
+	}
+
+	if (!off) {
+		ret = -ENODATA;
+		goto free;
+	}
+
+	ret = zcomp_set_dict(zram->comps[ZRAM_PRIMARY_COMP], data, off);
+	if (!ret) {
+		data = NULL;
+		ret = len;
+	}
+
+free:
+	if (page)
+		__free_page(page);
+	vfree(data);
+release_init_lock:
+	up_write(&zram->init_lock);
+	return ret;
+}
+#endif
+
 static void comp_algorithm_set(struct zram *zram, u32 prio, const char *alg)
 {
 	/* Do not free statically defined compression algorithms */
@@ -1155,7 +1512,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -1164,7 +1521,8 @@ static ssize_t mm_stat_show(struct device *dev,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			atomic_long_read(&pool_stats.pages_compacted),
 			(u64)atomic64_read(&zram->stats.huge_pages),
-			(u64)atomic64_read(&zram->stats.huge_pages_since));
+			(u64)atomic64_read(&zram->stats.huge_pages_since),
+			(u64)atomic64_read(&zram->stats.dedup_saved));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1199,10 +1557,14 @@ static ssize_t debug_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-			"version: %d\n%8llu %8llu\n",
+			"version: %d\n%8llu %8llu %8llu %8llu %8llu %8llu\n",
 			version,
 			(u64)atomic64_read(&zram->stats.writestall),
-			(u64)atomic64_read(&zram->stats.miss_free));
+			(u64)atomic64_read(&zram->stats.miss_free),
+			(u64)atomic64_read(&zram->stats.async_writes),
+			(u64)atomic64_read(&zram->stats.async_bios),
+			(u64)atomic64_read(&zram->stats.dedup_hits),
+			(u64)atomic64_read(&zram->stats.dedup_misses));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1224,6 +1586,7 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
 	vfree(zram->table);
 }
@@ -1243,6 +1606,12 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 		return false;
 	}
 
+	if (!zram_dedup_init(zram, num_pages)) {
+		zs_destroy_pool(zram->mem_pool);
+		vfree(zram->table);
+		return false;
+	}
+
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
@@ -1271,6 +1640,9 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
 		zram_clear_flag(zram, index, ZRAM_INCOMPRESSIBLE);
 
+	if (zram_test_flag(zram, index, ZRAM_DICT))
+		zram_clear_flag(zram, index, ZRAM_DICT);
+
 	zram_set_priority(zram, index, 0);
 
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
@@ -1293,6 +1665,12 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, (struct zram_dedup_entry *)handle);
+		goto out;
+	}
+
 	zs_free(zram->mem_pool, handle);
 
 	atomic64_sub(zram_get_obj_size(zram, index),
@@ -1331,6 +1709,9 @@ static int zram_read_from_zspool(struct zram *zram, struct page *page,
 		return 0;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		handle = ((struct zram_dedup_entry *)handle)->handle;
+
 	size = zram_get_obj_size(zram, index);
 
 	if (size != PAGE_SIZE) {
@@ -1346,7 +1727,11 @@ static int zram_read_from_zspool(struct zram *zram, struct page *page,
 		ret = 0;
 	} else {
 		dst = kmap_atomic(page);
-		ret = zcomp_decompress(zstrm, src, size, dst);
+		if (zram_test_flag(zram, index, ZRAM_DICT))
+			ret = zcomp_decompress_dict(zram->comps[prio], zstrm,
+						    src, size, dst);
+		else
+			ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
 		zcomp_stream_put(zram->comps[prio]);
 	}
@@ -1419,6 +1804,8 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	struct zcomp_strm *zstrm;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
+	struct zram_dedup_entry *entry, *dup;
+	bool dict = false;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1430,21 +1817,50 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	}
 	kunmap_atomic(mem);
 
+	entry = zram_dedup_alloc(zram, page);
+
 compress_again:
 	zstrm = zcomp_stream_get(zram->comps[ZRAM_PRIMARY_COMP]);
+	dict = zcomp_has_dict(zram->comps[ZRAM_PRIMARY_COMP]);
 	src = kmap_atomic(page);
-	ret = zcomp_compress(zstrm, src, &comp_len);
+	if (dict)
+		ret = zcomp_compress_dict(zram->comps[ZRAM_PRIMARY_COMP],
+					  zstrm, src, &comp_len);
+	else
+		ret = zcomp_compress(zstrm, src, &comp_len);
 	kunmap_atomic(src);
 
 	if (unlikely(ret)) {
 		zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 		pr_err("Compression failed! err=%d\n", ret);
 		zs_free(zram->mem_pool, handle);
+		kfree(entry);
 		return ret;
 	}
 
-	if (comp_len >= huge_class_size)
+	if (comp_len >= huge_class_size) {
 		comp_len = PAGE_SIZE;
+		dict = false;
+	}
+
+	if (entry) {
+		src = zstrm->buffer;
+		if (comp_len == PAGE_SIZE)
+			src = kmap_atomic(page);
+		dup = zram_dedup_get(zram, entry, src, comp_len);
+		if (comp_len == PAGE_SIZE)
+			kunmap_atomic(src);
+
+		if (dup) {
+			zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
+			/* a handle left over from the slow path is not needed */
+			zs_free(zram->mem_pool, handle);
+			kfree(entry);
+			handle = (unsigned long)dup;
+			flags = ZRAM_DEDUP;
+			goto out;
+		}
+	}
 	/*
 	 * handle allocation has 2 paths:
 	 * a) fast path is executed with preemption disabled (for
@@ -1470,8 +1886,10 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 		handle = zs_malloc(zram->mem_pool, comp_len,
 				GFP_NOIO | __GFP_HIGHMEM |
 				__GFP_MOVABLE);
-		if (IS_ERR_VALUE(handle))
+		if (IS_ERR_VALUE(handle)) {
+			kfree(entry);
 			return PTR_ERR((void *)handle);
+		}
 
 		if (comp_len != PAGE_SIZE)
 			goto compress_again;
@@ -1491,6 +1909,7 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
 		zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 		zs_free(zram->mem_pool, handle);
+		kfree(entry);
 		return -ENOMEM;
 	}
 
@@ -1506,6 +1925,12 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	if (entry) {
+		zram_dedup_insert(zram, entry, handle, comp_len);
+		handle = (unsigned long)entry;
+		flags = ZRAM_DEDUP;
+	}
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1520,10 +1945,14 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 		atomic64_inc(&zram->stats.huge_pages_since);
 	}
 
-	if (flags) {
+	if (flags == ZRAM_SAME) {
 		zram_set_flag(zram, index, flags);
 		zram_set_element(zram, index, element);
 	}  else {
+		if (flags)
+			zram_set_flag(zram, index, flags);
+		if (dict)
+			zram_set_flag(zram, index, ZRAM_DICT);
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
 	}
@@ -1703,6 +2132,74 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 	return 0;
 }
 
+/*
+ * Move an object compressed by the primary algorithm without dictionary
+ * onto the dictionary, if that puts it into a smaller size class.
+ * Corresponding ZRAM slot should be locked.
+ */
+static int zram_recompress_dict(struct zram *zram, u32 index,
+				struct page *page, u32 threshold)
+{
+	struct zcomp *comp = zram->comps[ZRAM_PRIMARY_COMP];
+	struct zcomp_strm *zstrm;
+	unsigned long handle_new;
+	unsigned int comp_len_old;
+	unsigned int comp_len_new;
+	void *src, *dst;
+	int ret;
+
+	if (zram_test_flag(zram, index, ZRAM_DICT) ||
+	    zram_get_priority(zram, index) != ZRAM_PRIMARY_COMP)
+		return 0;
+
+	comp_len_old = zram_get_obj_size(zram, index);
+	if (comp_len_old < threshold)
+		return 0;
+
+	ret = zram_read_from_zspool(zram, page, index);
+	if (ret)
+		return ret;
+
+	zstrm = zcomp_stream_get(comp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress_dict(comp, zstrm, src, &comp_len_new);
+	kunmap_atomic(src);
+
+	if (ret || comp_len_new >= huge_class_size ||
+	    zs_lookup_class_index(zram->mem_pool, comp_len_new) >=
+	    zs_lookup_class_index(zram->mem_pool, comp_len_old) ||
+	    (threshold && comp_len_new >= threshold)) {
+		zcomp_stream_put(comp);
+		return ret;
+	}
+
+	handle_new = zs_malloc(zram->mem_pool, comp_len_new,
+			       __GFP_KSWAPD_RECLAIM |
+			       __GFP_NOWARN |
+			       __GFP_HIGHMEM |
+			       __GFP_MOVABLE);
+	if (IS_ERR_VALUE(handle_new)) {
+		zcomp_stream_put(comp);
+		return PTR_ERR((void *)handle_new);
+	}
+
+	dst = zs_map_object(zram->mem_pool, handle_new, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len_new);
+	zcomp_stream_put(comp);
+
+	zs_unmap_object(zram->mem_pool, handle_new);
+
+	zram_free_page(zram, index);
+	zram_set_handle(zram, index, handle_new);
+	zram_set_obj_size(zram, index, comp_len_new);
+	zram_set_flag(zram, index, ZRAM_DICT);
+
+	atomic64_add(comp_len_new, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+
+	return 0;
+}
+
 #define RECOMPRESS_IDLE		(1 << 0)
 #define RECOMPRESS_HUGE		(1 << 1)
 
@@ -1717,6 +2214,7 @@ static ssize_t recompress_store(struct device *dev,
 	u32 mode = 0, threshold = 0;
 	unsigned long index;
 	struct page *page;
+	bool dict = false;
 	ssize_t ret;
 
 	args = skip_spaces(buf);
@@ -1751,9 +2249,16 @@ static ssize_t recompress_store(struct device *dev,
 			algo = val;
 			continue;
 		}
+
+		if (!strcmp(param, "dict")) {
+			ret = kstrtobool(val, &dict);
+			if (ret)
+				return ret;
+			continue;
+		}
 	}
 
-	if (threshold >= PAGE_SIZE)
+	if (threshold >= PAGE_SIZE || (dict && algo))
 		return -EINVAL;
 
 	down_read(&zram->init_lock);
@@ -1762,6 +2267,11 @@ static ssize_t recompress_store(struct device *dev,
 		goto release_init_lock;
 	}
 
+	if (dict && !zcomp_has_dict(zram->comps[ZRAM_PRIMARY_COMP])) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
 	if (algo) {
 		bool found = false;
 
@@ -1808,11 +2318,16 @@ static ssize_t recompress_store(struct device *dev,
 		if (zram_test_flag(zram, index, ZRAM_WB) ||
 		    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
 		    zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_DEDUP) ||
 		    zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
 			goto next;
 
-		err = zram_recompress(zram, index, page, threshold,
-				      prio, prio_max);
+		if (dict)
+			err = zram_recompress_dict(zram, index, page,
+						   threshold);
+		else
+			err = zram_recompress(zram, index, page, threshold,
+					      prio, prio_max);
 next:
 		zram_slot_unlock(zram, index);
 		if (err) {
@@ -1929,6 +2444,97 @@ static void zram_bio_write(struct zram *zram, struct bio *bio)
 	bio_endio(bio);
 }
 
+struct zram_async_page {
+	struct work_struct work;
+	struct zram_async_bio *abio;
+	struct page *page;
+	u32 index;
+};
+
+struct zram_async_bio {
+	struct zram *zram;
+	struct bio *bio;
+	unsigned long start_time;
+	atomic_t pending;
+	struct zram_async_page pages[];
+};
+
+static void zram_async_write_work(struct work_struct *work)
+{
+	struct zram_async_page *ap =
+		container_of(work, struct zram_async_page, work);
+	struct zram_async_bio *abio = ap->abio;
+	struct zram *zram = abio->zram;
+
+	if (zram_write_page(zram, ap->page, ap->index) < 0) {
+		atomic64_inc(&zram->stats.failed_writes);
+		WRITE_ONCE(abio->bio->bi_status, BLK_STS_IOERR);
+	} else {
+		zram_slot_lock(zram, ap->index);
+		zram_accessed(zram, ap->index);
+		zram_slot_unlock(zram, ap->index);
+	}
+	atomic64_inc(&zram->stats.async_writes);
+
+	/* the last page completes the whole bio */
+	if (atomic_dec_and_test(&abio->pending)) {
+		bio_end_io_acct(abio->bio, abio->start_time);
+		bio_endio(abio->bio);
+		kfree(abio);
+	}
+}
+
+/*
+ * Hand every page of a write to the per-device workqueue, so that the pages
+ * of a large write are compressed in parallel, each with the compression
+ * stream of the CPU its worker runs on, while the submitter moves on.
+ * Returns false if the bio has to be written synchronously: partial pages
+ * need a read-modify-write, and a failed allocation must not fail the I/O.
+ */
+static bool zram_bio_write_async(struct zram *zram, struct bio *bio)
+{
+	struct bvec_iter iter = bio->bi_iter;
+	struct zram_async_bio *abio;
+	unsigned int i, nr_pages;
+
+	if (!zram->async_write ||
+	    (iter.bi_sector & (SECTORS_PER_PAGE - 1)) ||
+	    !IS_ALIGNED(iter.bi_size, PAGE_SIZE))
+		return false;
+
+	nr_pages = iter.bi_size >> PAGE_SHIFT;
+	abio = kmalloc(struct_size(abio, pages, nr_pages),
+		       GFP_NOIO | __GFP_NOWARN);
+	if (!abio)
+		return false;
+
+	for (i = 0; i < nr_pages; i++) {
+		struct bio_vec bv = bio_iter_iovec(bio, iter);
+
+		if (is_partial_io(&bv)) {
+			kfree(abio);
+			return false;
+		}
+
+		abio->pages[i].abio = abio;
+		abio->pages[i].page = bv.bv_page;
+		abio->pages[i].index = iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
+		INIT_WORK(&abio->pages[i].work, zram_async_write_work);
+		bio_advance_iter_single(bio, &iter, bv.bv_len);
+	}
+
+	abio->zram = zram;
+	abio->bio = bio;
+	abio->start_time = bio_start_io_acct(bio);
+	atomic_set(&abio->pending, nr_pages);
+	atomic64_inc(&zram->stats.async_bios);
+
+	for (i = 0; i < nr_pages; i++)
+		queue_work(zram->async_wq, &abio->pages[i].work);
+
+	return true;
+}
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -1941,7 +2547,8 @@ static void zram_submit_bio(struct bio *bio)
 		zram_bio_read(zram, bio);
 		break;
 	case REQ_OP_WRITE:
-		zram_bio_write(zram, bio);
+		if (!zram_bio_write_async(zram, bio))
+			zram_bio_write(zram, bio);
 		break;
 	case REQ_OP_DISCARD:
 	case REQ_OP_WRITE_ZEROES:
@@ -1999,6 +2606,9 @@ static void zram_reset_device(struct zram *zram)
 	set_capacity_and_notify(zram->disk, 0);
 	part_stat_set_all(zram->disk->part0, 0);
 
+	/* wait for the pages still being compressed by async writes */
+	flush_workqueue(zram->async_wq);
+
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(zram, zram->disksize);
 	zram->disksize = 0;
@@ -2135,6 +2745,13 @@ static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
+static DEVICE_ATTR_RW(async_write);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
+#ifdef CONFIG_ZRAM_ZSTD_DICT
+static DEVICE_ATTR_WO(train_dict);
+#endif
 static DEVICE_ATTR_RW(comp_algorithm);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
@@ -2156,6 +2773,13 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
+	&dev_attr_async_write.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
+#ifdef CONFIG_ZRAM_ZSTD_DICT
+	&dev_attr_train_dict.attr,
+#endif
 	&dev_attr_comp_algorithm.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
@@ -2201,13 +2825,25 @@ static int zram_add(void)
 	spin_lock_init(&zram->wb_limit_lock);
 #endif
 
+	/*
+	 * Unbound and able to make progress under memory pressure: async
+	 * writes are mostly swap-out, and they should be spread over all
+	 * CPUs rather than follow the submitter.
+	 */
+	zram->async_wq = alloc_workqueue("zram%d", WQ_UNBOUND | WQ_HIGHPRI |
+					 WQ_MEM_RECLAIM, 0, device_id);
+	if (!zram->async_wq) {
+		ret = -ENOMEM;
+		goto out_free_idr;
+	}
+
 	/* gendisk structure */
 	zram->disk = blk_alloc_disk(NUMA_NO_NODE);
 	if (!zram->disk) {
 		pr_err("Error allocating disk structure for device %d\n",
 			device_id);
 		ret = -ENOMEM;
-		goto out_free_idr;
+		goto out_free_wq;
 	}
 
 	zram->disk->major = zram_major;
@@ -2260,6 +2896,8 @@ static int zram_add(void)
 
 out_cleanup_disk:
 	put_disk(zram->disk);
+out_free_wq:
+	destroy_workqueue(zram->async_wq);
 out_free_idr:
 	idr_remove(&zram_index_idr, device_id);
 out_free_dev:
@@ -2311,6 +2949,7 @@ static int zram_remove(struct zram *zram)
 	zram_reset_device(zram);
 
 	put_disk(zram->disk);
+	destroy_workqueue(zram->async_wq);
 	kfree(zram);
 	return 0;
 }
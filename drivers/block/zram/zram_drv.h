@@ -16,6 +16,8 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/rwsem.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 
@@ -53,6 +55,8 @@ enum zram_pageflags {
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
 	ZRAM_INCOMPRESSIBLE, /* none of the algorithms could compress it */
+	ZRAM_DEDUP,	/* handle points to a shared zram_dedup_entry */
+	ZRAM_DICT,	/* compressed with the zstd dictionary of the device */
 
 	ZRAM_COMP_PRIORITY_BIT1, /* First bit of comp priority index */
 	ZRAM_COMP_PRIORITY_BIT2, /* Second bit of comp priority index */
@@ -74,6 +78,23 @@ struct zram_table_entry {
 #endif
 };
 
+/*
+ * Compressed object shared by all the slots that stored the same content.
+ * ZRAM_DEDUP slots hold a pointer to it instead of a zsmalloc handle.
+ */
+struct zram_dedup_entry {
+	struct rb_node node;
+	u64 checksum;		/* xxh64 of the uncompressed page */
+	unsigned long handle;
+	unsigned int len;
+	unsigned int refcount;	/* protected by the bucket lock */
+};
+
+struct zram_dedup_bucket {
+	spinlock_t lock;
+	struct rb_root root;	/* entries sorted by checksum */
+};
+
 struct zram_stats {
 	atomic64_t compr_data_size;	/* compressed size of pages stored */
 	atomic64_t failed_reads;	/* can happen when memory is too low */
@@ -86,6 +107,11 @@ struct zram_stats {
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
 	atomic64_t miss_free;		/* no. of missed free */
+	atomic64_t async_writes;	/* no. of pages written by workers */
+	atomic64_t async_bios;		/* no. of bios written by workers */
+	atomic64_t dedup_hits;		/* no. of writes sharing an object */
+	atomic64_t dedup_misses;	/* no. of new objects indexed */
+	atomic64_t dedup_saved;		/* compressed bytes not stored twice */
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
@@ -127,6 +153,14 @@ struct zram {
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by disk->open_mutex */
+	/* compress full page writes in async_wq instead of the submitter */
+	bool async_write;
+	struct workqueue_struct *async_wq;
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_dedup_bucket *dedup_buckets;
+	unsigned long dedup_mask;
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	struct file *backing_dev;
 	spinlock_t wb_limit_lock;
@@ -517,6 +517,7 @@ struct cache_set {
 	struct kobject		kobj;
 	struct kobject		internal;
 	struct dentry		*debug;
+	struct dentry		*debug_bset_search;
 	struct cache_accounting accounting;
 
 	unsigned long		flags;
@@ -709,6 +710,11 @@ struct cache_set {
 	struct time_stats	btree_split_time;
 	struct time_stats	btree_read_time;
 
+	/* How long each phase of run_cache_set() took, in ns */
+	uint64_t		attach_journal_read_time;
+	uint64_t		attach_btree_check_time;
+	uint64_t		attach_journal_replay_time;
+
 	atomic_long_t		cache_read_races;
 	atomic_long_t		writeback_keys_done;
 	atomic_long_t		writeback_keys_failed;
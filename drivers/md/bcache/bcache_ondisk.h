@@ -181,7 +181,8 @@ struct cache_sb_disk {
 	__le64			feature_incompat;
 	__le64			feature_ro_compat;
 
-	__le64			pad[5];
+	__le64			clean_seq;	/* seq of the clean shutdown sb */
+	__le64			pad[4];
 
 	union {
 	struct {
@@ -243,6 +244,8 @@ struct cache_sb {
 	__u64			feature_incompat;
 	__u64			feature_ro_compat;
 
+	__u64			clean_seq;
+
 	union {
 	struct {
 		/* Cache devices */
@@ -288,6 +291,7 @@ BITMASK(CACHE_REPLACEMENT,		struct cache_sb, flags, 2, 3);
 #define CACHE_REPLACEMENT_LRU		0U
 #define CACHE_REPLACEMENT_FIFO		1U
 #define CACHE_REPLACEMENT_RANDOM	2U
+BITMASK(CACHE_CLEAN,			struct cache_sb, flags, 5, 1);
 
 BITMASK(BDEV_CACHE_MODE,		struct cache_sb, flags, 0, 4);
 #define CACHE_MODE_WRITETHROUGH		0U
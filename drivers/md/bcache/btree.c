@@ -1047,6 +1047,61 @@ static void btree_node_prefetch(struct btree *parent, struct bkey *k)
 	}
 }
 
+/*
+ * Asynchronous version of btree_node_prefetch(), for walking the whole btree:
+ * the node is read from a workqueue, so that several reads are in flight while
+ * the caller works on the node before it. The node is left in the btree cache
+ * for bch_btree_node_get() to find.
+ */
+struct btree_readahead {
+	struct work_struct	work;
+	struct cache_set	*c;
+	int			level;
+	BKEY_PADDED(key);
+};
+
+static void btree_node_readahead_fn(struct work_struct *work)
+{
+	struct btree_readahead *ra = container_of(work, struct btree_readahead,
+						  work);
+	struct cache_set *c = ra->c;
+	struct btree *b;
+
+	mutex_lock(&c->bucket_lock);
+	b = mca_alloc(c, NULL, &ra->key, ra->level);
+	mutex_unlock(&c->bucket_lock);
+
+	/* readahead must not hold up the btree cache reclaim */
+	bch_cannibalize_unlock(c);
+
+	if (!IS_ERR_OR_NULL(b)) {
+		bch_btree_node_read(b);
+		rw_unlock(true, b);
+	}
+
+	kfree(ra);
+}
+
+static void btree_node_readahead(struct workqueue_struct *wq,
+				 struct btree *parent, struct bkey *k)
+{
+	struct btree_readahead *ra;
+
+	if (mca_find(parent->c, k))
+		return;
+
+	ra = kmalloc(sizeof(*ra), GFP_NOIO);
+	if (!ra)
+		return;
+
+	INIT_WORK(&ra->work, btree_node_readahead_fn);
+	ra->c = parent->c;
+	ra->level = parent->level - 1;
+	bkey_copy(&ra->key, k);
+
+	queue_work(wq, &ra->work);
+}
+
 /* Btree alloc */
 
 static void btree_node_free(struct btree *b)
@@ -1872,11 +1927,13 @@ int bch_gc_thread_start(struct cache_set *c)
 
 /* Initial partial gc */
 
-static int bch_btree_check_recurse(struct btree *b, struct btree_op *op)
+static int bch_btree_check_recurse(struct btree *b, struct btree_op *op,
+				   struct workqueue_struct *ra_wq)
 {
 	int ret = 0;
-	struct bkey *k, *p = NULL;
-	struct btree_iter iter;
+	unsigned int ahead = 0;
+	struct bkey *k;
+	struct btree_iter iter, ra_iter;
 
 	for_each_key_filter(&b->keys, k, &iter, bch_ptr_invalid)
 		bch_initial_mark_key(b->c, b->level, k);
@@ -1885,24 +1942,35 @@ static int bch_btree_check_recurse(struct btree *b, struct btree_op *op)
 
 	if (b->level) {
 		bch_btree_iter_init(&b->keys, &iter, NULL);
+		bch_btree_iter_init(&b->keys, &ra_iter, NULL);
 
 		do {
+			/*
+			 * Keep the next BCH_BTR_CHECK_READAHEAD children
+			 * being read while checking the current one.
+			 */
+			while (ahead < BCH_BTR_CHECK_READAHEAD &&
+			       (k = bch_btree_iter_next_filter(&ra_iter,
+							       &b->keys,
+							       bch_ptr_bad))) {
+				btree_node_readahead(ra_wq, b, k);
+				ahead++;
+			}
+
 			k = bch_btree_iter_next_filter(&iter, &b->keys,
 						       bch_ptr_bad);
-			if (k) {
-				btree_node_prefetch(b, k);
-				/*
-				 * initiallize c->gc_stats.nodes
-				 * for incremental GC
-				 */
-				b->c->gc_stats.nodes++;
-			}
+			if (!k)
+				break;
+			ahead--;
 
-			if (p)
-				ret = bcache_btree(check_recurse, p, b, op);
+			/*
+			 * initiallize c->gc_stats.nodes
+			 * for incremental GC
+			 */
+			b->c->gc_stats.nodes++;
 
-			p = k;
-		} while (p && !ret);
+			ret = bcache_btree(check_recurse, k, b, op, ra_wq);
+		} while (!ret);
 	}
 
 	return ret;
@@ -1969,7 +2037,8 @@ static int bch_btree_check_thread(void *arg)
 			btree_node_prefetch(c->root, p);
 			c->gc_stats.nodes++;
 			bch_btree_op_init(&op, 0);
-			ret = bcache_btree(check_recurse, p, c->root, &op);
+			ret = bcache_btree(check_recurse, p, c->root, &op,
+					   check_state->ra_wq);
 			/*
 			 * The op may be added to cache_set's btree_cache_wait
 			 * in mca_cannibalize(), must ensure it is removed from
@@ -2037,6 +2106,11 @@ int bch_btree_check(struct cache_set *c)
 	atomic_set(&check_state.enough, 0);
 	init_waitqueue_head(&check_state.wait);
 
+	check_state.ra_wq = alloc_workqueue("bch_btrchk_ra",
+					    WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!check_state.ra_wq)
+		return -ENOMEM;
+
 	rw_lock(0, c->root, c->root->level);
 	/*
 	 * Run multiple threads to check btree nodes in parallel,
@@ -2081,6 +2155,8 @@ int bch_btree_check(struct cache_set *c)
 
 out:
 	rw_unlock(0, c->root);
+	/* waits for the readahead still in flight */
+	destroy_workqueue(check_state.ra_wq);
 	return ret;
 }
 
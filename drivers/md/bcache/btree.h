@@ -227,8 +227,10 @@ struct btree_check_info {
 };
 
 #define BCH_BTR_CHKTHREAD_MAX	12
+#define BCH_BTR_CHECK_READAHEAD	8
 struct btree_check_state {
 	struct cache_set		*c;
+	struct workqueue_struct		*ra_wq;
 	int				total_threads;
 	int				key_idx;
 	spinlock_t			idx_lock;
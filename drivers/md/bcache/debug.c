@@ -15,6 +15,7 @@
 #include <linux/debugfs.h>
 #include <linux/module.h>
 #include <linux/random.h>
+#include <linux/sched/clock.h>
 #include <linux/seq_file.h>
 
 struct dentry *bcache_debug;
@@ -234,14 +235,107 @@ static const struct file_operations cache_set_debug_ops = {
 	.release	= bch_dump_release
 };
 
+#ifdef CONFIG_BCACHE_DEBUG
+
+#define BSET_SEARCH_BENCH_KEYS		4096
+#define BSET_SEARCH_BENCH_VERIFY	16
+
+/*
+ * Time __bch_bset_search() for keys spread over each bset of the root node,
+ * and check every BSET_SEARCH_BENCH_VERIFY'th result against a linear search.
+ */
+static void bset_search_bench(struct seq_file *m, struct btree_keys *b,
+			      struct bset_tree *t, struct bkey **keys)
+{
+	unsigned int nr = 0, total = 0, stride, i, bad = 0;
+	struct bkey *k, *r;
+	uint64_t start, ns;
+
+	for (k = t->data->start; k < bset_bkey_last(t->data); k = bkey_next(k))
+		total++;
+	if (!total)
+		return;
+
+	stride = DIV_ROUND_UP(total, BSET_SEARCH_BENCH_KEYS);
+	for (k = t->data->start, i = 0;
+	     k < bset_bkey_last(t->data);
+	     k = bkey_next(k), i++)
+		if (!(i % stride))
+			keys[nr++] = k;
+
+	start = local_clock();
+	for (i = 0; i < nr; i++)
+		__bch_bset_search(b, t, keys[i]);
+	ns = local_clock() - start;
+
+	for (i = 0; i < nr; i += BSET_SEARCH_BENCH_VERIFY) {
+		r = __bch_bset_search(b, t, keys[i]);
+
+		for (k = t->data->start;
+		     k < bset_bkey_last(t->data) && bkey_cmp(k, keys[i]) <= 0;
+		     k = bkey_next(k))
+			;
+		if (k != r)
+			bad++;
+	}
+
+	seq_printf(m, "set %u: %u keys, %s, %llu ns/search, %u mismatches\n",
+		   (unsigned int) (t - b->set), total,
+		   !t->size ? "linear" :
+		   bset_written(b, t) ? "search tree" : "lookup table",
+		   div_u64(ns, nr), bad);
+}
+
+static int bch_bset_search_show(struct seq_file *m, void *v)
+{
+	struct cache_set *c = m->private;
+	struct bset_tree *t;
+	struct bkey **keys;
+	struct btree *b;
+
+	if (!test_bit(CACHE_SET_RUNNING, &c->flags))
+		return -EBUSY;
+
+	keys = kvmalloc_array(BSET_SEARCH_BENCH_KEYS, sizeof(*keys),
+			      GFP_KERNEL);
+	if (!keys)
+		return -ENOMEM;
+
+	while (1) {
+		b = c->root;
+		rw_lock(false, b, b->level);
+		if (b == c->root)
+			break;
+		rw_unlock(false, b);
+	}
+
+	seq_printf(m, "root node, level %u\n", b->level);
+	for (t = b->keys.set; t <= bset_tree_last(&b->keys); t++)
+		bset_search_bench(m, &b->keys, t, keys);
+
+	rw_unlock(false, b);
+	kvfree(keys);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bch_bset_search);
+
+#endif
+
 void bch_debug_init_cache_set(struct cache_set *c)
 {
 	if (!IS_ERR_OR_NULL(bcache_debug)) {
-		char name[50];
+		char name[64];
 
-		snprintf(name, 50, "bcache-%pU", c->set_uuid);
+		snprintf(name, sizeof(name), "bcache-%pU", c->set_uuid);
 		c->debug = debugfs_create_file(name, 0400, bcache_debug, c,
 					       &cache_set_debug_ops);
+#ifdef CONFIG_BCACHE_DEBUG
+		snprintf(name, sizeof(name), "bcache-%pU-bset_search",
+			 c->set_uuid);
+		c->debug_bset_search = debugfs_create_file(name, 0400,
+						bcache_debug, c,
+						&bch_bset_search_fops);
+#endif
 	}
 }
 
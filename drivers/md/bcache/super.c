@@ -187,6 +187,7 @@ static const char *read_super(struct cache_sb *sb, struct block_device *bdev,
 
 	sb->flags		= le64_to_cpu(s->flags);
 	sb->seq			= le64_to_cpu(s->seq);
+	sb->clean_seq		= le64_to_cpu(s->clean_seq);
 	sb->last_mount		= le32_to_cpu(s->last_mount);
 	sb->keys		= le16_to_cpu(s->keys);
 
@@ -304,6 +305,7 @@ static void __write_super(struct cache_sb *sb, struct cache_sb_disk *out,
 
 	out->flags		= cpu_to_le64(sb->flags);
 	out->seq		= cpu_to_le64(sb->seq);
+	out->clean_seq		= cpu_to_le64(sb->clean_seq);
 
 	out->last_mount		= cpu_to_le32(sb->last_mount);
 	out->first_bucket	= cpu_to_le16(sb->first_bucket);
@@ -1674,6 +1676,7 @@ static void cache_set_free(struct closure *cl)
 	struct cache *ca;
 
 	debugfs_remove(c->debug);
+	debugfs_remove(c->debug_bset_search);
 
 	bch_open_buckets_free(c);
 	bch_btree_cache_free(c);
@@ -1709,6 +1712,37 @@ static void cache_set_free(struct closure *cl)
 	kobject_put(&c->kobj);
 }
 
+/*
+ * Once all the btree nodes are on disk the journal doesn't need to be replayed
+ * next time: flag the superblock, see run_cache_set().
+ */
+static void cache_set_write_clean(struct cache_set *c)
+{
+	struct cache *ca = c->cache;
+	struct btree *b;
+
+	if (!test_bit(CACHE_SET_RUNNING, &c->flags) ||
+	    !CACHE_SYNC(&ca->sb))
+		return;
+
+	list_for_each_entry(b, &c->btree_cache, list) {
+		/* wait for the writes still in flight */
+		down(&b->io_mutex);
+		up(&b->io_mutex);
+
+		if (btree_node_dirty(b) || btree_node_io_error(b))
+			return;
+	}
+
+	if (test_bit(CACHE_SET_IO_DISABLE, &c->flags))
+		return;
+
+	SET_CACHE_CLEAN(&ca->sb, true);
+	/* bcache_write_super() bumps seq */
+	ca->sb.clean_seq = ca->sb.seq + 1;
+	bcache_write_super(c);
+}
+
 static void cache_set_flush(struct closure *cl)
 {
 	struct cache_set *c = container_of(cl, struct cache_set, caching);
@@ -1747,6 +1781,8 @@ static void cache_set_flush(struct closure *cl)
 		c->journal.work.work.func(&c->journal.work.work);
 	}
 
+	cache_set_write_clean(c);
+
 	closure_return(cl);
 }
 
@@ -1974,6 +2010,7 @@ static int run_cache_set(struct cache_set *c)
 	struct closure cl;
 	LIST_HEAD(journal);
 	struct journal_replay *l;
+	uint64_t start_time;
 
 	closure_init_stack(&cl);
 
@@ -1983,10 +2020,26 @@ static int run_cache_set(struct cache_set *c)
 	if (CACHE_SYNC(&c->cache->sb)) {
 		struct bkey *k;
 		struct jset *j;
+		/*
+		 * A kernel that doesn't know about CACHE_CLEAN bumps seq
+		 * without clearing the flag, so clean_seq must match too.
+		 */
+		bool clean = CACHE_CLEAN(&ca->sb) &&
+			     ca->sb.clean_seq == ca->sb.seq;
+
+		if (CACHE_CLEAN(&ca->sb)) {
+			/* must be on disk before anything else is written */
+			SET_CACHE_CLEAN(&ca->sb, false);
+			bcache_write_super(c);
+			down(&c->sb_write_mutex);
+			up(&c->sb_write_mutex);
+		}
 
+		start_time = local_clock();
 		err = "cannot allocate memory for journal";
 		if (bch_journal_read(c, &journal))
 			goto err;
+		c->attach_journal_read_time = local_clock() - start_time;
 
 		pr_debug("btree_journal_read() done\n");
 
@@ -2026,12 +2079,14 @@ static int run_cache_set(struct cache_set *c)
 		if (err)
 			goto err;
 
+		start_time = local_clock();
 		err = "error in recovery";
 		if (bch_btree_check(c))
 			goto err;
 
 		bch_journal_mark(c, &journal);
 		bch_initial_gc_finish(c);
+		c->attach_btree_check_time = local_clock() - start_time;
 		pr_debug("btree_check() done\n");
 
 		/*
@@ -2058,9 +2113,29 @@ static int run_cache_set(struct cache_set *c)
 		if (j->version < BCACHE_JSET_VERSION_UUID)
 			__uuid_write(c);
 
-		err = "bcache: replay journal failed";
-		if (bch_journal_replay(c, &journal))
-			goto err;
+		if (clean) {
+			/*
+			 * Every key in the journal made it into a btree node
+			 * written out at shutdown, there's nothing to replay.
+			 */
+			pr_info("clean shutdown, skipping journal replay\n");
+			while (!list_empty(&journal)) {
+				l = list_first_entry(&journal,
+						     struct journal_replay, list);
+				list_del(&l->list);
+				/* drop the pin bch_journal_mark() took */
+				if (l->pin)
+					atomic_dec(l->pin);
+				kfree(l);
+			}
+		} else {
+			start_time = local_clock();
+			err = "bcache: replay journal failed";
+			if (bch_journal_replay(c, &journal))
+				goto err;
+			c->attach_journal_replay_time =
+				local_clock() - start_time;
+		}
 	} else {
 		unsigned int j;
 
@@ -84,6 +84,10 @@ sysfs_time_stats_attribute(btree_split, sec, us);
 sysfs_time_stats_attribute(btree_sort,	ms,  us);
 sysfs_time_stats_attribute(btree_read,	ms,  us);
 
+read_attribute(attach_journal_read_ms);
+read_attribute(attach_btree_check_ms);
+read_attribute(attach_journal_replay_ms);
+
 read_attribute(btree_nodes);
 read_attribute(btree_used_percent);
 read_attribute(average_key_size);
@@ -748,6 +752,13 @@ SHOW(__bch_cache_set)
 	sysfs_print_time_stats(&c->sort.time,		btree_sort, ms, us);
 	sysfs_print_time_stats(&c->btree_read_time,	btree_read, ms, us);
 
+	sysfs_print(attach_journal_read_ms,
+		    div_u64(c->attach_journal_read_time, NSEC_PER_MSEC));
+	sysfs_print(attach_btree_check_ms,
+		    div_u64(c->attach_btree_check_time, NSEC_PER_MSEC));
+	sysfs_print(attach_journal_replay_ms,
+		    div_u64(c->attach_journal_replay_time, NSEC_PER_MSEC));
+
 	sysfs_print(btree_used_percent,	bch_btree_used(c));
 	sysfs_print(btree_nodes,	c->gc_stats.nodes);
 	sysfs_hprint(average_key_size,	bch_average_key_size(c));
@@ -993,6 +1004,10 @@ static struct attribute *bch_cache_set_internal_attrs[] = {
 	sysfs_time_stats_attribute_list(btree_sort, ms, us)
 	sysfs_time_stats_attribute_list(btree_read, ms, us)
 
+	&sysfs_attach_journal_read_ms,
+	&sysfs_attach_btree_check_ms,
+	&sysfs_attach_journal_replay_ms,
+
 	&sysfs_btree_nodes,
 	&sysfs_btree_used_percent,
 	&sysfs_btree_cache_max_chain,
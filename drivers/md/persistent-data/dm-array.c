@@ -275,6 +275,53 @@ static int insert_ablock(struct dm_array_info *info, uint64_t index,
 	return dm_btree_insert(&info->btree_info, *root, &index, &block_le, root);
 }
 
+/*
+ * New array blocks have consecutive indexes, they're queued here and
+ * inserted into the btree together, with one walk per leaf.
+ */
+#define ABLOCK_BATCH_SIZE 16
+
+struct ablock_batch {
+	unsigned int nr;
+	uint64_t indexes[ABLOCK_BATCH_SIZE];
+	__le64 blocks_le[ABLOCK_BATCH_SIZE];
+};
+
+static int flush_ablocks(struct dm_array_info *info, struct ablock_batch *batch,
+			 dm_block_t *root)
+{
+	int r;
+	unsigned int nr_inserted;
+
+	if (!batch->nr)
+		return 0;
+
+	/* the array btree has a single level, indexes are the leaf keys */
+	__dm_bless_for_disk(batch->blocks_le);
+	r = dm_btree_insert_many(&info->btree_info, *root, batch->indexes,
+				 batch->indexes, batch->blocks_le, batch->nr,
+				 root, &nr_inserted);
+	batch->nr = 0;
+
+	return r;
+}
+
+/*
+ * Queues an array block for insertion, and inserts the batch once it's
+ * full.  The block may be unlocked straight away.
+ */
+static int queue_ablock(struct dm_array_info *info, struct ablock_batch *batch,
+			uint64_t index, struct dm_block *block, dm_block_t *root)
+{
+	batch->indexes[batch->nr] = index;
+	batch->blocks_le[batch->nr] = cpu_to_le64(dm_block_location(block));
+
+	if (++batch->nr < ABLOCK_BATCH_SIZE)
+		return 0;
+
+	return flush_ablocks(info, batch, root);
+}
+
 /*----------------------------------------------------------------*/
 
 static int __shadow_ablock(struct dm_array_info *info, dm_block_t b,
@@ -371,12 +418,25 @@ static int insert_full_ablocks(struct dm_array_info *info, size_t size_of_block,
 			       unsigned int max_entries, const void *value,
 			       dm_block_t *root)
 {
-	int r = 0;
+	int r = 0, r2;
+	struct dm_block *block;
+	struct array_block *ab;
+	struct ablock_batch batch = { .nr = 0 };
 
-	for (; !r && begin_block != end_block; begin_block++)
-		r = insert_new_ablock(info, size_of_block, max_entries, begin_block, max_entries, value, root);
+	for (; !r && begin_block != end_block; begin_block++) {
+		r = alloc_ablock(info, size_of_block, max_entries, &block, &ab);
+		if (r)
+			break;
 
-	return r;
+		fill_ablock(info, ab, value, max_entries);
+		r = queue_ablock(info, &batch, begin_block, block, root);
+		unlock_ablock(info, block);
+	}
+
+	/* insert whatever was allocated, even after a failure */
+	r2 = flush_ablocks(info, &batch, root);
+
+	return r ? r : r2;
 }
 
 /*
@@ -735,6 +795,8 @@ int dm_array_new(struct dm_array_info *info, dm_block_t *root,
 	struct dm_block *block;
 	struct array_block *ab;
 	unsigned int block_index, end_block, size_of_block, max_entries;
+	struct ablock_batch batch = { .nr = 0 };
+	int r2;
 
 	r = dm_array_empty(info, root);
 	if (r)
@@ -757,7 +819,7 @@ int dm_array_new(struct dm_array_info *info, dm_block_t *root,
 			break;
 		}
 
-		r = insert_ablock(info, block_index, block, root);
+		r = queue_ablock(info, &batch, block_index, block, root);
 		unlock_ablock(info, block);
 		if (r)
 			break;
@@ -765,7 +827,9 @@ int dm_array_new(struct dm_array_info *info, dm_block_t *root,
 		size -= max_entries;
 	}
 
-	return r;
+	r2 = flush_ablocks(info, &batch, root);
+
+	return r ? r : r2;
 }
 EXPORT_SYMBOL_GPL(dm_array_new);
 
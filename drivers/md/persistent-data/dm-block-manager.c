@@ -15,6 +15,8 @@
 #include <linux/device-mapper.h>
 #include <linux/stacktrace.h>
 #include <linux/sched/task.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
 
 #define DM_MSG_PREFIX "block manager"
 
@@ -347,6 +349,8 @@ EXPORT_SYMBOL_GPL(dm_block_data);
 struct buffer_aux {
 	struct dm_block_validator *validator;
 	int write_locked;
+	/* checksummed by dm_bm_prepare_for_write() since the last write lock */
+	bool prepared;
 
 #ifdef CONFIG_DM_DEBUG_BLOCK_MANAGER_LOCKING
 	struct block_lock lock;
@@ -358,6 +362,7 @@ static void dm_block_manager_alloc_callback(struct dm_buffer *buf)
 	struct buffer_aux *aux = dm_bufio_get_aux_data(buf);
 
 	aux->validator = NULL;
+	aux->prepared = false;
 	bl_init(&aux->lock);
 }
 
@@ -365,7 +370,7 @@ static void dm_block_manager_write_callback(struct dm_buffer *buf)
 {
 	struct buffer_aux *aux = dm_bufio_get_aux_data(buf);
 
-	if (aux->validator) {
+	if (aux->validator && !aux->prepared) {
 		aux->validator->prepare_for_write(aux->validator, (struct dm_block *) buf,
 			 dm_bufio_get_block_size(dm_bufio_get_client(buf)));
 	}
@@ -517,6 +522,7 @@ int dm_bm_write_lock(struct dm_block_manager *bm,
 	}
 
 	aux->write_locked = 1;
+	aux->prepared = false;
 
 	r = dm_bm_validate_buffer(bm, to_buffer(*result), aux, v);
 	if (unlikely(r)) {
@@ -587,6 +593,7 @@ int dm_bm_write_lock_zero(struct dm_block_manager *bm,
 	}
 
 	aux->write_locked = 1;
+	aux->prepared = false;
 	aux->validator = v;
 
 	return 0;
@@ -621,6 +628,101 @@ void dm_bm_prefetch(struct dm_block_manager *bm, dm_block_t b)
 	dm_bufio_prefetch(bm->bufio, b, 1);
 }
 
+/*
+ * Below this many blocks the checksums are left to the write callback,
+ * queueing the work would cost more than it saves.
+ */
+#define PREPARE_BATCH_SIZE 64
+
+struct prepare_work {
+	struct work_struct work;
+	struct dm_block_manager *bm;
+	struct dm_buffer **bufs;
+	unsigned int nr;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+static void prepare_work_fn(struct work_struct *ws)
+{
+	struct prepare_work *w = container_of(ws, struct prepare_work, work);
+	size_t block_size = dm_bufio_get_block_size(w->bm->bufio);
+	struct buffer_aux *aux;
+	unsigned int i;
+
+	for (i = 0; i < w->nr; i++) {
+		aux = dm_bufio_get_aux_data(w->bufs[i]);
+		aux->validator->prepare_for_write(aux->validator,
+						  (struct dm_block *) w->bufs[i],
+						  block_size);
+		aux->prepared = true;
+	}
+
+	if (atomic_dec_and_test(w->pending))
+		complete(w->done);
+}
+
+void dm_bm_prepare_for_write(struct dm_block_manager *bm,
+			     dm_block_t *blocks, unsigned int nr_blocks)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct prepare_work *works;
+	struct dm_buffer **bufs;
+	struct buffer_aux *aux;
+	unsigned int i, nr = 0, nr_works;
+	atomic_t pending;
+	void *p;
+
+	if (dm_bm_is_read_only(bm) || nr_blocks < 2 * PREPARE_BATCH_SIZE)
+		return;
+
+	bufs = kvmalloc_array(nr_blocks, sizeof(*bufs), GFP_NOIO);
+	if (!bufs)
+		return;
+
+	for (i = 0; i < nr_blocks; i++) {
+		p = dm_bufio_get(bm->bufio, blocks[i], bufs + nr);
+		if (IS_ERR_OR_NULL(p))
+			continue;
+
+		aux = dm_bufio_get_aux_data(bufs[nr]);
+		if (!aux->validator || aux->prepared) {
+			dm_bufio_release(bufs[nr]);
+			continue;
+		}
+		nr++;
+	}
+
+	if (nr < 2 * PREPARE_BATCH_SIZE)
+		goto out;
+
+	nr_works = DIV_ROUND_UP(nr, PREPARE_BATCH_SIZE);
+	works = kmalloc_array(nr_works, sizeof(*works), GFP_NOIO);
+	if (!works)
+		goto out;
+
+	atomic_set(&pending, nr_works);
+	for (i = 0; i < nr_works; i++) {
+		INIT_WORK(&works[i].work, prepare_work_fn);
+		works[i].bm = bm;
+		works[i].bufs = bufs + i * PREPARE_BATCH_SIZE;
+		works[i].nr = min_t(unsigned int, PREPARE_BATCH_SIZE,
+				    nr - i * PREPARE_BATCH_SIZE);
+		works[i].pending = &pending;
+		works[i].done = &done;
+		queue_work(system_unbound_wq, &works[i].work);
+	}
+
+	wait_for_completion(&done);
+	kfree(works);
+out:
+	/* whatever wasn't prepared here is checksummed by the write callback */
+	for (i = 0; i < nr; i++)
+		dm_bufio_release(bufs[i]);
+	kvfree(bufs);
+}
+EXPORT_SYMBOL_GPL(dm_bm_prepare_for_write);
+
 bool dm_bm_is_read_only(struct dm_block_manager *bm)
 {
 	return bm ? bm->read_only : true;
@@ -113,6 +113,15 @@ int dm_bm_flush(struct dm_block_manager *bm);
  */
 void dm_bm_prefetch(struct dm_block_manager *bm, dm_block_t b);
 
+/*
+ * Computes the checksums of the given blocks in parallel, so the
+ * following dm_bm_flush() doesn't compute them one by one as it writes
+ * the blocks.  None of the blocks may be locked.  Blocks that aren't in
+ * core, or too few blocks to be worth it, are left alone.
+ */
+void dm_bm_prepare_for_write(struct dm_block_manager *bm,
+			     dm_block_t *blocks, unsigned int nr_blocks);
+
 /*
  * Switches the bm to a read only mode.  Once read-only mode
  * has been entered the following functions will return -EPERM.
@@ -1089,9 +1089,31 @@ static bool has_space_for_insert(struct btree_node *node, uint64_t key)
 	return true;
 }
 
+/*
+ * Lowers *@bound to the separator that follows the current node in its
+ * parent, if any.
+ */
+static void parent_bound(struct shadow_spine *s, uint64_t key, uint64_t *bound)
+{
+	struct btree_node *parent;
+	int i;
+
+	if (!shadow_has_parent(s))
+		return;
+
+	parent = dm_block_data(shadow_parent(s));
+	i = lower_bound(parent, key);
+	if (i + 1 < le32_to_cpu(parent->header.nr_entries))
+		*bound = min(*bound, le64_to_cpu(parent->keys[i + 1]));
+}
+
+/*
+ * If @bound isn't NULL, it's lowered to the lowest key known to be beyond
+ * the leaf that's reached, ie. the leaf covers keys up to *@bound - 1.
+ */
 static int btree_insert_raw(struct shadow_spine *s, dm_block_t root,
 			    struct dm_btree_value_type *vt,
-			    uint64_t key, unsigned int *index)
+			    uint64_t key, unsigned int *index, uint64_t *bound)
 {
 	int r, i = *index, top = 1;
 	struct btree_node *node;
@@ -1129,6 +1151,13 @@ static int btree_insert_raw(struct shadow_spine *s, dm_block_t root,
 
 			/* making space can cause the current node to change */
 			node = dm_block_data(shadow_current(s));
+
+			/*
+			 * and adds or moves a separator in the parent, so a
+			 * bound taken from it on the way down may be stale.
+			 */
+			if (bound)
+				parent_bound(s, key, bound);
 		}
 
 		i = lower_bound(node, key);
@@ -1142,6 +1171,9 @@ static int btree_insert_raw(struct shadow_spine *s, dm_block_t root,
 			i = 0;
 		}
 
+		if (bound && i + 1 < le32_to_cpu(node->header.nr_entries))
+			*bound = min(*bound, le64_to_cpu(node->keys[i + 1]));
+
 		root = value64(node, i);
 		top = 0;
 	}
@@ -1231,80 +1263,113 @@ static bool need_insert(struct btree_node *node, uint64_t *keys,
 		(le64_to_cpu(node->keys[index]) != keys[level]));
 }
 
-static int insert(struct dm_btree_info *info, dm_block_t root,
-		  uint64_t *keys, void *value, dm_block_t *new_root,
-		  int *inserted)
-		  __dm_written_to_disk(value)
+/*
+ * Walks down to the bottom level leaf for @leaf_key, creating the
+ * intermediate trees for @keys as needed, and leaves it as the current
+ * node of @spine with room for one more entry.
+ */
+static int insert_find_leaf(struct dm_btree_info *info,
+			    struct shadow_spine *spine, dm_block_t root,
+			    uint64_t *keys, uint64_t leaf_key,
+			    unsigned int *index, uint64_t *bound)
 {
 	int r;
-	unsigned int level, index = -1, last_level = info->levels - 1;
+	unsigned int level;
 	dm_block_t block = root;
-	struct shadow_spine spine;
 	struct btree_node *n;
 	struct dm_btree_value_type le64_type;
 
 	init_le64_type(info->tm, &le64_type);
-	init_shadow_spine(&spine, info);
 
 	for (level = 0; level < (info->levels - 1); level++) {
-		r = btree_insert_raw(&spine, block, &le64_type, keys[level], &index);
+		r = btree_insert_raw(spine, block, &le64_type, keys[level],
+				     index, NULL);
 		if (r < 0)
-			goto bad;
+			return r;
 
-		n = dm_block_data(shadow_current(&spine));
+		n = dm_block_data(shadow_current(spine));
 
-		if (need_insert(n, keys, level, index)) {
+		if (need_insert(n, keys, level, *index)) {
 			dm_block_t new_tree;
 			__le64 new_le;
 
 			r = dm_btree_empty(info, &new_tree);
 			if (r < 0)
-				goto bad;
+				return r;
 
 			new_le = cpu_to_le64(new_tree);
 			__dm_bless_for_disk(&new_le);
 
-			r = insert_at(sizeof(uint64_t), n, index,
+			r = insert_at(sizeof(uint64_t), n, *index,
 				      keys[level], &new_le);
 			if (r)
-				goto bad;
+				return r;
 		}
 
-		if (level < last_level)
-			block = value64(n, index);
+		block = value64(n, *index);
 	}
 
-	r = btree_insert_raw(&spine, block, &info->value_type,
-			     keys[level], &index);
+	return btree_insert_raw(spine, block, &info->value_type, leaf_key,
+				index, bound);
+}
+
+/*
+ * Stores @value at @index of leaf @n, which must have room for it if @key
+ * isn't there yet.  Returns 1 if a new entry was inserted, 0 for an
+ * overwrite.
+ */
+static int insert_into_leaf(struct dm_btree_info *info, struct btree_node *n,
+			    unsigned int index, uint64_t key, void *value)
+	__dm_written_to_disk(value)
+{
+	int r;
+
+	if (index >= le32_to_cpu(n->header.nr_entries) ||
+	    le64_to_cpu(n->keys[index]) != key) {
+		r = insert_at(info->value_type.size, n, index, key, value);
+		return r ? r : 1;
+	}
+
+	if (info->value_type.dec &&
+	    (!info->value_type.equal ||
+	     !info->value_type.equal(
+		     info->value_type.context,
+		     value_ptr(n, index),
+		     value))) {
+		info->value_type.dec(info->value_type.context,
+				     value_ptr(n, index), 1);
+	}
+	memcpy_disk(value_ptr(n, index),
+		    value, info->value_type.size);
+
+	return 0;
+}
+
+static int insert(struct dm_btree_info *info, dm_block_t root,
+		  uint64_t *keys, void *value, dm_block_t *new_root,
+		  int *inserted)
+		  __dm_written_to_disk(value)
+{
+	int r;
+	unsigned int index = -1, last_level = info->levels - 1;
+	struct shadow_spine spine;
+	struct btree_node *n;
+
+	init_shadow_spine(&spine, info);
+
+	r = insert_find_leaf(info, &spine, root, keys, keys[last_level],
+			     &index, NULL);
 	if (r < 0)
 		goto bad;
 
 	n = dm_block_data(shadow_current(&spine));
 
-	if (need_insert(n, keys, level, index)) {
-		if (inserted)
-			*inserted = 1;
+	r = insert_into_leaf(info, n, index, keys[last_level], value);
+	if (r < 0)
+		goto bad_unblessed;
 
-		r = insert_at(info->value_type.size, n, index,
-			      keys[level], value);
-		if (r)
-			goto bad_unblessed;
-	} else {
-		if (inserted)
-			*inserted = 0;
-
-		if (info->value_type.dec &&
-		    (!info->value_type.equal ||
-		     !info->value_type.equal(
-			     info->value_type.context,
-			     value_ptr(n, index),
-			     value))) {
-			info->value_type.dec(info->value_type.context,
-					     value_ptr(n, index), 1);
-		}
-		memcpy_disk(value_ptr(n, index),
-			    value, info->value_type.size);
-	}
+	if (inserted)
+		*inserted = r;
 
 	*new_root = shadow_root(&spine);
 	exit_shadow_spine(&spine);
@@ -1318,6 +1383,64 @@ static int insert(struct dm_btree_info *info, dm_block_t root,
 	return r;
 }
 
+/*
+ * Inserts as many of the sorted @leaf_keys as fit in the leaf of the first
+ * one, with a single walk down the spine.
+ */
+static int insert_batch(struct dm_btree_info *info, dm_block_t root,
+			uint64_t *keys, const uint64_t *leaf_keys,
+			void *values, unsigned int count,
+			dm_block_t *new_root, unsigned int *done,
+			unsigned int *nr_inserted)
+{
+	int r, i;
+	unsigned int index = -1;
+	uint64_t key, bound = ULLONG_MAX;
+	struct shadow_spine spine;
+	struct btree_node *n;
+	size_t size = info->value_type.size;
+
+	init_shadow_spine(&spine, info);
+
+	r = insert_find_leaf(info, &spine, root, keys, leaf_keys[0],
+			     &index, &bound);
+	if (r < 0)
+		goto out;
+
+	n = dm_block_data(shadow_current(&spine));
+
+	for (*done = 0; *done < count; (*done)++) {
+		key = leaf_keys[*done];
+
+		if (*done) {
+			if (key >= bound)
+				break;
+
+			i = lower_bound(n, key);
+			if (i < 0 || le64_to_cpu(n->keys[i]) != key) {
+				if (le32_to_cpu(n->header.nr_entries) ==
+				    le32_to_cpu(n->header.max_entries))
+					break;
+				i++;
+			}
+			index = i;
+		}
+
+		r = insert_into_leaf(info, n, index, key,
+				     values + *done * size);
+		if (r < 0)
+			goto out;
+
+		*nr_inserted += r;
+	}
+
+	*new_root = shadow_root(&spine);
+	r = 0;
+out:
+	exit_shadow_spine(&spine);
+	return r;
+}
+
 int dm_btree_insert(struct dm_btree_info *info, dm_block_t root,
 		    uint64_t *keys, void *value, dm_block_t *new_root)
 	__dm_written_to_disk(value)
@@ -1335,6 +1458,32 @@ int dm_btree_insert_notify(struct dm_btree_info *info, dm_block_t root,
 }
 EXPORT_SYMBOL_GPL(dm_btree_insert_notify);
 
+int dm_btree_insert_many(struct dm_btree_info *info, dm_block_t root,
+			 uint64_t *keys, const uint64_t *leaf_keys,
+			 void *values, unsigned int count,
+			 dm_block_t *new_root, unsigned int *nr_inserted)
+{
+	int r;
+	unsigned int i, done;
+
+	for (i = 1; i < count; i++)
+		if (leaf_keys[i] < leaf_keys[i - 1])
+			return -EINVAL;
+
+	*nr_inserted = 0;
+	for (i = 0; i < count; i += done) {
+		r = insert_batch(info, root, keys, leaf_keys + i,
+				 values + i * info->value_type.size,
+				 count - i, &root, &done, nr_inserted);
+		if (r)
+			return r;
+	}
+
+	*new_root = root;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(dm_btree_insert_many);
+
 /*----------------------------------------------------------------*/
 
 static int find_key(struct ro_spine *s, dm_block_t block, bool find_highest,
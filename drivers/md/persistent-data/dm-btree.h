@@ -134,6 +134,22 @@ int dm_btree_insert_notify(struct dm_btree_info *info, dm_block_t root,
 			   int *inserted)
 			   __dm_written_to_disk(value);
 
+/*
+ * Inserts (or overwrites) @count values, for the bottom level keys
+ * @leaf_keys and the upper level keys in @keys (whose last entry is
+ * ignored).  @leaf_keys must be sorted in ascending order, keys that land
+ * in the same leaf are inserted with a single walk of the spine.
+ * @values is an array of @count values of info->value_type.size bytes.
+ * On success *@nr_inserted is the number of keys that weren't present.
+ *
+ * On failure some of the values may have been inserted already, the caller
+ * should abort the transaction.
+ */
+int dm_btree_insert_many(struct dm_btree_info *info, dm_block_t root,
+			 uint64_t *keys, const uint64_t *leaf_keys,
+			 void *values, unsigned int count,
+			 dm_block_t *new_root, unsigned int *nr_inserted);
+
 /*
  * Remove a key if present.  This doesn't remove empty sub trees.  Normally
  * subtrees represent a separate entity, like a snapshot map, so this is
@@ -13,6 +13,7 @@
 #include <linux/export.h>
 #include <linux/mutex.h>
 #include <linux/hash.h>
+#include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/device-mapper.h>
 
@@ -77,12 +78,14 @@ static void prefetch_issue(struct prefetch_set *p, struct dm_block_manager *bm)
 /*----------------------------------------------------------------*/
 
 struct shadow_info {
-	struct hlist_node hlist;
+	struct rb_node node;
 	dm_block_t where;
 };
 
 /*
- * It would be nice if we scaled with the size of transaction.
+ * A transaction of a snapshot heavy pool can shadow many thousands of
+ * blocks, so each bucket is a tree rather than a list to keep the lookups
+ * logarithmic in the size of the transaction.
  */
 #define DM_HASH_SIZE 256
 #define DM_HASH_MASK (DM_HASH_SIZE - 1)
@@ -95,7 +98,9 @@ struct dm_transaction_manager {
 	struct dm_space_map *sm;
 
 	spinlock_t lock;
-	struct hlist_head buckets[DM_HASH_SIZE];
+	struct rb_root buckets[DM_HASH_SIZE];
+
+	unsigned int nr_shadows;
 
 	struct prefetch_set prefetches;
 };
@@ -106,14 +111,22 @@ static int is_shadow(struct dm_transaction_manager *tm, dm_block_t b)
 {
 	int r = 0;
 	unsigned int bucket = dm_hash_block(b, DM_HASH_MASK);
+	struct rb_node *node;
 	struct shadow_info *si;
 
 	spin_lock(&tm->lock);
-	hlist_for_each_entry(si, tm->buckets + bucket, hlist)
-		if (si->where == b) {
+	node = tm->buckets[bucket].rb_node;
+	while (node) {
+		si = rb_entry(node, struct shadow_info, node);
+		if (b < si->where)
+			node = node->rb_left;
+		else if (b > si->where)
+			node = node->rb_right;
+		else {
 			r = 1;
 			break;
 		}
+	}
 	spin_unlock(&tm->lock);
 
 	return r;
@@ -126,37 +139,84 @@ static int is_shadow(struct dm_transaction_manager *tm, dm_block_t b)
 static void insert_shadow(struct dm_transaction_manager *tm, dm_block_t b)
 {
 	unsigned int bucket;
-	struct shadow_info *si;
+	struct rb_node **new, *parent = NULL;
+	struct shadow_info *si, *old;
 
 	si = kmalloc(sizeof(*si), GFP_NOIO);
-	if (si) {
-		si->where = b;
-		bucket = dm_hash_block(b, DM_HASH_MASK);
-		spin_lock(&tm->lock);
-		hlist_add_head(&si->hlist, tm->buckets + bucket);
-		spin_unlock(&tm->lock);
+	if (!si)
+		return;
+
+	si->where = b;
+	bucket = dm_hash_block(b, DM_HASH_MASK);
+
+	spin_lock(&tm->lock);
+	new = &tm->buckets[bucket].rb_node;
+	while (*new) {
+		parent = *new;
+		old = rb_entry(parent, struct shadow_info, node);
+		if (b < old->where)
+			new = &parent->rb_left;
+		else if (b > old->where)
+			new = &parent->rb_right;
+		else {
+			spin_unlock(&tm->lock);
+			kfree(si);
+			return;
+		}
 	}
+	rb_link_node(&si->node, parent, new);
+	rb_insert_color(&si->node, &tm->buckets[bucket]);
+	tm->nr_shadows++;
+	spin_unlock(&tm->lock);
 }
 
 static void wipe_shadow_table(struct dm_transaction_manager *tm)
 {
-	struct shadow_info *si;
-	struct hlist_node *tmp;
-	struct hlist_head *bucket;
+	struct shadow_info *si, *tmp;
 	int i;
 
 	spin_lock(&tm->lock);
 	for (i = 0; i < DM_HASH_SIZE; i++) {
-		bucket = tm->buckets + i;
-		hlist_for_each_entry_safe(si, tmp, bucket, hlist)
+		rbtree_postorder_for_each_entry_safe(si, tmp, tm->buckets + i,
+						     node)
 			kfree(si);
 
-		INIT_HLIST_HEAD(bucket);
+		tm->buckets[i] = RB_ROOT;
 	}
+	tm->nr_shadows = 0;
 
 	spin_unlock(&tm->lock);
 }
 
+/*
+ * Every block written in this transaction has been shadowed, so the
+ * shadow table is the list of blocks the commit is about to write.
+ */
+static void prepare_shadows(struct dm_transaction_manager *tm)
+{
+	struct shadow_info *si, *tmp;
+	unsigned int i, nr = 0, max_nr = tm->nr_shadows;
+	dm_block_t *blocks;
+
+	if (!max_nr)
+		return;
+
+	blocks = kvmalloc_array(max_nr, sizeof(*blocks), GFP_NOIO);
+	if (!blocks)
+		return;
+
+	spin_lock(&tm->lock);
+	for (i = 0; i < DM_HASH_SIZE; i++)
+		rbtree_postorder_for_each_entry_safe(si, tmp, tm->buckets + i,
+						     node)
+			if (nr < max_nr)
+				blocks[nr++] = si->where;
+	spin_unlock(&tm->lock);
+
+	dm_bm_prepare_for_write(tm->bm, blocks, nr);
+	kvfree(blocks);
+}
+
 /*----------------------------------------------------------------*/
 
 static struct dm_transaction_manager *dm_tm_create(struct dm_block_manager *bm,
@@ -176,7 +236,8 @@ static struct dm_transaction_manager *dm_tm_create(struct dm_block_manager *bm,
 
 	spin_lock_init(&tm->lock);
 	for (i = 0; i < DM_HASH_SIZE; i++)
-		INIT_HLIST_HEAD(tm->buckets + i);
+		tm->buckets[i] = RB_ROOT;
+	tm->nr_shadows = 0;
 
 	prefetch_init(&tm->prefetches);
 
@@ -217,6 +278,8 @@ int dm_tm_pre_commit(struct dm_transaction_manager *tm)
 	if (r < 0)
 		return r;
 
+	prepare_shadows(tm);
+
 	return dm_bm_flush(tm->bm);
 }
 EXPORT_SYMBOL_GPL(dm_tm_pre_commit);
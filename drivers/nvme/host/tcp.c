@@ -31,6 +31,18 @@ static int so_priority;
 module_param(so_priority, int, 0644);
 MODULE_PARM_DESC(so_priority, "nvme tcp socket optimize priority");
 
+/* Command capsules queued back to back are gathered into a single sendmsg,
+ * up to send_batch of them, instead of a sendpage call per PDU and per data
+ * segment. Setting it to 1 restores the one request at a time send path.
+ */
+#define NVME_TCP_SEND_BATCH_MAX	16
+#define NVME_TCP_SEND_BVECS	64
+
+static unsigned int send_batch = NVME_TCP_SEND_BATCH_MAX;
+module_param(send_batch, uint, 0644);
+MODULE_PARM_DESC(send_batch,
+		 "max nvme tcp commands sent with a single sendmsg (1 disables batching)");
+
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 /* lockdep can detect a circular dependency of the form
  *   sk_lock -> mmap_lock (page fault) -> fs locks -> sk_lock
@@ -133,6 +145,7 @@ struct nvme_tcp_queue {
 
 	/* send state */
 	struct nvme_tcp_request *request;
+	struct bio_vec		snd_bvec[NVME_TCP_SEND_BVECS];
 
 	u32			maxh2cdata;
 	size_t			cmnd_capsule_len;
@@ -1156,6 +1169,194 @@ static int nvme_tcp_try_send_ddgst(struct nvme_tcp_request *req)
 	return -EAGAIN;
 }
 
+/*
+ * A command capsule can be sent as part of a batch if nothing of it went out
+ * yet and its inline data, if any, is described by the current bio.
+ */
+static bool nvme_tcp_can_batch(struct nvme_tcp_request *req)
+{
+	if (req->state != NVME_TCP_SEND_CMD_PDU || req->offset)
+		return false;
+	if (!nvme_tcp_has_inline_data(req))
+		return true;
+	return iov_iter_count(&req->iter) >= req->pdu_len &&
+		req->iter.nr_segs <= NVME_TCP_SEND_BVECS - 2;
+}
+
+static inline size_t nvme_tcp_batch_len(struct nvme_tcp_request *req)
+{
+	struct nvme_tcp_queue *queue = req->queue;
+	size_t len = sizeof(struct nvme_tcp_cmd_pdu) + nvme_tcp_hdgst_len(queue);
+
+	if (req->pdu_len)
+		len += req->pdu_len + nvme_tcp_ddgst_len(queue);
+	return len;
+}
+
+/*
+ * Append the command PDU, inline data and data digest of @req to the send
+ * bvecs after the first @nr ones, computing the digests on the way. Returns
+ * the new number of bvecs, or -ENOSPC if @req doesn't fit.
+ */
+static int nvme_tcp_batch_add(struct nvme_tcp_request *req, int nr)
+{
+	struct nvme_tcp_queue *queue = req->queue;
+	struct nvme_tcp_cmd_pdu *pdu = nvme_tcp_req_cmd_pdu(req);
+	struct bio_vec *bv = queue->snd_bvec;
+
+	if (nr == NVME_TCP_SEND_BVECS)
+		return -ENOSPC;
+	bvec_set_virt(&bv[nr++], pdu, sizeof(*pdu) + nvme_tcp_hdgst_len(queue));
+
+	if (req->pdu_len) {
+		struct iov_iter iter = req->iter;
+		size_t left = req->pdu_len;
+
+		if (queue->data_digest)
+			crypto_ahash_init(queue->snd_hash);
+
+		while (left) {
+			size_t len = min(iov_iter_single_seg_count(&iter), left);
+
+			if (nr == NVME_TCP_SEND_BVECS)
+				return -ENOSPC;
+			bvec_set_page(&bv[nr], iter.bvec->bv_page, len,
+				      iter.bvec->bv_offset + iter.iov_offset);
+			if (queue->data_digest)
+				nvme_tcp_ddgst_update(queue->snd_hash,
+						bv[nr].bv_page, bv[nr].bv_offset,
+						len);
+			nr++;
+			iov_iter_advance(&iter, len);
+			left -= len;
+		}
+
+		if (queue->data_digest) {
+			if (nr == NVME_TCP_SEND_BVECS)
+				return -ENOSPC;
+			nvme_tcp_ddgst_final(queue->snd_hash, &req->ddgst);
+			bvec_set_virt(&bv[nr++], &req->ddgst,
+				      NVME_TCP_DIGEST_LENGTH);
+		}
+	}
+
+	if (queue->hdr_digest)
+		nvme_tcp_hdgst(queue->snd_hash, pdu, sizeof(*pdu));
+
+	return nr;
+}
+
+/*
+ * The batch stopped @sent bytes into @req: make it the current request with
+ * the send state the one request at a time path would have left it in.
+ */
+static void nvme_tcp_batch_resume(struct nvme_tcp_request *req, size_t sent)
+{
+	struct nvme_tcp_queue *queue = req->queue;
+	size_t pdu_len = sizeof(struct nvme_tcp_cmd_pdu) +
+			 nvme_tcp_hdgst_len(queue);
+
+	queue->request = req;
+	if (sent < pdu_len) {
+		req->offset = sent;
+		return;
+	}
+
+	sent -= pdu_len;
+	if (sent < req->pdu_len) {
+		req->state = NVME_TCP_SEND_DATA;
+		if (queue->data_digest)
+			crypto_ahash_init(queue->snd_hash);
+		while (sent) {
+			size_t len = min(nvme_tcp_req_cur_length(req), sent);
+
+			if (queue->data_digest)
+				nvme_tcp_ddgst_update(queue->snd_hash,
+						nvme_tcp_req_cur_page(req),
+						nvme_tcp_req_cur_offset(req),
+						len);
+			nvme_tcp_advance_req(req, len);
+			sent -= len;
+		}
+		return;
+	}
+
+	req->state = NVME_TCP_SEND_DDGST;
+	req->offset = sent - req->pdu_len;
+}
+
+/*
+ * Send the current request along with the command capsules queued behind
+ * it with a single sendmsg. The requests that were sent completely are done
+ * with and must not be touched anymore, as they may complete any time.
+ */
+static int nvme_tcp_try_send_batch(struct nvme_tcp_queue *queue)
+{
+	struct nvme_tcp_request *reqs[NVME_TCP_SEND_BATCH_MAX];
+	size_t lens[NVME_TCP_SEND_BATCH_MAX];
+	unsigned int max = min_t(unsigned int, READ_ONCE(send_batch),
+				 NVME_TCP_SEND_BATCH_MAX);
+	struct nvme_tcp_request *req = queue->request;
+	struct msghdr msg = { .msg_flags = MSG_DONTWAIT };
+	int nr_reqs = 0, nr_bvec, i, ret;
+	size_t total = 0, sent;
+
+	/* nothing has been touched yet, the caller sends it on its own */
+	nr_bvec = nvme_tcp_batch_add(req, 0);
+	if (nr_bvec < 0)
+		return nr_bvec;
+
+	while (true) {
+		reqs[nr_reqs] = req;
+		lens[nr_reqs] = nvme_tcp_batch_len(req);
+		total += lens[nr_reqs++];
+		if (nr_reqs >= max)
+			break;
+
+		req = list_first_entry_or_null(&queue->send_list,
+				struct nvme_tcp_request, entry);
+		if (!req) {
+			nvme_tcp_process_req_list(queue);
+			req = list_first_entry_or_null(&queue->send_list,
+					struct nvme_tcp_request, entry);
+		}
+		if (!req || !nvme_tcp_can_batch(req))
+			break;
+
+		ret = nvme_tcp_batch_add(req, nr_bvec);
+		if (ret < 0)
+			break;
+		nr_bvec = ret;
+		list_del(&req->entry);
+	}
+
+	if (nvme_tcp_queue_more(queue))
+		msg.msg_flags |= MSG_MORE;
+	else
+		msg.msg_flags |= MSG_EOR;
+
+	iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, queue->snd_bvec, nr_bvec,
+		      total);
+	ret = sock_sendmsg(queue->sock, &msg);
+	sent = ret > 0 ? ret : 0;
+
+	for (i = 0; i < nr_reqs && sent >= lens[i]; i++)
+		sent -= lens[i];
+	if (i == nr_reqs) {
+		nvme_tcp_done_send_req(queue);
+		return 1;
+	}
+
+	/* requeue what didn't go out, in order, and resume the partial one */
+	while (--nr_reqs > i)
+		list_add(&reqs[nr_reqs]->entry, &queue->send_list);
+	nvme_tcp_batch_resume(reqs[i], sent);
+
+	if (ret <= 0)
+		return ret;
+	return 1;
+}
+
 static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 {
 	struct nvme_tcp_request *req;
@@ -1170,6 +1371,12 @@ static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 	req = queue->request;
 
 	noreclaim_flag = memalloc_noreclaim_save();
+	if (READ_ONCE(send_batch) > 1 && nvme_tcp_can_batch(req)) {
+		ret = nvme_tcp_try_send_batch(queue);
+		if (ret != -ENOSPC)
+			goto done;
+	}
+
 	if (req->state == NVME_TCP_SEND_CMD_PDU) {
 		ret = nvme_tcp_try_send_cmd_pdu(req);
 		if (ret <= 0)
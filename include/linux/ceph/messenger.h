@@ -354,10 +354,18 @@ struct ceph_gcm_nonce {
 	__le64 counter __packed;
 };
 
+/* data pieces received with a single recvmsg */
+#define CEPH_MSGR2_IN_BVECS	16
+
 struct ceph_connection_v2_info {
 	struct iov_iter in_iter;
 	struct kvec in_kvecs[5];  /* recvmsg */
-	struct bio_vec in_bvec;  /* recvmsg (in_cursor) */
+	struct bio_vec in_bvecs[CEPH_MSGR2_IN_BVECS];  /* recvmsg (in_cursor,
+							  in_enc_pages) */
+	int in_bvec_cnt;
+	int in_bvec_len;  /* total length of in_bvecs */
+	int in_crc_bvec;  /* in_data_crc covers in_bvecs up to this piece */
+	int in_crc_off;   /* ... and this offset in it */
 	int in_kvec_cnt;
 	int in_state;  /* IN_S_* */
 
@@ -58,6 +58,8 @@ struct ceph_pg_pool_info {
 	char *name;
 
 	bool was_full;  /* for handle_one_map() */
+
+	struct ceph_pg_raw_cache *raw_cache;  /* CRUSH output by ps */
 };
 
 static inline bool ceph_can_shift_osds(struct ceph_pg_pool_info *pool)
@@ -156,6 +156,8 @@ struct rpc_xprt_ops {
 					unsigned long connect_timeout,
 					unsigned long reconnect_timeout);
 	void		(*print_stats)(struct rpc_xprt *xprt, struct seq_file *seq);
+	void		(*print_debug_stats)(struct rpc_xprt *xprt,
+					     struct seq_file *seq);
 	int		(*enable_swap)(struct rpc_xprt *xprt);
 	void		(*disable_swap)(struct rpc_xprt *xprt);
 	void		(*inject_disconnect)(struct rpc_xprt *xprt);
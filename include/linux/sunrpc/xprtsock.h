@@ -49,6 +49,21 @@ struct sock_xprt {
 		u32		offset;
 	} xmit;
 
+	/*
+	 * TCP transmit batching and receive draining statistics,
+	 * protected by XPRT_LOCKED and recv_mutex respectively
+	 */
+	struct {
+		unsigned long	records,
+				batches,
+				batched;
+	} xmit_stats;
+	struct {
+		unsigned long	runs,
+				records,
+				max_records;
+	} recv_stats;
+
 	/*
 	 * Connection of transports
 	 */
@@ -90,5 +105,6 @@ struct sock_xprt {
 #define XPRT_SOCK_WAKE_DISCONNECT	(7)
 #define XPRT_SOCK_CONNECT_SENT	(8)
 #define XPRT_SOCK_NOSPACE	(9)
+#define XPRT_SOCK_CORKED	(10)
 
 #endif /* _LINUX_SUNRPC_XPRTSOCK_H */
@@ -136,6 +136,18 @@ typedef ZSTD_parameters zstd_parameters;
 zstd_parameters zstd_get_params(int level,
 	unsigned long long estimated_src_size);
 
+/**
+ * zstd_get_cparams() - returns zstd_compression_parameters for selected level
+ * @level:              The compression level
+ * @estimated_src_size: The estimated source size to compress or 0
+ *                      if unknown.
+ * @dict_size:          Dictionary size, or 0 if no dictionary is used.
+ *
+ * Return:              The selected zstd_compression_parameters.
+ */
+zstd_compression_parameters zstd_get_cparams(int level,
+	unsigned long long estimated_src_size, size_t dict_size);
+
 /* ======   Single-pass Compression   ====== */
 
 typedef ZSTD_CCtx zstd_cctx;
@@ -180,6 +192,55 @@ zstd_cctx *zstd_init_cctx(void *workspace, size_t workspace_size);
 size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size, const zstd_parameters *parameters);
 
+/* ======   Single-pass Dictionary Compression   ====== */
+
+typedef ZSTD_CDict zstd_cdict;
+
+/**
+ * zstd_cdict_workspace_bound() - memory needed to initialize a zstd_cdict
+ * @dict_size: The size of the dictionary.
+ * @cparams:   The compression parameters to be used.
+ *
+ * Return:     A lower bound on the size of the workspace that is passed to
+ *             zstd_init_cdict().
+ */
+size_t zstd_cdict_workspace_bound(size_t dict_size,
+	const zstd_compression_parameters *cparams);
+
+/**
+ * zstd_init_cdict() - digest a raw content dictionary for compression
+ * @workspace:      The workspace to emplace the dictionary into. It must
+ *                  outlive the returned dictionary.
+ * @workspace_size: The size of workspace. Use zstd_cdict_workspace_bound() to
+ *                  determine how large the workspace must be.
+ * @dict:           The dictionary content. It is referenced, not copied, and
+ *                  must outlive the returned dictionary.
+ * @dict_size:      The size of the dictionary.
+ * @cparams:        The compression parameters to be used.
+ *
+ * Return:          A zstd compression dictionary or NULL on error.
+ */
+const zstd_cdict *zstd_init_cdict(void *workspace, size_t workspace_size,
+	const void *dict, size_t dict_size,
+	const zstd_compression_parameters *cparams);
+
+/**
+ * zstd_compress_using_cdict() - compress src into dst using a dictionary
+ * @cctx:         The context. Must have been initialized with zstd_init_cctx()
+ *                with a workspace large enough for the dictionary parameters.
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer.
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ * @cdict:        The dictionary, initialized with zstd_init_cdict().
+ *
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_compress_using_cdict(zstd_cctx *cctx, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size,
+	const zstd_cdict *cdict);
+
 /* ======   Single-pass Decompression   ====== */
 
 typedef ZSTD_DCtx zstd_dctx;
@@ -220,6 +281,51 @@ zstd_dctx *zstd_init_dctx(void *workspace, size_t workspace_size);
 size_t zstd_decompress_dctx(zstd_dctx *dctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size);
 
+/* ======   Single-pass Dictionary Decompression   ====== */
+
+typedef ZSTD_DDict zstd_ddict;
+
+/**
+ * zstd_ddict_workspace_bound() - memory needed to initialize a zstd_ddict
+ * @dict_size: The size of the dictionary.
+ *
+ * Return:     A lower bound on the size of the workspace that is passed to
+ *             zstd_init_ddict().
+ */
+size_t zstd_ddict_workspace_bound(size_t dict_size);
+
+/**
+ * zstd_init_ddict() - digest a raw content dictionary for decompression
+ * @workspace:      The workspace to emplace the dictionary into. It must
+ *                  outlive the returned dictionary.
+ * @workspace_size: The size of workspace. Use zstd_ddict_workspace_bound() to
+ *                  determine how large the workspace must be.
+ * @dict:           The dictionary content. It is referenced, not copied, and
+ *                  must outlive the returned dictionary.
+ * @dict_size:      The size of the dictionary.
+ *
+ * Return:          A zstd decompression dictionary or NULL on error.
+ */
+const zstd_ddict *zstd_init_ddict(void *workspace, size_t workspace_size,
+	const void *dict, size_t dict_size);
+
+/**
+ * zstd_decompress_using_ddict() - decompress src into dst using a dictionary
+ * @dctx:         The decompression context.
+ * @dst:          The buffer to decompress src into.
+ * @dst_capacity: The size of the destination buffer. Must be at least as large
+ *                as the decompressed size.
+ * @src:          The zstd compressed data to decompress.
+ * @src_size:     The exact size of the data to decompress.
+ * @ddict:        The dictionary the data was compressed with.
+ *
+ * Return:        The decompressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_decompress_using_ddict(zstd_dctx *dctx, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size,
+	const zstd_ddict *ddict);
+
 /* ======   Streaming Buffers   ====== */
 
 /**
@@ -10,6 +10,7 @@
 #include <net/dst_ops.h>
 
 struct ctl_table_header;
+struct xfrm_pol_cls;
 
 struct xfrm_policy_hash {
 	struct hlist_head	__rcu *table;
@@ -56,7 +57,14 @@ struct netns_xfrm {
 	struct work_struct	policy_hash_work;
 	struct xfrm_policy_hthresh policy_hthresh;
 	struct list_head	inexact_bins;
-
+	/* compiled classifier for the inexact policies, only valid while
+	 * its generation matches policy_cls_gen
+	 */
+	struct xfrm_pol_cls	__rcu *policy_cls;
+	/* classifier being built, under xfrm_policy_lock */
+	struct xfrm_pol_cls	*policy_cls_next;
+	unsigned int		policy_cls_gen;
+	struct delayed_work	policy_cls_work;
 
 	struct sock		*nlsk;
 	struct sock		*nlsk_stash;
@@ -248,5 +248,6 @@ struct mptcp_subflow_addrs {
 #define MPTCP_INFO		1
 #define MPTCP_TCPINFO		2
 #define MPTCP_SUBFLOW_ADDRS	3
+#define MPTCP_SCHEDULER		4
 
 #endif /* _UAPI_MPTCP_H */
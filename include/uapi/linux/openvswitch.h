@@ -78,6 +78,12 @@ enum ovs_datapath_cmd {
  * datapath. Always present in notifications.
  * @OVS_DP_ATTR_IFINDEX: Interface index for a new datapath netdev. Only
  * valid for %OVS_DP_CMD_NEW requests.
+ * @OVS_DP_ATTR_EMC_SIZE: Number of entries of the per-cpu exact match flow
+ * cache, a power of 2. Zero disables the cache.
+ * @OVS_DP_ATTR_EMC_INSERT_INV_PROB: A flow found by the masked lookup is
+ * inserted in the exact match cache once every this many lookups, on average.
+ * @OVS_DP_ATTR_EMC_STATS: Statistics about the exact match flow cache usage
+ * for the datapath. Always present in notifications.
  *
  * These attributes follow the &struct ovs_header within the Generic Netlink
  * payload for %OVS_DP_* commands.
@@ -95,6 +101,9 @@ enum ovs_datapath_attr {
 				     * per-cpu dispatch mode
 				     */
 	OVS_DP_ATTR_IFINDEX,
+	OVS_DP_ATTR_EMC_SIZE,		/* u32 number of EMC entries */
+	OVS_DP_ATTR_EMC_INSERT_INV_PROB,/* u32 EMC insertion 1/probability */
+	OVS_DP_ATTR_EMC_STATS,		/* struct ovs_dp_emc_stats */
 	__OVS_DP_ATTR_MAX
 };
 
@@ -115,6 +124,11 @@ struct ovs_dp_megaflow_stats {
 	__u64 pad1;		 /* Pad for future expension. */
 };
 
+struct ovs_dp_emc_stats {
+	__u64 n_hit;		 /* Number of exact match cache hits. */
+	__u64 n_missed;		 /* Number of exact match cache misses. */
+};
+
 struct ovs_vport_stats {
 	__u64   rx_packets;		/* total packets received       */
 	__u64   tx_packets;		/* total packets transmitted    */
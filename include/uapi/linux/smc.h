@@ -245,6 +245,10 @@ enum {
 	SMC_NLA_STATS_T_TX_BYTES,	/* u64 */
 	SMC_NLA_STATS_T_RX_CNT,		/* u64 */
 	SMC_NLA_STATS_T_TX_CNT,		/* u64 */
+	SMC_NLA_STATS_T_CDC_RX_CNT,	/* u64 */
+	SMC_NLA_STATS_T_CDC_BATCH_CNT,	/* u64 */
+	SMC_NLA_STATS_T_RMB_GROW_CNT,	/* u64 */
+	SMC_NLA_STATS_T_RMB_SHRINK_CNT,	/* u64 */
 	__SMC_NLA_STATS_T_MAX,
 	SMC_NLA_STATS_T_MAX = __SMC_NLA_STATS_T_MAX - 1
 };
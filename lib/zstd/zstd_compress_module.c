@@ -79,6 +79,13 @@ zstd_parameters zstd_get_params(int level,
 }
 EXPORT_SYMBOL(zstd_get_params);
 
+zstd_compression_parameters zstd_get_cparams(int level,
+	unsigned long long estimated_src_size, size_t dict_size)
+{
+	return ZSTD_getCParams(level, estimated_src_size, dict_size);
+}
+EXPORT_SYMBOL(zstd_get_cparams);
+
 size_t zstd_cctx_workspace_bound(const zstd_compression_parameters *cparams)
 {
 	return ZSTD_estimateCCtxSize_usingCParams(*cparams);
@@ -101,6 +108,34 @@ size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 }
 EXPORT_SYMBOL(zstd_compress_cctx);
 
+size_t zstd_cdict_workspace_bound(size_t dict_size,
+	const zstd_compression_parameters *cparams)
+{
+	return ZSTD_estimateCDictSize_advanced(dict_size, *cparams,
+		ZSTD_dlm_byRef);
+}
+EXPORT_SYMBOL(zstd_cdict_workspace_bound);
+
+const zstd_cdict *zstd_init_cdict(void *workspace, size_t workspace_size,
+	const void *dict, size_t dict_size,
+	const zstd_compression_parameters *cparams)
+{
+	if (workspace == NULL)
+		return NULL;
+	return ZSTD_initStaticCDict(workspace, workspace_size, dict, dict_size,
+		ZSTD_dlm_byRef, ZSTD_dct_rawContent, *cparams);
+}
+EXPORT_SYMBOL(zstd_init_cdict);
+
+size_t zstd_compress_using_cdict(zstd_cctx *cctx, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size,
+	const zstd_cdict *cdict)
+{
+	return ZSTD_compress_usingCDict(cctx, dst, dst_capacity,
+		src, src_size, cdict);
+}
+EXPORT_SYMBOL(zstd_compress_using_cdict);
+
 size_t zstd_cstream_workspace_bound(const zstd_compression_parameters *cparams)
 {
 	return ZSTD_estimateCStreamSize_usingCParams(*cparams);
@@ -59,6 +59,31 @@ size_t zstd_decompress_dctx(zstd_dctx *dctx, void *dst, size_t dst_capacity,
 }
 EXPORT_SYMBOL(zstd_decompress_dctx);
 
+size_t zstd_ddict_workspace_bound(size_t dict_size)
+{
+	return ZSTD_estimateDDictSize(dict_size, ZSTD_dlm_byRef);
+}
+EXPORT_SYMBOL(zstd_ddict_workspace_bound);
+
+const zstd_ddict *zstd_init_ddict(void *workspace, size_t workspace_size,
+	const void *dict, size_t dict_size)
+{
+	if (workspace == NULL)
+		return NULL;
+	return ZSTD_initStaticDDict(workspace, workspace_size, dict, dict_size,
+		ZSTD_dlm_byRef, ZSTD_dct_rawContent);
+}
+EXPORT_SYMBOL(zstd_init_ddict);
+
+size_t zstd_decompress_using_ddict(zstd_dctx *dctx, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size,
+	const zstd_ddict *ddict)
+{
+	return ZSTD_decompress_usingDDict(dctx, dst, dst_capacity,
+		src, src_size, ddict);
+}
+EXPORT_SYMBOL(zstd_decompress_using_ddict);
+
 size_t zstd_dstream_workspace_bound(size_t max_window_size)
 {
 	return ZSTD_estimateDStreamSize(max_window_size);
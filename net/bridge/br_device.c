@@ -123,9 +123,16 @@ static int br_dev_init(struct net_device *dev)
 	if (!dev->tstats)
 		return -ENOMEM;
 
+	err = br_flood_init(br);
+	if (err) {
+		free_percpu(dev->tstats);
+		return err;
+	}
+
 	err = br_fdb_hash_init(br);
 	if (err) {
 		free_percpu(dev->tstats);
+		br_flood_fini(br);
 		return err;
 	}
 
@@ -133,6 +140,7 @@ static int br_dev_init(struct net_device *dev)
 	if (err) {
 		free_percpu(dev->tstats);
 		br_fdb_hash_fini(br);
+		br_flood_fini(br);
 		return err;
 	}
 
@@ -141,6 +149,7 @@ static int br_dev_init(struct net_device *dev)
 		free_percpu(dev->tstats);
 		br_mdb_hash_fini(br);
 		br_fdb_hash_fini(br);
+		br_flood_fini(br);
 		return err;
 	}
 
@@ -150,6 +159,7 @@ static int br_dev_init(struct net_device *dev)
 		br_vlan_flush(br);
 		br_mdb_hash_fini(br);
 		br_fdb_hash_fini(br);
+		br_flood_fini(br);
 	}
 
 	br_set_lockdep_class(dev);
@@ -165,6 +175,7 @@ static void br_dev_uninit(struct net_device *dev)
 	br_vlan_flush(br);
 	br_mdb_hash_fini(br);
 	br_fdb_hash_fini(br);
+	br_flood_fini(br);
 	free_percpu(dev->tstats);
 }
 
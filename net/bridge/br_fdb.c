@@ -52,12 +52,23 @@ void br_fdb_fini(void)
 
 int br_fdb_hash_init(struct net_bridge *br)
 {
-	return rhashtable_init(&br->fdb_hash_tbl, &br_fdb_rht_params);
+	int err;
+
+	br->fdb_learn_cache = alloc_percpu(struct br_fdb_learn_cache);
+	if (!br->fdb_learn_cache)
+		return -ENOMEM;
+
+	err = rhashtable_init(&br->fdb_hash_tbl, &br_fdb_rht_params);
+	if (err)
+		free_percpu(br->fdb_learn_cache);
+
+	return err;
 }
 
 void br_fdb_hash_fini(struct net_bridge *br)
 {
 	rhashtable_destroy(&br->fdb_hash_tbl);
+	free_percpu(br->fdb_learn_cache);
 }
 
 /* if topology_changing then use forward_delay (default 15 sec)
@@ -329,6 +340,7 @@ static void fdb_delete(struct net_bridge *br, struct net_bridge_fdb_entry *f,
 	hlist_del_init_rcu(&f->fdb_node);
 	rhashtable_remove_fast(&br->fdb_hash_tbl, &f->rhnode,
 			       br_fdb_rht_params);
+	br_fdb_learn_cache_flush(br);
 	fdb_notify(br, f, RTM_DELNEIGH, swdev_notify);
 	call_rcu(&f->rcu, fdb_rcu_free);
 }
@@ -519,6 +531,40 @@ void br_fdb_change_mac_address(struct net_bridge *br, const u8 *newaddr)
 	spin_unlock_bh(&br->hash_lock);
 }
 
+static u32 br_fdb_learn_hash(const unsigned char *addr, u16 vid)
+{
+	u32 a = get_unaligned((const u32 *)addr);
+	u32 b = get_unaligned((const u16 *)(addr + 4)) | ((u32)vid << 16);
+
+	return jhash_2words(a, b, 0) & (BR_FDB_LEARN_CACHE_SIZE - 1);
+}
+
+/* Returns the latest time any CPU learned @f through its learn cache. */
+static unsigned long br_fdb_learn_cache_seen(const struct net_bridge *br,
+					     const struct net_bridge_fdb_entry *f)
+{
+	const unsigned char *addr = f->key.addr.addr;
+	u32 idx = br_fdb_learn_hash(addr, f->key.vlan_id);
+	unsigned long seen = READ_ONCE(f->updated);
+	int cpu;
+
+	/* racy reads of other CPUs slots: a torn match can only delay the
+	 * ageing of the entry by one more period
+	 */
+	for_each_possible_cpu(cpu) {
+		const struct br_fdb_learn_slot *slot;
+		unsigned long s;
+
+		slot = &per_cpu_ptr(br->fdb_learn_cache, cpu)->slots[idx];
+		s = READ_ONCE(slot->seen);
+		if (slot->vid == f->key.vlan_id &&
+		    ether_addr_equal(slot->addr, addr) && time_after(s, seen))
+			seen = s;
+	}
+
+	return seen;
+}
+
 void br_fdb_cleanup(struct work_struct *work)
 {
 	struct net_bridge *br = container_of(work, struct net_bridge,
@@ -551,6 +597,14 @@ void br_fdb_cleanup(struct work_struct *work)
 
 		if (time_after(this_timer, now)) {
 			work_delay = min(work_delay, this_timer - now);
+			continue;
+		}
+
+		/* merge the per-CPU learning state before ageing it out */
+		this_timer = br_fdb_learn_cache_seen(br, f) + delay;
+		if (time_after(this_timer, now)) {
+			WRITE_ONCE(f->updated, this_timer - delay);
+			work_delay = min(work_delay, this_timer - now);
 		} else {
 			spin_lock_bh(&br->hash_lock);
 			if (!hlist_unhashed(&f->fdb_node))
@@ -850,15 +904,85 @@ static bool __fdb_mark_active(struct net_bridge_fdb_entry *fdb)
 		  test_and_clear_bit(BR_FDB_NOTIFY_INACTIVE, &fdb->flags));
 }
 
+void br_fdb_learn_cache_flush(struct net_bridge *br)
+{
+	WRITE_ONCE(br->fdb_learn_gen, READ_ONCE(br->fdb_learn_gen) + 1);
+}
+
+static unsigned long br_fdb_learn_interval(const struct net_bridge *br)
+{
+	return min_t(unsigned long, hold_time(br) / 8, BR_FDB_TS_INTERVAL);
+}
+
+/* Called with BH disabled. Returns true if @addr was learned on @source by
+ * this CPU less than br_fdb_learn_interval() ago, and no fdb entry roamed
+ * or was deleted since then: there is nothing to update in the shared entry.
+ */
+static bool br_fdb_learn_cache_hit(struct net_bridge *br,
+				   const struct net_bridge_port *source,
+				   const unsigned char *addr, u16 vid,
+				   unsigned long now)
+{
+	struct br_fdb_learn_cache *cache = this_cpu_ptr(br->fdb_learn_cache);
+	struct br_fdb_learn_slot *slot;
+
+	slot = &cache->slots[br_fdb_learn_hash(addr, vid)];
+	if (slot->dst != source || slot->vid != vid ||
+	    !ether_addr_equal(slot->addr, addr) ||
+	    slot->gen != READ_ONCE(br->fdb_learn_gen) ||
+	    time_after_eq(now, slot->stamp + br_fdb_learn_interval(br)))
+		return false;
+
+	if (slot->seen != now)
+		WRITE_ONCE(slot->seen, now);
+	WRITE_ONCE(cache->hits, cache->hits + 1);
+	return true;
+}
+
+unsigned long br_fdb_learn_cache_hits(const struct net_bridge *br)
+{
+	unsigned long hits = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		hits += READ_ONCE(per_cpu_ptr(br->fdb_learn_cache, cpu)->hits);
+
+	return hits;
+}
+
+static void br_fdb_learn_cache_fill(struct net_bridge *br,
+				    const struct net_bridge_port *source,
+				    const unsigned char *addr, u16 vid,
+				    unsigned long now, unsigned int gen)
+{
+	struct br_fdb_learn_slot *slot;
+
+	slot = &this_cpu_ptr(br->fdb_learn_cache)->slots[br_fdb_learn_hash(addr, vid)];
+	slot->dst = source;
+	slot->vid = vid;
+	ether_addr_copy(slot->addr, addr);
+	slot->gen = gen;
+	slot->stamp = now;
+	WRITE_ONCE(slot->seen, now);
+}
+
 void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 		   const unsigned char *addr, u16 vid, unsigned long flags)
 {
 	struct net_bridge_fdb_entry *fdb;
+	unsigned long now = jiffies;
+	unsigned int gen;
 
 	/* some users want to always flood. */
 	if (hold_time(br) == 0)
 		return;
 
+	/* plain learning on the forwarding path, see if it can be skipped */
+	if (likely(!flags) &&
+	    br_fdb_learn_cache_hit(br, source, addr, vid, now))
+		return;
+
+	gen = READ_ONCE(br->fdb_learn_gen);
 	fdb = fdb_find_rcu(&br->fdb_hash_tbl, addr, vid);
 	if (likely(fdb)) {
 		/* attempt to update an entry for a local interface */
@@ -867,11 +991,12 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 				br_warn(br, "received packet on %s with own address as source address (addr:%pM, vlan:%u)\n",
 					source->dev->name, addr, vid);
 		} else {
-			unsigned long now = jiffies;
+			unsigned long updated = READ_ONCE(fdb->updated);
 			bool fdb_modified = false;
 
-			if (now != fdb->updated) {
-				fdb->updated = now;
+			if (now != updated &&
+			    time_after_eq(now, updated + br_fdb_learn_interval(br))) {
+				WRITE_ONCE(fdb->updated, now);
 				fdb_modified = __fdb_mark_active(fdb);
 			}
 
@@ -880,6 +1005,7 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 				     !test_bit(BR_FDB_STICKY, &fdb->flags))) {
 				br_switchdev_fdb_notify(br, fdb, RTM_DELNEIGH);
 				WRITE_ONCE(fdb->dst, source);
+				br_fdb_learn_cache_flush(br);
 				fdb_modified = true;
 				/* Take over HW learned entry */
 				if (unlikely(test_bit(BR_FDB_ADDED_BY_EXT_LEARN,
@@ -898,6 +1024,9 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 			if (unlikely(fdb_modified)) {
 				trace_br_fdb_update(br, source, addr, vid, flags);
 				fdb_notify(br, fdb, RTM_NEWNEIGH, true);
+			} else if (!flags) {
+				br_fdb_learn_cache_fill(br, source, addr, vid,
+							now, gen);
 			}
 		}
 	} else {
@@ -1067,6 +1196,7 @@ static int fdb_add_entry(struct net_bridge *br, struct net_bridge_port *source,
 
 		if (READ_ONCE(fdb->dst) != source) {
 			WRITE_ONCE(fdb->dst, source);
+			br_fdb_learn_cache_flush(br);
 			modified = true;
 		}
 	}
@@ -1422,6 +1552,7 @@ int br_fdb_external_learn_add(struct net_bridge *br, struct net_bridge_port *p,
 
 		if (READ_ONCE(fdb->dst) != p) {
 			WRITE_ONCE(fdb->dst, p);
+			br_fdb_learn_cache_flush(br);
 			modified = true;
 		}
 
@@ -171,28 +171,135 @@ void br_forward(const struct net_bridge_port *to,
 }
 EXPORT_SYMBOL_GPL(br_forward);
 
-static struct net_bridge_port *maybe_deliver(
-	struct net_bridge_port *prev, struct net_bridge_port *p,
-	struct sk_buff *skb, bool local_orig)
+/* Flooding is done in two passes: the egress ports are selected into a
+ * bitmap first, then the packet is cloned and sent to all of them in a
+ * row, so the per port checks and the transmit path don't keep evicting
+ * each other.
+ */
+static void maybe_select(struct net_bridge_port *p, struct sk_buff *skb,
+			 u8 igmp_type, unsigned long *egress)
 {
-	u8 igmp_type = br_multicast_igmp_type(skb);
-	int err;
-
 	if (!should_deliver(p, skb))
-		return prev;
+		return;
 
 	nbp_switchdev_frame_mark_tx_fwd_to_hwdom(p, skb);
+	br_multicast_count(p->br, p, skb, igmp_type, BR_MCAST_DIR_TX);
+	__set_bit(p->port_no, egress);
+}
+
+/* Send a clone of @skb to every port in @egress but the last one, which
+ * gets @skb itself unless it is also received locally.
+ */
+static void deliver_selected(struct net_bridge *br, struct sk_buff *skb,
+			     const unsigned long *egress, bool local_rcv,
+			     bool local_orig)
+{
+	unsigned long port_no, last;
+	struct net_bridge_port *p;
 
-	if (!prev)
+	last = find_last_bit(egress, BR_MAX_PORTS);
+	if (last == BR_MAX_PORTS)
 		goto out;
 
-	err = deliver_clone(prev, skb, local_orig);
-	if (err)
-		return ERR_PTR(err);
+	for_each_set_bit(port_no, egress, last) {
+		p = rcu_dereference(br->port_by_no[port_no]);
+		if (p && deliver_clone(p, skb, local_orig))
+			goto out;
+	}
+
+	/* the port may have been removed since it was selected */
+	p = rcu_dereference(br->port_by_no[last]);
+	if (!p)
+		goto out;
+
+	if (local_rcv)
+		deliver_clone(p, skb, local_orig);
+	else
+		__br_forward(p, skb, local_orig);
+	return;
+
 out:
-	br_multicast_count(p->br, p, skb, igmp_type, BR_MCAST_DIR_TX);
+	if (!local_rcv)
+		kfree_skb(skb);
+}
+
+/* The ports a packet may be flooded to only depend on the port flags, so
+ * they are kept in per packet type bitmaps and br_flood() only has to look
+ * at the ports with their bit set. The per packet checks (state, vlan
+ * egress, isolation, ...) are still done by should_deliver().
+ */
+int br_flood_init(struct net_bridge *br)
+{
+	br->port_by_no = kvcalloc(BR_MAX_PORTS, sizeof(*br->port_by_no),
+				  GFP_KERNEL);
+	if (!br->port_by_no)
+		return -ENOMEM;
 
-	return p;
+	return 0;
+}
+
+void br_flood_fini(struct net_bridge *br)
+{
+	kvfree(br->port_by_no);
+}
+
+/* must be called under RTNL whenever the port flags change */
+void br_flood_port_update(struct net_bridge_port *p)
+{
+	unsigned long flags = p->flags;
+	struct net_bridge *br = p->br;
+	bool flood = !(flags & BR_PROXYARP);
+
+	ASSERT_RTNL();
+
+	assign_bit(p->port_no, br->flood_map[BR_PKT_UNICAST],
+		   flood && (flags & BR_FLOOD));
+	assign_bit(p->port_no, br->flood_map[BR_PKT_MULTICAST],
+		   flood && (flags & BR_MCAST_FLOOD));
+	assign_bit(p->port_no, br->flood_map[BR_PKT_BROADCAST],
+		   flood && (flags & BR_BCAST_FLOOD));
+	assign_bit(p->port_no, br->flood_local_map, flood);
+}
+
+void br_flood_port_add(struct net_bridge_port *p)
+{
+	rcu_assign_pointer(p->br->port_by_no[p->port_no], p);
+	br_flood_port_update(p);
+}
+
+void br_flood_port_del(struct net_bridge_port *p)
+{
+	struct net_bridge *br = p->br;
+	int i;
+
+	for (i = 0; i < __BR_PKT_MAX; i++)
+		clear_bit(p->port_no, br->flood_map[i]);
+	clear_bit(p->port_no, br->flood_local_map);
+	RCU_INIT_POINTER(br->port_by_no[p->port_no], NULL);
+}
+
+/* Restrict @map to the members of @vid when vlan filtering is enabled,
+ * returns the bitmap to walk.
+ */
+static const unsigned long *br_flood_vlan_map(struct net_bridge *br,
+					      const unsigned long *map,
+					      unsigned long *buf, u16 vid)
+{
+#ifdef CONFIG_BRIDGE_VLAN_FILTERING
+	struct net_bridge_vlan *masterv;
+
+	if (!br_opt_get(br, BROPT_VLAN_ENABLED) || !vid)
+		return map;
+
+	masterv = br_vlan_find(br_vlan_group_rcu(br), vid);
+	if (!masterv || !masterv->port_map)
+		return map;
+
+	bitmap_and(buf, map, masterv->port_map, BR_MAX_PORTS);
+	return buf;
+#else
+	return map;
+#endif
 }
 
 /* called under rcu_read_lock */
@@ -200,53 +307,38 @@ void br_flood(struct net_bridge *br, struct sk_buff *skb,
 	      enum br_pkt_type pkt_type, bool local_rcv, bool local_orig,
 	      u16 vid)
 {
-	struct net_bridge_port *prev = NULL;
+	u8 igmp_type = br_multicast_igmp_type(skb);
+	DECLARE_BITMAP(egress, BR_MAX_PORTS);
+	DECLARE_BITMAP(buf, BR_MAX_PORTS);
+	const unsigned long *map;
 	struct net_bridge_port *p;
+	unsigned long port_no;
 
-	list_for_each_entry_rcu(p, &br->port_list, list) {
-		/* Do not flood unicast traffic to ports that turn it off, nor
-		 * other traffic if flood off, except for traffic we originate
-		 */
-		switch (pkt_type) {
-		case BR_PKT_UNICAST:
-			if (!(p->flags & BR_FLOOD))
-				continue;
-			break;
-		case BR_PKT_MULTICAST:
-			if (!(p->flags & BR_MCAST_FLOOD) && skb->dev != br->dev)
-				continue;
-			break;
-		case BR_PKT_BROADCAST:
-			if (!(p->flags & BR_BCAST_FLOOD) && skb->dev != br->dev)
-				continue;
-			break;
-		}
+	/* Do not flood unicast traffic to ports that turn it off, nor
+	 * other traffic if flood off, except for traffic we originate.
+	 * Never flood to ports that enable proxy ARP.
+	 */
+	if (pkt_type != BR_PKT_UNICAST && skb->dev == br->dev)
+		map = br->flood_local_map;
+	else
+		map = br->flood_map[pkt_type];
+	map = br_flood_vlan_map(br, map, buf, vid);
 
-		/* Do not flood to ports that enable proxy ARP */
-		if (p->flags & BR_PROXYARP)
+	bitmap_zero(egress, BR_MAX_PORTS);
+	for_each_set_bit(port_no, map, BR_MAX_PORTS) {
+		p = rcu_dereference(br->port_by_no[port_no]);
+		if (!p)
 			continue;
+
 		if (BR_INPUT_SKB_CB(skb)->proxyarp_replied &&
 		    ((p->flags & BR_PROXYARP_WIFI) ||
 		     br_is_neigh_suppress_enabled(p, vid)))
 			continue;
 
-		prev = maybe_deliver(prev, p, skb, local_orig);
-		if (IS_ERR(prev))
-			goto out;
+		maybe_select(p, skb, igmp_type, egress);
 	}
 
-	if (!prev)
-		goto out;
-
-	if (local_rcv)
-		deliver_clone(prev, skb, local_orig);
-	else
-		__br_forward(prev, skb, local_orig);
-	return;
-
-out:
-	if (!local_rcv)
-		kfree_skb(skb);
+	deliver_selected(br, skb, egress, local_rcv, local_orig);
 }
 
 #ifdef CONFIG_BRIDGE_IGMP_SNOOPING
@@ -281,11 +373,13 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 			struct net_bridge_mcast *brmctx,
 			bool local_rcv, bool local_orig)
 {
-	struct net_bridge_port *prev = NULL;
+	u8 igmp_type = br_multicast_igmp_type(skb);
+	DECLARE_BITMAP(egress, BR_MAX_PORTS);
 	struct net_bridge_port_group *p;
 	bool allow_mode_include = true;
 	struct hlist_node *rp;
 
+	bitmap_zero(egress, BR_MAX_PORTS);
 	rp = br_multicast_get_first_rport_node(brmctx, skb);
 
 	if (mdst) {
@@ -319,9 +413,7 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 			port = rport;
 		}
 
-		prev = maybe_deliver(prev, port, skb, local_orig);
-		if (IS_ERR(prev))
-			goto out;
+		maybe_select(port, skb, igmp_type, egress);
 delivered:
 		if ((unsigned long)lport >= (unsigned long)port)
 			p = rcu_dereference(p->next);
@@ -329,17 +421,6 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 			rp = rcu_dereference(hlist_next_rcu(rp));
 	}
 
-	if (!prev)
-		goto out;
-
-	if (local_rcv)
-		deliver_clone(prev, skb, local_orig);
-	else
-		__br_forward(prev, skb, local_orig);
-	return;
-
-out:
-	if (!local_rcv)
-		kfree_skb(skb);
+	deliver_selected(brmctx->br, skb, egress, local_rcv, local_orig);
 }
 #endif
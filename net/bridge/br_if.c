@@ -348,6 +348,7 @@ static void del_nbp(struct net_bridge_port *p)
 
 	br_ifinfo_notify(RTM_DELLINK, NULL, p);
 
+	br_flood_port_del(p);
 	list_del_rcu(&p->list);
 	if (netdev_get_fwd_headroom(dev) == br->dev->needed_headroom)
 		update_headroom(br, get_max_headroom(br));
@@ -636,6 +637,7 @@ int br_add_if(struct net_bridge *br, struct net_device *dev,
 	dev_disable_lro(dev);
 
 	list_add_rcu(&p->list, &br->port_list);
+	br_flood_port_add(p);
 
 	nbp_update_port_count(br);
 	if (!br_promisc_port(p) && (p->dev->priv_flags & IFF_UNICAST_FLT)) {
@@ -702,6 +704,7 @@ int br_add_if(struct net_bridge *br, struct net_device *dev,
 err6:
 	if (fdb_synced)
 		br_fdb_unsync_static(br, p);
+	br_flood_port_del(p);
 	list_del_rcu(&p->list);
 	br_fdb_delete_by_port(br, p, 0, 1);
 	nbp_update_port_count(br);
@@ -760,6 +763,9 @@ void br_port_flags_change(struct net_bridge_port *p, unsigned long mask)
 	if (mask & BR_AUTO_MASK)
 		nbp_update_port_count(br);
 
+	if (mask & (BR_FLOOD | BR_MCAST_FLOOD | BR_BCAST_FLOOD | BR_PROXYARP))
+		br_flood_port_update(p);
+
 	if (mask & (BR_NEIGH_SUPPRESS | BR_NEIGH_VLAN_SUPPRESS))
 		br_recalculate_neigh_suppress_enabled(br);
 }
@@ -202,8 +202,8 @@ int br_handle_frame_finish(struct net *net, struct sock *sk, struct sk_buff *skb
 		if (test_bit(BR_FDB_LOCAL, &dst->flags))
 			return br_pass_frame_up(skb);
 
-		if (now != dst->used)
-			dst->used = now;
+		if (time_after(now, READ_ONCE(dst->used) + BR_FDB_TS_INTERVAL))
+			WRITE_ONCE(dst->used, now);
 		br_forward(dst->dst, skb, local_rcv, false);
 	} else {
 		if (!mcast_hit)
@@ -233,6 +233,9 @@ struct net_bridge_vlan {
 
 	u16				msti;
 
+	/* master only: ports that are members of the vlan */
+	unsigned long			*port_map;
+
 	struct list_head		vlist;
 
 	struct rcu_head			rcu;
@@ -295,6 +298,33 @@ struct net_bridge_fdb_entry {
 	struct rcu_head			rcu;
 };
 
+/* Shared fdb timestamps are refreshed at most once per interval from the
+ * forwarding path, to limit the cache line bouncing between CPUs.
+ */
+#define BR_FDB_TS_INTERVAL		HZ
+
+#define BR_FDB_LEARN_CACHE_SIZE		128
+
+/* Per-CPU record of a source address recently learned on a port.  While
+ * it is valid, br_fdb_update() only touches this CPU local slot; the last
+ * time the address was seen is merged back into the shared entry by
+ * br_fdb_cleanup() before the entry is aged out.
+ */
+struct br_fdb_learn_slot {
+	const struct net_bridge_port	*dst;
+	unsigned long			stamp;
+	unsigned long			seen;
+	unsigned int			gen;
+	u16				vid;
+	u8				addr[ETH_ALEN];
+};
+
+struct br_fdb_learn_cache {
+	struct br_fdb_learn_slot	slots[BR_FDB_LEARN_CACHE_SIZE];
+	/* br_fdb_update() calls that didn't touch the shared fdb */
+	unsigned long			hits;
+};
+
 struct net_bridge_fdb_flush_desc {
 	unsigned long			flags;
 	unsigned long			flags_mask;
@@ -480,6 +510,13 @@ enum net_bridge_opts {
 	BROPT_MST_ENABLED,
 };
 
+enum br_pkt_type {
+	BR_PKT_UNICAST,
+	BR_PKT_MULTICAST,
+	BR_PKT_BROADCAST,
+	__BR_PKT_MAX
+};
+
 struct net_bridge {
 	spinlock_t			lock;
 	spinlock_t			hash_lock;
@@ -494,7 +531,17 @@ struct net_bridge {
 #endif
 
 	struct rhashtable		fdb_hash_tbl;
+	struct br_fdb_learn_cache	__percpu *fdb_learn_cache;
+	/* bumped when an fdb entry roams or is deleted, invalidates the slots */
+	unsigned int			fdb_learn_gen;
 	struct list_head		port_list;
+	/* Ports indexed by port number and the ports each packet type is
+	 * flooded to, see br_flood_port_update(). Updated under RTNL.
+	 */
+	struct net_bridge_port		__rcu **port_by_no;
+	DECLARE_BITMAP(flood_map[__BR_PKT_MAX], BR_MAX_PORTS);
+	/* ports locally originated multicast/broadcast is flooded to */
+	DECLARE_BITMAP(flood_local_map, BR_MAX_PORTS);
 #if IS_ENABLED(CONFIG_BRIDGE_NETFILTER)
 	union {
 		struct rtable		fake_rtable;
@@ -813,6 +860,8 @@ int br_fdb_add_local(struct net_bridge *br, struct net_bridge_port *source,
 		     const unsigned char *addr, u16 vid);
 void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 		   const unsigned char *addr, u16 vid, unsigned long flags);
+void br_fdb_learn_cache_flush(struct net_bridge *br);
+unsigned long br_fdb_learn_cache_hits(const struct net_bridge *br);
 
 int br_fdb_delete(struct ndmsg *ndm, struct nlattr *tb[],
 		  struct net_device *dev, const unsigned char *addr, u16 vid,
@@ -840,11 +889,6 @@ void br_fdb_offloaded_set(struct net_bridge *br, struct net_bridge_port *p,
 			  const unsigned char *addr, u16 vid, bool offloaded);
 
 /* br_forward.c */
-enum br_pkt_type {
-	BR_PKT_UNICAST,
-	BR_PKT_MULTICAST,
-	BR_PKT_BROADCAST
-};
 int br_dev_queue_push_xmit(struct net *net, struct sock *sk, struct sk_buff *skb);
 void br_forward(const struct net_bridge_port *to, struct sk_buff *skb,
 		bool local_rcv, bool local_orig);
@@ -852,6 +896,11 @@ int br_forward_finish(struct net *net, struct sock *sk, struct sk_buff *skb);
 void br_flood(struct net_bridge *br, struct sk_buff *skb,
 	      enum br_pkt_type pkt_type, bool local_rcv, bool local_orig,
 	      u16 vid);
+int br_flood_init(struct net_bridge *br);
+void br_flood_fini(struct net_bridge *br);
+void br_flood_port_add(struct net_bridge_port *p);
+void br_flood_port_del(struct net_bridge_port *p);
+void br_flood_port_update(struct net_bridge_port *p);
 
 /* return true if both source port and dest port are isolated */
 static inline bool br_skb_isolated(const struct net_bridge_port *to,
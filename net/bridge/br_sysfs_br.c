@@ -295,6 +295,15 @@ static ssize_t gc_timer_show(struct device *d, struct device_attribute *attr,
 }
 static DEVICE_ATTR_RO(gc_timer);
 
+static ssize_t fdb_learn_cache_hits_show(struct device *d,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	struct net_bridge *br = to_bridge(d);
+	return sprintf(buf, "%lu\n", br_fdb_learn_cache_hits(br));
+}
+static DEVICE_ATTR_RO(fdb_learn_cache_hits);
+
 static ssize_t group_addr_show(struct device *d,
 			       struct device_attribute *attr, char *buf)
 {
@@ -951,6 +960,7 @@ static struct attribute *bridge_attrs[] = {
 	&dev_attr_tcn_timer.attr,
 	&dev_attr_topology_change_timer.attr,
 	&dev_attr_gc_timer.attr,
+	&dev_attr_fdb_learn_cache_hits.attr,
 	&dev_attr_group_addr.attr,
 	&dev_attr_flush.attr,
 	&dev_attr_no_linklocal_learn.attr,
@@ -192,6 +192,7 @@ static void br_master_vlan_rcu_free(struct rcu_head *rcu)
 	WARN_ON(!br_vlan_is_master(v));
 	free_percpu(v->stats);
 	v->stats = NULL;
+	bitmap_free(v->port_map);
 	kfree(v);
 }
 
@@ -319,11 +320,17 @@ static int __vlan_add(struct net_bridge_vlan *v, u16 flags,
 		}
 		br_multicast_port_ctx_init(p, v, &v->port_mcast_ctx);
 	} else {
+		v->port_map = bitmap_zalloc(BR_MAX_PORTS, GFP_KERNEL);
+		if (!v->port_map) {
+			err = -ENOMEM;
+			goto out;
+		}
+
 		if (br_vlan_should_use(v)) {
 			err = br_switchdev_port_vlan_add(dev, v->vid, flags,
 							 false, extack);
 			if (err && err != -EOPNOTSUPP)
-				goto out;
+				goto out_port_map;
 		}
 		br_multicast_ctx_init(br, v, &v->br_mcast_ctx);
 		v->priv_flags |= BR_VLFLAG_GLOBAL_MCAST_ENABLED;
@@ -351,8 +358,10 @@ static int __vlan_add(struct net_bridge_vlan *v, u16 flags,
 	__vlan_flags_commit(v, flags);
 	br_multicast_toggle_one_vlan(v, true);
 
-	if (p)
+	if (p) {
 		nbp_vlan_set_vlan_dev_state(p, v->vid);
+		set_bit(p->port_no, masterv->port_map);
+	}
 out:
 	return err;
 
@@ -375,6 +384,9 @@ static int __vlan_add(struct net_bridge_vlan *v, u16 flags,
 		}
 	} else {
 		br_switchdev_port_vlan_del(dev, v->vid);
+out_port_map:
+		bitmap_free(v->port_map);
+		v->port_map = NULL;
 	}
 
 	goto out;
@@ -413,6 +425,7 @@ static int __vlan_del(struct net_bridge_vlan *v)
 	}
 
 	if (masterv != v) {
+		clear_bit(p->port_no, masterv->port_map);
 		vlan_tunnel_info_del(vg, v);
 		rhashtable_remove_fast(&vg->vlan_hash, &v->vnode,
 				       br_vlan_rht_params);
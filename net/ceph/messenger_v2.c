@@ -96,6 +96,61 @@ static int do_recvmsg(struct socket *sock, struct iov_iter *it)
 	return 1;
 }
 
+/*
+ * Extend in_data_crc over the next @len bytes of in_bvecs, which were
+ * just received.
+ */
+static void in_data_crc_advance(struct ceph_connection *con, int len)
+{
+	struct bio_vec *bv;
+	int n;
+
+	while (len) {
+		bv = &con->v2.in_bvecs[con->v2.in_crc_bvec];
+		n = min(len, (int)bv->bv_len - con->v2.in_crc_off);
+
+		con->in_data_crc = ceph_crc32c_page(con->in_data_crc,
+						    bv->bv_page,
+						    bv->bv_offset +
+							con->v2.in_crc_off,
+						    n);
+		con->v2.in_crc_off += n;
+		if (con->v2.in_crc_off == bv->bv_len) {
+			con->v2.in_crc_bvec++;
+			con->v2.in_crc_off = 0;
+		}
+		len -= n;
+	}
+}
+
+/*
+ * do_recvmsg() for the data segment pieces mapped by set_in_data_bvecs():
+ * the crc of each chunk is computed as soon as recvmsg returns it, while
+ * it is still cache hot.
+ */
+static int do_recvmsg_data(struct ceph_connection *con)
+{
+	struct iov_iter *it = &con->v2.in_iter;
+	struct msghdr msg = { .msg_flags = CEPH_MSG_FLAGS };
+	int ret;
+
+	msg.msg_iter = *it;
+	while (iov_iter_count(it)) {
+		ret = sock_recvmsg(con->sock, &msg, msg.msg_flags);
+		if (ret <= 0) {
+			if (ret == -EAGAIN)
+				ret = 0;
+			return ret;
+		}
+
+		iov_iter_advance(it, ret);
+		in_data_crc_advance(con, ret);
+	}
+
+	WARN_ON(msg_data_left(&msg));
+	return 1;
+}
+
 /*
  * Read as much as possible.
  *
@@ -111,7 +166,11 @@ static int ceph_tcp_recv(struct ceph_connection *con)
 	dout("%s con %p %s %zu\n", __func__, con,
 	     iov_iter_is_discard(&con->v2.in_iter) ? "discard" : "need",
 	     iov_iter_count(&con->v2.in_iter));
-	ret = do_recvmsg(con->sock, &con->v2.in_iter);
+	if (con->v2.in_state == IN_S_PREPARE_READ_DATA_CONT &&
+	    !ceph_test_opt(from_msgr(con->msgr), RXBOUNCE))
+		ret = do_recvmsg_data(con);
+	else
+		ret = do_recvmsg(con->sock, &con->v2.in_iter);
 	dout("%s con %p ret %d left %zu\n", __func__, con, ret,
 	     iov_iter_count(&con->v2.in_iter));
 	return ret;
@@ -232,8 +291,11 @@ static void set_in_bvec(struct ceph_connection *con, const struct bio_vec *bv)
 {
 	WARN_ON(iov_iter_count(&con->v2.in_iter));
 
-	con->v2.in_bvec = *bv;
-	iov_iter_bvec(&con->v2.in_iter, ITER_DEST, &con->v2.in_bvec, 1, bv->bv_len);
+	con->v2.in_bvecs[0] = *bv;
+	con->v2.in_bvec_cnt = 1;
+	con->v2.in_bvec_len = bv->bv_len;
+	iov_iter_bvec(&con->v2.in_iter, ITER_DEST, con->v2.in_bvecs, 1,
+		      bv->bv_len);
 }
 
 static void set_in_skip(struct ceph_connection *con, int len)
@@ -1760,6 +1822,47 @@ static int prepare_read_control_remainder(struct ceph_connection *con)
 	return 0;
 }
 
+static void advance_in_cursor(struct ceph_connection *con, size_t bytes)
+{
+	struct ceph_msg_data_cursor *cursor = &con->v2.in_cursor;
+
+	/* skip zero-length data items, like get_bvec_at() */
+	while (!cursor->resid)
+		ceph_msg_data_advance(cursor, 0);
+
+	ceph_msg_data_advance(cursor, bytes);
+}
+
+/*
+ * Map up to CEPH_MSGR2_IN_BVECS pieces of data directly, so that a
+ * large data segment is received straight into the destination pages
+ * with a few recvmsg calls and checksummed by do_recvmsg_data() chunk
+ * by chunk, instead of going through the state machine one page at a
+ * time.
+ * A copy of in_cursor is used to look ahead: in_cursor itself is
+ * advanced only once the data has been received.
+ */
+static void set_in_data_bvecs(struct ceph_connection *con)
+{
+	struct ceph_msg_data_cursor cursor = con->v2.in_cursor;
+	struct bio_vec *bv = con->v2.in_bvecs;
+	int cnt = 0, len = 0;
+
+	WARN_ON(iov_iter_count(&con->v2.in_iter));
+
+	do {
+		get_bvec_at(&cursor, &bv[cnt]);
+		ceph_msg_data_advance(&cursor, bv[cnt].bv_len);
+		len += bv[cnt].bv_len;
+	} while (++cnt < CEPH_MSGR2_IN_BVECS && cursor.total_resid);
+
+	con->v2.in_bvec_cnt = cnt;
+	con->v2.in_bvec_len = len;
+	con->v2.in_crc_bvec = 0;
+	con->v2.in_crc_off = 0;
+	iov_iter_bvec(&con->v2.in_iter, ITER_DEST, bv, cnt, len);
+}
+
 static int prepare_read_data(struct ceph_connection *con)
 {
 	struct bio_vec bv;
@@ -1768,7 +1871,6 @@ static int prepare_read_data(struct ceph_connection *con)
 	ceph_msg_data_cursor_init(&con->v2.in_cursor, con->in_msg,
 				  data_len(con->in_msg));
 
-	get_bvec_at(&con->v2.in_cursor, &bv);
 	if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
 		if (unlikely(!con->bounce_page)) {
 			con->bounce_page = alloc_page(GFP_NOIO);
@@ -1778,10 +1880,13 @@ static int prepare_read_data(struct ceph_connection *con)
 			}
 		}
 
+		get_bvec_at(&con->v2.in_cursor, &bv);
 		bv.bv_page = con->bounce_page;
 		bv.bv_offset = 0;
+		set_in_bvec(con, &bv);
+	} else {
+		set_in_data_bvecs(con);
 	}
-	set_in_bvec(con, &bv);
 	con->v2.in_state = IN_S_PREPARE_READ_DATA_CONT;
 	return 0;
 }
@@ -1789,33 +1894,36 @@ static int prepare_read_data(struct ceph_connection *con)
 static void prepare_read_data_cont(struct ceph_connection *con)
 {
 	struct bio_vec bv;
+	int i;
 
 	if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
 		con->in_data_crc = crc32c(con->in_data_crc,
 					  page_address(con->bounce_page),
-					  con->v2.in_bvec.bv_len);
+					  con->v2.in_bvec_len);
 
 		get_bvec_at(&con->v2.in_cursor, &bv);
 		memcpy_to_page(bv.bv_page, bv.bv_offset,
 			       page_address(con->bounce_page),
-			       con->v2.in_bvec.bv_len);
-	} else {
-		con->in_data_crc = ceph_crc32c_page(con->in_data_crc,
-						    con->v2.in_bvec.bv_page,
-						    con->v2.in_bvec.bv_offset,
-						    con->v2.in_bvec.bv_len);
-	}
-
-	ceph_msg_data_advance(&con->v2.in_cursor, con->v2.in_bvec.bv_len);
-	if (con->v2.in_cursor.total_resid) {
-		get_bvec_at(&con->v2.in_cursor, &bv);
-		if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
+			       con->v2.in_bvec_len);
+		ceph_msg_data_advance(&con->v2.in_cursor, con->v2.in_bvec_len);
+		if (con->v2.in_cursor.total_resid) {
+			get_bvec_at(&con->v2.in_cursor, &bv);
 			bv.bv_page = con->bounce_page;
 			bv.bv_offset = 0;
+			set_in_bvec(con, &bv);
+			WARN_ON(con->v2.in_state != IN_S_PREPARE_READ_DATA_CONT);
+			return;
+		}
+	} else {
+		/* in_data_crc is already up to date, see do_recvmsg_data() */
+		WARN_ON(con->v2.in_crc_bvec != con->v2.in_bvec_cnt);
+		for (i = 0; i < con->v2.in_bvec_cnt; i++)
+			advance_in_cursor(con, con->v2.in_bvecs[i].bv_len);
+		if (con->v2.in_cursor.total_resid) {
+			set_in_data_bvecs(con);
+			WARN_ON(con->v2.in_state != IN_S_PREPARE_READ_DATA_CONT);
+			return;
 		}
-		set_in_bvec(con, &bv);
-		WARN_ON(con->v2.in_state != IN_S_PREPARE_READ_DATA_CONT);
-		return;
 	}
 
 	/*
@@ -3451,19 +3559,24 @@ static void revoke_at_prepare_read_data(struct ceph_connection *con)
 
 static void revoke_at_prepare_read_data_cont(struct ceph_connection *con)
 {
-	int recved, resid;  /* current piece of data */
+	int recved, resid;  /* current pieces of data */
 	int remaining;
+	int i;
 
 	WARN_ON(con_secure(con));
 	WARN_ON(!data_len(con->in_msg));
 	WARN_ON(!iov_iter_is_bvec(&con->v2.in_iter));
 	resid = iov_iter_count(&con->v2.in_iter);
-	WARN_ON(!resid || resid > con->v2.in_bvec.bv_len);
-	recved = con->v2.in_bvec.bv_len - resid;
+	WARN_ON(!resid || resid > con->v2.in_bvec_len);
+	recved = con->v2.in_bvec_len - resid;
 	dout("%s con %p recved %d resid %d\n", __func__, con, recved, resid);
 
-	if (recved)
-		ceph_msg_data_advance(&con->v2.in_cursor, recved);
+	for (i = 0; recved; i++) {
+		int len = min(recved, (int)con->v2.in_bvecs[i].bv_len);
+
+		advance_in_cursor(con, len);
+		recved -= len;
+	}
 	WARN_ON(resid > con->v2.in_cursor.total_resid);
 
 	remaining = CEPH_EPILOGUE_PLAIN_LEN;
@@ -3481,7 +3594,7 @@ static void revoke_at_prepare_read_enc_page(struct ceph_connection *con)
 	WARN_ON(!con_secure(con));
 	WARN_ON(!iov_iter_is_bvec(&con->v2.in_iter));
 	resid = iov_iter_count(&con->v2.in_iter);
-	WARN_ON(!resid || resid > con->v2.in_bvec.bv_len);
+	WARN_ON(!resid || resid > con->v2.in_bvec_len);
 
 	dout("%s con %p resid %d enc_resid %d\n", __func__, con, resid,
 	     con->v2.in_enc_resid);
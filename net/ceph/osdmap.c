@@ -778,9 +778,156 @@ u64 ceph_pg_pool_flags(struct ceph_osdmap *map, u64 id)
 }
 EXPORT_SYMBOL(ceph_pg_pool_flags);
 
+/*
+ * Cache of the raw CRUSH output for each placement seed of a pool,
+ * filled on lookup and indexed by ps (raw seed folded by pgp_num).
+ *
+ * The cache is only modified under the osdmap write lock, except for
+ * filling individual entries, which may happen under the read lock:
+ * an entry is claimed with cmpxchg INVALID -> FILLING and published
+ * with a release store of VALID, so concurrent lookups either see a
+ * complete entry or compute the mapping themselves.
+ */
+enum {
+	PG_RAW_INVALID = 0,
+	PG_RAW_FILLING,
+	PG_RAW_VALID,
+};
+
+struct ceph_pg_raw_cache {
+	u32 pgp_num;
+	int width;		/* pool size */
+	atomic_t *state;	/* PG_RAW_* */
+	u8 *len;
+	s32 *osds;		/* pgp_num * width */
+};
+
+static void free_pg_raw_cache(struct ceph_pg_raw_cache *rc)
+{
+	if (!rc)
+		return;
+
+	kvfree(rc->state);
+	kvfree(rc->len);
+	kvfree(rc->osds);
+	kfree(rc);
+}
+
+static struct ceph_pg_raw_cache *alloc_pg_raw_cache(u32 pgp_num, int width)
+{
+	struct ceph_pg_raw_cache *rc;
+
+	rc = kzalloc(sizeof(*rc), GFP_NOFS);
+	if (!rc)
+		return NULL;
+
+	rc->pgp_num = pgp_num;
+	rc->width = width;
+	rc->state = kvcalloc(pgp_num, sizeof(*rc->state), GFP_NOFS);
+	rc->len = kvcalloc(pgp_num, sizeof(*rc->len), GFP_NOFS);
+	rc->osds = kvmalloc_array(array_size(pgp_num, width),
+				  sizeof(*rc->osds), GFP_NOFS);
+	if (!rc->state || !rc->len || !rc->osds) {
+		free_pg_raw_cache(rc);
+		return NULL;
+	}
+
+	return rc;
+}
+
+/*
+ * (Re)create the cache after the pool was decoded.  Failing to
+ * allocate it is not an error, lookups just go to CRUSH every time.
+ */
+static void reset_pg_raw_cache(struct ceph_pg_pool_info *pi)
+{
+	struct ceph_pg_raw_cache *rc = pi->raw_cache;
+
+	if (rc && rc->pgp_num == pi->pgp_num && rc->width == pi->size) {
+		memset(rc->state, 0, rc->pgp_num * sizeof(*rc->state));
+		return;
+	}
+
+	free_pg_raw_cache(rc);
+	pi->raw_cache = NULL;
+	if (pi->pgp_num && pi->size && pi->size <= CEPH_PG_MAX_SIZE)
+		pi->raw_cache = alloc_pg_raw_cache(pi->pgp_num, pi->size);
+}
+
+/*
+ * Invalidate the cached mappings of all pools.  If @osd is not -1,
+ * only those that contain @osd are invalidated.
+ */
+static void invalidate_pg_raw_caches(struct ceph_osdmap *map, int osd)
+{
+	struct rb_node *n;
+	u32 ps;
+	int i;
+
+	for (n = rb_first(&map->pg_pools); n; n = rb_next(n)) {
+		struct ceph_pg_pool_info *pi =
+			rb_entry(n, struct ceph_pg_pool_info, node);
+		struct ceph_pg_raw_cache *rc = pi->raw_cache;
+
+		if (!rc)
+			continue;
+
+		if (osd == -1) {
+			memset(rc->state, 0, rc->pgp_num * sizeof(*rc->state));
+			continue;
+		}
+
+		for (ps = 0; ps < rc->pgp_num; ps++) {
+			s32 *osds = rc->osds + ps * rc->width;
+
+			if (atomic_read(&rc->state[ps]) != PG_RAW_VALID)
+				continue;
+
+			for (i = 0; i < rc->len[ps]; i++) {
+				if (osds[i] == osd) {
+					atomic_set(&rc->state[ps],
+						   PG_RAW_INVALID);
+					break;
+				}
+			}
+		}
+	}
+}
+
+static int lookup_pg_raw_cache(struct ceph_pg_pool_info *pi, u32 ps,
+			       int *osds)
+{
+	struct ceph_pg_raw_cache *rc = pi->raw_cache;
+	int len;
+
+	if (!rc || ps >= rc->pgp_num ||
+	    atomic_read_acquire(&rc->state[ps]) != PG_RAW_VALID)
+		return -ENOENT;
+
+	len = rc->len[ps];
+	memcpy(osds, rc->osds + ps * rc->width, len * sizeof(*osds));
+	return len;
+}
+
+static void fill_pg_raw_cache(struct ceph_pg_pool_info *pi, u32 ps,
+			      const int *osds, int len)
+{
+	struct ceph_pg_raw_cache *rc = pi->raw_cache;
+
+	if (!rc || ps >= rc->pgp_num || len > rc->width ||
+	    atomic_cmpxchg(&rc->state[ps], PG_RAW_INVALID,
+			   PG_RAW_FILLING) != PG_RAW_INVALID)
+		return;
+
+	rc->len[ps] = len;
+	memcpy(rc->osds + ps * rc->width, osds, len * sizeof(*osds));
+	atomic_set_release(&rc->state[ps], PG_RAW_VALID);
+}
+
 static void __remove_pg_pool(struct rb_root *root, struct ceph_pg_pool_info *pi)
 {
 	erase_pg_pool(root, pi);
+	free_pg_raw_cache(pi->raw_cache);
 	kfree(pi->name);
 	kfree(pi);
 }
@@ -1254,6 +1401,7 @@ static int osdmap_set_max_osd(struct ceph_osdmap *map, u32 max)
 	}
 
 	map->max_osd = max;
+	invalidate_pg_raw_caches(map, -1);
 
 	return 0;
 }
@@ -1276,6 +1424,7 @@ static int osdmap_set_crush(struct ceph_osdmap *map, struct crush_map *crush)
 	cleanup_workspace_manager(&map->crush_wsm);
 	map->crush = crush;
 	add_initial_workspace(&map->crush_wsm, work);
+	invalidate_pg_raw_caches(map, -1);
 	return 0;
 }
 
@@ -1367,6 +1516,8 @@ static int __decode_pools(void **p, void *end, struct ceph_osdmap *map,
 		ret = decode_pool(p, end, pi);
 		if (ret)
 			return ret;
+
+		reset_pg_raw_cache(pi);
 	}
 
 	return 0;
@@ -1883,6 +2034,17 @@ static int decode_new_up_state_weight(void **p, void *end, u8 struct_v,
 		osdmap_info(map, "osd%d weight 0x%x %s\n", osd, w,
 			    w == CEPH_OSD_IN ? "(in)" :
 			    (w == CEPH_OSD_OUT ? "(out)" : ""));
+
+		/*
+		 * CRUSH rejects an OSD with a probability that only
+		 * depends on its weight.  A lower weight can only
+		 * remap PGs that currently use the OSD, a higher one
+		 * can pull in any PG that rejected it before.
+		 */
+		if (w < map->osd_weight[osd])
+			invalidate_pg_raw_caches(map, osd);
+		else if (w > map->osd_weight[osd])
+			invalidate_pg_raw_caches(map, -1);
 		map->osd_weight[osd] = w;
 
 		/*
@@ -2553,6 +2715,8 @@ static void pg_to_raw_osds(struct ceph_osdmap *osdmap,
 			   u32 *ppps)
 {
 	u32 pps = raw_pg_to_pps(pi, raw_pgid);
+	u32 ps = ceph_stable_mod(raw_pgid->seed, pi->pgp_num,
+				 pi->pgp_num_mask);
 	int ruleno;
 	int len;
 
@@ -2560,6 +2724,10 @@ static void pg_to_raw_osds(struct ceph_osdmap *osdmap,
 	if (ppps)
 		*ppps = pps;
 
+	len = lookup_pg_raw_cache(pi, ps, raw->osds);
+	if (len >= 0)
+		goto out;
+
 	ruleno = crush_find_rule(osdmap->crush, pi->crush_ruleset, pi->type,
 				 pi->size);
 	if (ruleno < 0) {
@@ -2584,6 +2752,8 @@ static void pg_to_raw_osds(struct ceph_osdmap *osdmap,
 		return;
 	}
 
+	fill_pg_raw_cache(pi, ps, raw->osds, len);
+out:
 	raw->size = len;
 	remove_nonexistent_osds(osdmap, pi, raw);
 }
@@ -60,6 +60,9 @@ static const struct snmp_mib mptcp_snmp_list[] = {
 	SNMP_MIB_ITEM("RcvWndShared", MPTCP_MIB_RCVWNDSHARED),
 	SNMP_MIB_ITEM("RcvWndConflictUpdate", MPTCP_MIB_RCVWNDCONFLICTUPDATE),
 	SNMP_MIB_ITEM("RcvWndConflict", MPTCP_MIB_RCVWNDCONFLICT),
+	SNMP_MIB_ITEM("RedundantSegs", MPTCP_MIB_REDUNDANTSEGS),
+	SNMP_MIB_ITEM("RcvMoveBatch", MPTCP_MIB_RCVMOVEBATCH),
+	SNMP_MIB_ITEM("RcvMoveSkbs", MPTCP_MIB_RCVMOVESKBS),
 	SNMP_MIB_SENTINEL
 };
 
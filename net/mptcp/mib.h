@@ -55,6 +55,9 @@ enum linux_mptcp_mib_field {
 					 * conflict with another subflow while updating msk rcv wnd
 					 */
 	MPTCP_MIB_RCVWNDCONFLICT,	/* Conflict with while updating msk rcv wnd */
+	MPTCP_MIB_REDUNDANTSEGS,	/* Segments sent again on a redundant subflow */
+	MPTCP_MIB_RCVMOVEBATCH,		/* Runs of in-sequence skbs spliced into the msk */
+	MPTCP_MIB_RCVMOVESKBS,		/* Skbs moved from the subflows into the msk */
 	__MPTCP_MIB_MAX
 };
 
@@ -70,6 +73,14 @@ static inline void MPTCP_INC_STATS(struct net *net,
 		SNMP_INC_STATS(net->mib.mptcp_statistics, field);
 }
 
+static inline void MPTCP_ADD_STATS(struct net *net,
+				   enum linux_mptcp_mib_field field,
+				   int val)
+{
+	if (likely(net->mib.mptcp_statistics))
+		SNMP_ADD_STATS(net->mib.mptcp_statistics, field, val);
+}
+
 static inline void __MPTCP_INC_STATS(struct net *net,
 				     enum linux_mptcp_mib_field field)
 {
@@ -140,14 +140,16 @@ static void mptcp_rmem_charge(struct sock *sk, int size)
 	mptcp_sk(sk)->rmem_fwd_alloc -= size;
 }
 
-static bool mptcp_try_coalesce(struct sock *sk, struct sk_buff *to,
-			       struct sk_buff *from)
+/* on success the caller owns @from and must release it with
+ * kfree_skb_partial()
+ */
+static bool __mptcp_try_coalesce(struct sock *sk, struct sk_buff *to,
+				 struct sk_buff *from, bool *fragstolen)
 {
-	bool fragstolen;
 	int delta;
 
 	if (MPTCP_SKB_CB(from)->offset ||
-	    !skb_try_coalesce(to, from, &fragstolen, &delta))
+	    !skb_try_coalesce(to, from, fragstolen, &delta))
 		return false;
 
 	pr_debug("colesced seq %llx into %llx new len %d new end seq %llx",
@@ -161,8 +163,18 @@ static bool mptcp_try_coalesce(struct sock *sk, struct sk_buff *to,
 	 */
 	atomic_add(delta, &sk->sk_rmem_alloc);
 	mptcp_rmem_charge(sk, delta);
-	kfree_skb_partial(from, fragstolen);
+	return true;
+}
 
+static bool mptcp_try_coalesce(struct sock *sk, struct sk_buff *to,
+			       struct sk_buff *from)
+{
+	bool fragstolen;
+
+	if (!__mptcp_try_coalesce(sk, to, from, &fragstolen))
+		return false;
+
+	kfree_skb_partial(from, fragstolen);
 	return true;
 }
 
@@ -204,15 +216,45 @@ static void mptcp_rfree(struct sk_buff *skb)
 	mptcp_rmem_uncharge(sk, len);
 }
 
-void mptcp_set_owner_r(struct sk_buff *skb, struct sock *sk)
+/* the caller is responsible for adding skb->truesize to sk_rmem_alloc */
+static void __mptcp_set_owner_r(struct sk_buff *skb, struct sock *sk)
 {
 	skb_orphan(skb);
 	skb->sk = sk;
 	skb->destructor = mptcp_rfree;
-	atomic_add(skb->truesize, &sk->sk_rmem_alloc);
 	mptcp_rmem_charge(sk, skb->truesize);
 }
 
+void mptcp_set_owner_r(struct sk_buff *skb, struct sock *sk)
+{
+	__mptcp_set_owner_r(skb, sk);
+	atomic_add(skb->truesize, &sk->sk_rmem_alloc);
+}
+
+/* Merge into @skb the following OoO segments contiguous with it, so that
+ * each rbtree node spans the widest possible data sequence range and
+ * filling a hole lets __mptcp_ofo_queue() move the whole range at once.
+ * @skb must be already owned by the msk.
+ */
+static void mptcp_ooo_merge_next(struct mptcp_sock *msk, struct sk_buff *skb)
+{
+	struct sock *sk = (struct sock *)msk;
+	struct sk_buff *next;
+	bool fragstolen;
+
+	while ((next = skb_rb_next(skb)) != NULL) {
+		if (MPTCP_SKB_CB(next)->map_seq != MPTCP_SKB_CB(skb)->end_seq ||
+		    !__mptcp_try_coalesce(sk, skb, next, &fragstolen))
+			break;
+
+		rb_erase(&next->rbnode, &msk->out_of_order_queue);
+		if (msk->ooo_last_skb == next)
+			msk->ooo_last_skb = skb;
+		kfree_skb_partial(next, fragstolen);
+		MPTCP_INC_STATS(sock_net(sk), MPTCP_MIB_OFOMERGE);
+	}
+}
+
 /* "inspired" by tcp_data_queue_ofo(), main differences:
  * - use mptcp seqs
  * - don't cope with sacks
@@ -300,6 +342,7 @@ static void mptcp_data_queue_ofo(struct mptcp_sock *msk, struct sk_buff *skb)
 			}
 		} else if (mptcp_ooo_try_coalesce(msk, skb1, skb)) {
 			MPTCP_INC_STATS(sock_net(sk), MPTCP_MIB_OFOMERGE);
+			mptcp_ooo_merge_next(msk, skb1);
 			return;
 		}
 		p = &parent->rb_right;
@@ -326,6 +369,7 @@ static void mptcp_data_queue_ofo(struct mptcp_sock *msk, struct sk_buff *skb)
 end:
 	skb_condense(skb);
 	mptcp_set_owner_r(skb, sk);
+	mptcp_ooo_merge_next(msk, skb);
 }
 
 static bool mptcp_rmem_schedule(struct sock *sk, struct sock *ssk, int size)
@@ -346,9 +390,36 @@ static bool mptcp_rmem_schedule(struct sock *sk, struct sock *ssk, int size)
 	return true;
 }
 
+/* In-sequence skbs moved from a subflow are collected here and spliced
+ * into the msk receive queue with a single operation; their truesize is
+ * added to sk_rmem_alloc at splice time.
+ */
+struct mptcp_rcv_batch {
+	struct sk_buff_head	queue;
+	int			truesize;
+};
+
+static void mptcp_rcv_batch_init(struct mptcp_rcv_batch *batch)
+{
+	__skb_queue_head_init(&batch->queue);
+	batch->truesize = 0;
+}
+
+static void mptcp_rcv_batch_flush(struct sock *sk,
+				  struct mptcp_rcv_batch *batch)
+{
+	if (skb_queue_empty(&batch->queue))
+		return;
+
+	atomic_add(batch->truesize, &sk->sk_rmem_alloc);
+	batch->truesize = 0;
+	skb_queue_splice_tail_init(&batch->queue, &sk->sk_receive_queue);
+	MPTCP_INC_STATS(sock_net(sk), MPTCP_MIB_RCVMOVEBATCH);
+}
+
 static bool __mptcp_move_skb(struct mptcp_sock *msk, struct sock *ssk,
 			     struct sk_buff *skb, unsigned int offset,
-			     size_t copy_len)
+			     size_t copy_len, struct mptcp_rcv_batch *batch)
 {
 	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
 	struct sock *sk = (struct sock *)msk;
@@ -378,12 +449,14 @@ static bool __mptcp_move_skb(struct mptcp_sock *msk, struct sock *ssk,
 	if (MPTCP_SKB_CB(skb)->map_seq == msk->ack_seq) {
 		/* in sequence */
 		WRITE_ONCE(msk->ack_seq, msk->ack_seq + copy_len);
-		tail = skb_peek_tail(&sk->sk_receive_queue);
+		tail = skb_peek_tail(&batch->queue) ?:
+		       skb_peek_tail(&sk->sk_receive_queue);
 		if (tail && mptcp_try_coalesce(sk, tail, skb))
 			return true;
 
-		mptcp_set_owner_r(skb, sk);
-		__skb_queue_tail(&sk->sk_receive_queue, skb);
+		__mptcp_set_owner_r(skb, sk);
+		batch->truesize += skb->truesize;
+		__skb_queue_tail(&batch->queue, skb);
 		return true;
 	} else if (after64(MPTCP_SKB_CB(skb)->map_seq, msk->ack_seq)) {
 		mptcp_data_queue_ofo(msk, skb);
@@ -495,7 +568,7 @@ static long mptcp_timeout_from_subflow(const struct mptcp_subflow_context *subfl
 	       inet_csk(ssk)->icsk_timeout - jiffies : 0;
 }
 
-static void mptcp_set_timeout(struct sock *sk)
+void mptcp_set_timeout(struct sock *sk)
 {
 	struct mptcp_subflow_context *subflow;
 	long tout = 0;
@@ -632,13 +705,15 @@ static bool __mptcp_move_skbs_from_subflow(struct mptcp_sock *msk,
 {
 	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
 	struct sock *sk = (struct sock *)msk;
+	struct mptcp_rcv_batch batch;
 	unsigned int moved = 0;
 	bool more_data_avail;
 	struct tcp_sock *tp;
 	bool done = false;
-	int sk_rbuf;
+	int sk_rbuf, skbs = 0;
 
 	sk_rbuf = READ_ONCE(sk->sk_rcvbuf);
+	mptcp_rcv_batch_init(&batch);
 
 	if (!(sk->sk_userlocks & SOCK_RCVBUF_LOCK)) {
 		int ssk_rbuf = READ_ONCE(ssk->sk_rcvbuf);
@@ -694,9 +769,10 @@ static bool __mptcp_move_skbs_from_subflow(struct mptcp_sock *msk,
 			if (tp->urg_data)
 				done = true;
 
-			if (__mptcp_move_skb(msk, ssk, skb, offset, len))
+			if (__mptcp_move_skb(msk, ssk, skb, offset, len, &batch))
 				moved += len;
 			seq += len;
+			skbs++;
 
 			if (WARN_ON_ONCE(map_remaining < len))
 				break;
@@ -709,12 +785,16 @@ static bool __mptcp_move_skbs_from_subflow(struct mptcp_sock *msk,
 		WRITE_ONCE(tp->copied_seq, seq);
 		more_data_avail = mptcp_subflow_data_available(ssk);
 
-		if (atomic_read(&sk->sk_rmem_alloc) > sk_rbuf) {
+		if (atomic_read(&sk->sk_rmem_alloc) + batch.truesize > sk_rbuf) {
 			done = true;
 			break;
 		}
 	} while (more_data_avail);
 
+	mptcp_rcv_batch_flush(sk, &batch);
+	if (skbs)
+		MPTCP_ADD_STATS(sock_net(sk), MPTCP_MIB_RCVMOVESKBS, skbs);
+
 	*bytes += moved;
 	return done;
 }
@@ -1366,11 +1446,11 @@ bool mptcp_subflow_active(struct mptcp_subflow_context *subflow)
 #define SSK_MODE_BACKUP	1
 #define SSK_MODE_MAX	2
 
-/* implement the mptcp packet scheduler;
+/* implement the default mptcp packet scheduler;
  * returns the subflow that will transmit the next DSS
  * additionally updates the rtx timeout
  */
-static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
+struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
 {
 	struct subflow_send_info send_info[SSK_MODE_MAX];
 	struct mptcp_subflow_context *subflow;
@@ -1381,15 +1461,6 @@ static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
 	u64 linger_time;
 	long tout = 0;
 
-	msk_owned_by_me(msk);
-
-	if (__mptcp_check_fallback(msk)) {
-		if (!msk->first)
-			return NULL;
-		return __tcp_can_send(msk->first) &&
-		       sk_stream_memory_free(msk->first) ? msk->first : NULL;
-	}
-
 	/* re-use last subflow, if the burst allow that */
 	if (msk->last_snd && msk->snd_burst > 0 &&
 	    sk_stream_memory_free(msk->last_snd) &&
@@ -1501,6 +1572,105 @@ void mptcp_check_and_set_pending(struct sock *sk)
 		mptcp_sk(sk)->push_pending |= BIT(MPTCP_PUSH_PENDING);
 }
 
+/* Called after the data in [seq, seq + len) went out on the subflow the
+ * packet scheduler picked last: the subflows it flagged as redundant for
+ * that pick must send a copy of it. Redundant copies are best effort, a
+ * subflow keeps a single contiguous range, so a gap drops the older one.
+ * The flags are cleared whether the send succeeded (@len > 0) or not.
+ */
+static void mptcp_redundant_note(struct mptcp_sock *msk, u64 seq, int len)
+{
+	struct mptcp_subflow_context *subflow;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		if (!subflow->redundant)
+			continue;
+
+		subflow->redundant = false;
+		if (len <= 0)
+			continue;
+
+		if (subflow->redundant_seq == subflow->redundant_end ||
+		    subflow->redundant_end != seq)
+			subflow->redundant_seq = seq;
+		subflow->redundant_end = seq + len;
+	}
+}
+
+/* Send the pending redundant copy of @ssk, which must be locked. The data
+ * is still in the rtx queue, so this is a retransmission from the subflow's
+ * point of view.
+ */
+static bool __mptcp_subflow_push_redundant(struct sock *sk, struct sock *ssk,
+					   bool data_lock_held)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct mptcp_sendmsg_info info = {
+		.data_lock_held = data_lock_held,
+	};
+	u64 start = subflow->redundant_seq, end = subflow->redundant_end;
+	struct mptcp_data_frag *dfrag;
+	bool copied = false;
+
+	subflow->redundant_seq = end;
+
+	/* with csum enabled a DSS mapping can't be split across
+	 * subflows at arbitrary offsets
+	 */
+	if (!before64(start, end) || READ_ONCE(msk->csum_enabled))
+		return false;
+
+	list_for_each_entry(dfrag, &msk->rtx_queue, list) {
+		u64 dfrag_end = dfrag->data_seq + dfrag->already_sent;
+
+		if (!after64(dfrag_end, start))
+			continue;
+		if (!before64(dfrag->data_seq, end))
+			break;
+
+		info.sent = after64(start, dfrag->data_seq) ?
+			    start - dfrag->data_seq : 0;
+		info.limit = before64(end, dfrag_end) ?
+			     end - dfrag->data_seq : dfrag->already_sent;
+		while (info.sent < info.limit) {
+			int ret = mptcp_sendmsg_frag(sk, ssk, dfrag, &info);
+
+			if (ret <= 0)
+				goto out;
+
+			MPTCP_INC_STATS(sock_net(sk), MPTCP_MIB_REDUNDANTSEGS);
+			info.sent += ret;
+			copied = true;
+		}
+	}
+out:
+	if (info.mss_now)
+		tcp_push(ssk, 0, info.mss_now, tcp_sk(ssk)->nonagle,
+			 info.size_goal);
+	if (copied)
+		WRITE_ONCE(msk->allow_infinite_fallback, false);
+	return copied;
+}
+
+static void __mptcp_push_redundant(struct sock *sk)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct mptcp_subflow_context *subflow;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *ssk;
+
+		if (subflow->redundant_seq == subflow->redundant_end)
+			continue;
+
+		ssk = mptcp_subflow_tcp_sock(subflow);
+		lock_sock(ssk);
+		__mptcp_subflow_push_redundant(sk, ssk, false);
+		release_sock(ssk);
+	}
+}
+
 void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 {
 	struct sock *prev_ssk = NULL, *ssk = NULL;
@@ -1520,7 +1690,7 @@ void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 			int ret = 0;
 
 			prev_ssk = ssk;
-			ssk = mptcp_subflow_get_send(msk);
+			ssk = mptcp_sched_get_send(msk);
 
 			/* First check. If the ssk has changed since
 			 * the last round, release prev_ssk
@@ -1538,6 +1708,8 @@ void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 				lock_sock(ssk);
 
 			ret = mptcp_sendmsg_frag(sk, ssk, dfrag, &info);
+			mptcp_redundant_note(msk, dfrag->data_seq + info.sent,
+					     ret);
 			if (ret <= 0) {
 				if (ret == -EAGAIN)
 					continue;
@@ -1559,6 +1731,8 @@ void __mptcp_push_pending(struct sock *sk, unsigned int flags)
 		mptcp_push_release(ssk, &info);
 
 out:
+	__mptcp_push_redundant(sk);
+
 	/* ensure the rtx timer is running */
 	if (!mptcp_timer_pending(sk))
 		mptcp_reset_timer(sk);
@@ -1572,10 +1746,20 @@ static void __mptcp_subflow_push_pending(struct sock *sk, struct sock *ssk, bool
 	struct mptcp_sendmsg_info info = {
 		.data_lock_held = true,
 	};
+	struct mptcp_subflow_context *subflow;
 	struct mptcp_data_frag *dfrag;
 	struct sock *xmit_ssk;
 	int len, copied = 0;
 
+	/* Redundant copies left for this subflow by earlier picks. This may
+	 * be why it was delegated, so don't take it as the scheduler's pick.
+	 */
+	if (__mptcp_subflow_push_redundant(sk, ssk, true)) {
+		first = false;
+		if (!mptcp_timer_pending(sk))
+			mptcp_reset_timer(sk);
+	}
+
 	info.flags = 0;
 	while ((dfrag = mptcp_send_head(sk))) {
 		info.sent = dfrag->already_sent;
@@ -1587,16 +1771,19 @@ static void __mptcp_subflow_push_pending(struct sock *sk, struct sock *ssk, bool
 			/* check for a different subflow usage only after
 			 * spooling the first chunk of data
 			 */
-			xmit_ssk = first ? ssk : mptcp_subflow_get_send(msk);
+			xmit_ssk = first ? ssk : mptcp_sched_get_send(msk);
 			if (!xmit_ssk)
 				goto out;
 			if (xmit_ssk != ssk) {
+				mptcp_redundant_note(msk, 0, 0);
 				mptcp_subflow_delegate(mptcp_subflow_ctx(xmit_ssk),
 						       MPTCP_DELEGATE_SEND);
 				goto out;
 			}
 
 			ret = mptcp_sendmsg_frag(sk, ssk, dfrag, &info);
+			mptcp_redundant_note(msk, dfrag->data_seq + info.sent,
+					     ret);
 			if (ret <= 0)
 				goto out;
 
@@ -1611,6 +1798,15 @@ static void __mptcp_subflow_push_pending(struct sock *sk, struct sock *ssk, bool
 	}
 
 out:
+	/* the other subflows can't be locked here, let them send their
+	 * redundant copies on their own
+	 */
+	mptcp_for_each_subflow(msk, subflow) {
+		if (subflow->redundant_seq != subflow->redundant_end &&
+		    mptcp_subflow_tcp_sock(subflow) != ssk)
+			mptcp_subflow_delegate(subflow, MPTCP_DELEGATE_SEND);
+	}
+
 	/* __mptcp_alloc_tx_skb could have released some wmem and we are
 	 * not going to flush it via release_sock()
 	 */
@@ -2719,6 +2915,10 @@ static int mptcp_init_sock(struct sock *sk)
 	if (unlikely(!net->mib.mptcp_statistics) && !mptcp_mib_alloc(net))
 		return -ENOMEM;
 
+	/* fall back to the default scheduler if the configured one is gone */
+	if (mptcp_set_sched_by_name(mptcp_sk(sk), mptcp_get_scheduler(net)))
+		mptcp_init_sched(mptcp_sk(sk), NULL);
+
 	set_bit(SOCK_CUSTOM_SOCKOPT, &sk->sk_socket->flags);
 
 	/* fetch the ca name; do it outside __mptcp_init_sock(), so that clone will
@@ -3118,6 +3318,8 @@ struct sock *mptcp_sk_clone_init(const struct sock *sk,
 	msk->snd_una = msk->write_seq;
 	msk->wnd_end = msk->snd_nxt + req->rsk_rcv_wnd;
 	msk->setsockopt_seq = mptcp_sk(sk)->setsockopt_seq;
+	if (mptcp_init_sched(msk, mptcp_sk(sk)->sched))
+		mptcp_init_sched(msk, NULL);
 
 	sock_reset_flag(nsk, SOCK_RCU_FREE);
 	security_inet_csk_clone(nsk, req);
@@ -3251,6 +3453,7 @@ static void mptcp_destroy(struct sock *sk)
 	 */
 	mptcp_dispose_initial_subflow(msk);
 	mptcp_destroy_common(msk, 0);
+	mptcp_release_sched(msk);
 	sk_sockets_allocated_dec(sk);
 }
 
@@ -3927,6 +4130,7 @@ void __init mptcp_proto_init(void)
 
 	mptcp_subflow_init();
 	mptcp_pm_init();
+	mptcp_sched_init();
 	mptcp_token_init();
 
 	if (proto_register(&mptcp_prot, 1) != 0)
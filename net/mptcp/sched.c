@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * Packet scheduler framework and in-kernel schedulers.
+ */
+
+#define pr_fmt(fmt) "MPTCP: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+#include "protocol.h"
+
+static DEFINE_SPINLOCK(mptcp_sched_list_lock);
+static LIST_HEAD(mptcp_sched_list);
+
+static int mptcp_sched_default_get_subflow(struct mptcp_sock *msk,
+					   struct mptcp_sched_data *data)
+{
+	struct sock *ssk;
+
+	ssk = mptcp_subflow_get_send(msk);
+	if (!ssk)
+		return -EINVAL;
+
+	mptcp_subflow_set_scheduled(mptcp_subflow_ctx(ssk), true);
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_default = {
+	.get_subflow	= mptcp_sched_default_get_subflow,
+	.name		= "default",
+	.owner		= THIS_MODULE,
+};
+
+static bool mptcp_sched_can_send(struct mptcp_subflow_context *subflow)
+{
+	return mptcp_subflow_active(subflow) &&
+	       sk_stream_memory_free(mptcp_subflow_tcp_sock(subflow));
+}
+
+/* Send every chunk on the two active subflows with the lowest smoothed
+ * RTT. The receiver keeps whichever copy shows up first and drops the
+ * other one by DSN, trading bandwidth for tail latency. Backup subflows
+ * are used only when no other subflow is available.
+ */
+static int mptcp_sched_red_get_subflow(struct mptcp_sock *msk,
+				       struct mptcp_sched_data *data)
+{
+	struct mptcp_subflow_context *subflow, *best[2] = {};
+	u32 srtt, rtt[2] = { U32_MAX, U32_MAX };
+	int backup, i;
+
+	for (backup = 0; backup <= 1 && !best[0]; backup++) {
+		for (i = 0; i < data->subflows; i++) {
+			subflow = data->contexts[i];
+			if (subflow->backup != backup ||
+			    !mptcp_sched_can_send(subflow))
+				continue;
+
+			srtt = READ_ONCE(tcp_sk(mptcp_subflow_tcp_sock(subflow))->srtt_us);
+			if (srtt < rtt[0]) {
+				best[1] = best[0];
+				rtt[1] = rtt[0];
+				best[0] = subflow;
+				rtt[0] = srtt;
+			} else if (srtt < rtt[1]) {
+				best[1] = subflow;
+				rtt[1] = srtt;
+			}
+		}
+	}
+
+	if (!best[0])
+		return -EINVAL;
+
+	mptcp_set_timeout((struct sock *)msk);
+	mptcp_subflow_set_scheduled(best[0], true);
+	if (best[1])
+		best[1]->redundant = true;
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_red = {
+	.get_subflow	= mptcp_sched_red_get_subflow,
+	.name		= "redundant",
+	.owner		= THIS_MODULE,
+};
+
+/* Weighted round-robin: every active subflow gets a share of the traffic
+ * proportional to its pacing rate. Pick the subflow that is furthest
+ * behind its share, i.e. the one that would have needed the least time
+ * to send everything it sent so far at its current rate.
+ */
+static int mptcp_sched_wrr_get_subflow(struct mptcp_sock *msk,
+				       struct mptcp_sched_data *data)
+{
+	struct mptcp_subflow_context *subflow, *best = NULL;
+	u64 vtime, best_vtime = U64_MAX;
+	int backup, i;
+
+	for (backup = 0; backup <= 1 && !best; backup++) {
+		for (i = 0; i < data->subflows; i++) {
+			unsigned long pace;
+			struct sock *ssk;
+
+			subflow = data->contexts[i];
+			if (subflow->backup != backup ||
+			    !mptcp_sched_can_send(subflow))
+				continue;
+
+			ssk = mptcp_subflow_tcp_sock(subflow);
+			pace = READ_ONCE(ssk->sk_pacing_rate);
+			if (!pace)
+				continue;
+
+			vtime = mul_u64_u64_div_u64(READ_ONCE(tcp_sk(ssk)->bytes_sent),
+						    NSEC_PER_SEC, pace);
+			if (vtime < best_vtime) {
+				best = subflow;
+				best_vtime = vtime;
+			}
+		}
+	}
+
+	if (!best)
+		return -EINVAL;
+
+	mptcp_set_timeout((struct sock *)msk);
+	mptcp_subflow_set_scheduled(best, true);
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_wrr = {
+	.get_subflow	= mptcp_sched_wrr_get_subflow,
+	.name		= "wrr",
+	.owner		= THIS_MODULE,
+};
+
+/* Must be called with rcu read lock held or mptcp_sched_list_lock */
+struct mptcp_sched_ops *mptcp_sched_find(const char *name)
+{
+	struct mptcp_sched_ops *sched, *ret = NULL;
+
+	list_for_each_entry_rcu(sched, &mptcp_sched_list, list,
+				lockdep_is_held(&mptcp_sched_list_lock)) {
+		if (!strcmp(sched->name, name)) {
+			ret = sched;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched)
+{
+	if (!sched->get_subflow)
+		return -EINVAL;
+
+	spin_lock(&mptcp_sched_list_lock);
+	if (mptcp_sched_find(sched->name)) {
+		spin_unlock(&mptcp_sched_list_lock);
+		return -EEXIST;
+	}
+	list_add_tail_rcu(&sched->list, &mptcp_sched_list);
+	spin_unlock(&mptcp_sched_list_lock);
+
+	pr_debug("%s registered", sched->name);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(mptcp_register_scheduler);
+
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched)
+{
+	if (sched == &mptcp_sched_default)
+		return;
+
+	spin_lock(&mptcp_sched_list_lock);
+	list_del_rcu(&sched->list);
+	spin_unlock(&mptcp_sched_list_lock);
+
+	/* mptcp_set_sched_by_name() may still be looking at it */
+	synchronize_rcu();
+}
+EXPORT_SYMBOL_GPL(mptcp_unregister_scheduler);
+
+void mptcp_sched_init(void)
+{
+	mptcp_register_scheduler(&mptcp_sched_default);
+	mptcp_register_scheduler(&mptcp_sched_red);
+	mptcp_register_scheduler(&mptcp_sched_wrr);
+}
+
+/* the caller already holds a reference on @sched */
+static void __mptcp_init_sched(struct mptcp_sock *msk,
+			       struct mptcp_sched_ops *sched)
+{
+	msk->sched = sched;
+	if (sched->init)
+		sched->init(msk);
+
+	pr_debug("msk=%p sched=%s", msk, sched->name);
+}
+
+int mptcp_init_sched(struct mptcp_sock *msk,
+		     struct mptcp_sched_ops *sched)
+{
+	if (!sched)
+		sched = &mptcp_sched_default;
+
+	if (!try_module_get(sched->owner))
+		return -EBUSY;
+
+	__mptcp_init_sched(msk, sched);
+	return 0;
+}
+
+void mptcp_release_sched(struct mptcp_sock *msk)
+{
+	struct mptcp_sched_ops *sched = msk->sched;
+
+	if (!sched)
+		return;
+
+	msk->sched = NULL;
+	if (sched->release)
+		sched->release(msk);
+
+	module_put(sched->owner);
+}
+
+/* called with the msk socket lock held */
+int mptcp_set_sched_by_name(struct mptcp_sock *msk, const char *name)
+{
+	struct mptcp_sched_ops *sched;
+
+	rcu_read_lock();
+	sched = mptcp_sched_find(name);
+	if (sched && !try_module_get(sched->owner))
+		sched = NULL;
+	rcu_read_unlock();
+
+	if (!sched)
+		return -ENOENT;
+
+	mptcp_release_sched(msk);
+	mptcp_sched_clear(msk);
+	__mptcp_init_sched(msk, sched);
+	return 0;
+}
+
+void mptcp_subflow_set_scheduled(struct mptcp_subflow_context *subflow,
+				 bool scheduled)
+{
+	WRITE_ONCE(subflow->scheduled, scheduled);
+}
+
+void mptcp_sched_clear(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		mptcp_subflow_set_scheduled(subflow, false);
+		subflow->redundant = false;
+		subflow->redundant_seq = subflow->redundant_end;
+	}
+}
+
+static void mptcp_sched_data_init(struct mptcp_sock *msk,
+				  struct mptcp_sched_data *data)
+{
+	struct mptcp_subflow_context *subflow;
+	int i = 0;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		mptcp_subflow_set_scheduled(subflow, false);
+		subflow->redundant = false;
+		if (i == MPTCP_SUBFLOWS_MAX) {
+			pr_warn_once("too many subflows");
+			continue;
+		}
+		data->contexts[i++] = subflow;
+	}
+	data->subflows = i;
+
+	for (; i < MPTCP_SUBFLOWS_MAX; i++)
+		data->contexts[i] = NULL;
+}
+
+/* Returns the subflow the next chunk of data must be sent on. The
+ * scheduler may also have flagged other subflows as ->redundant, the
+ * caller then records the chunk it sent for them with
+ * mptcp_redundant_note().
+ */
+struct sock *mptcp_sched_get_send(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+	struct mptcp_sched_ops *sched;
+	struct mptcp_sched_data data;
+	struct sock *ssk = NULL;
+
+	msk_owned_by_me(msk);
+
+	/* the following check is moved out of mptcp_subflow_get_send */
+	if (__mptcp_check_fallback(msk)) {
+		if (!msk->first)
+			return NULL;
+		return __tcp_can_send(msk->first) &&
+		       sk_stream_memory_free(msk->first) ? msk->first : NULL;
+	}
+
+	sched = msk->sched ?: &mptcp_sched_default;
+	mptcp_sched_data_init(msk, &data);
+	if (sched->get_subflow(msk, &data))
+		return NULL;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		if (!READ_ONCE(subflow->scheduled))
+			continue;
+
+		mptcp_subflow_set_scheduled(subflow, false);
+		if (!ssk)
+			ssk = mptcp_subflow_tcp_sock(subflow);
+	}
+
+	/* the data itself goes out on one subflow only */
+	mptcp_for_each_subflow(msk, subflow)
+		if (subflow->redundant && mptcp_subflow_tcp_sock(subflow) == ssk)
+			subflow->redundant = false;
+
+	return ssk;
+}
@@ -820,6 +820,42 @@ static int mptcp_setsockopt_sol_tcp(struct mptcp_sock *msk, int optname,
 	return -EOPNOTSUPP;
 }
 
+static int mptcp_setsockopt_sol_mptcp_scheduler(struct mptcp_sock *msk,
+						sockptr_t optval,
+						unsigned int optlen)
+{
+	struct sock *sk = (struct sock *)msk;
+	char name[MPTCP_SCHED_NAME_MAX];
+	int ret;
+
+	if (optlen < 1)
+		return -EINVAL;
+
+	ret = strncpy_from_sockptr(name, optval,
+				   min_t(long, MPTCP_SCHED_NAME_MAX - 1, optlen));
+	if (ret < 0)
+		return -EFAULT;
+
+	name[ret] = 0;
+
+	lock_sock(sk);
+	ret = mptcp_set_sched_by_name(msk, name);
+	release_sock(sk);
+
+	return ret;
+}
+
+static int mptcp_setsockopt_sol_mptcp(struct mptcp_sock *msk, int optname,
+				      sockptr_t optval, unsigned int optlen)
+{
+	switch (optname) {
+	case MPTCP_SCHEDULER:
+		return mptcp_setsockopt_sol_mptcp_scheduler(msk, optval, optlen);
+	}
+
+	return -EOPNOTSUPP;
+}
+
 int mptcp_setsockopt(struct sock *sk, int level, int optname,
 		     sockptr_t optval, unsigned int optlen)
 {
@@ -831,6 +867,9 @@ int mptcp_setsockopt(struct sock *sk, int level, int optname,
 	if (level == SOL_SOCKET)
 		return mptcp_setsockopt_sol_socket(msk, optname, optval, optlen);
 
+	if (level == SOL_MPTCP)
+		return mptcp_setsockopt_sol_mptcp(msk, optname, optval, optlen);
+
 	if (!mptcp_supported_sockopt(level, optname))
 		return -ENOPROTOOPT;
 
@@ -1213,10 +1252,37 @@ static int mptcp_getsockopt_v4(struct mptcp_sock *msk, int optname,
 	return -EOPNOTSUPP;
 }
 
+static int mptcp_getsockopt_scheduler(struct mptcp_sock *msk,
+				      char __user *optval, int __user *optlen)
+{
+	struct sock *sk = (struct sock *)msk;
+	char name[MPTCP_SCHED_NAME_MAX] = {};
+	int len;
+
+	if (get_user(len, optlen))
+		return -EFAULT;
+
+	if (len < 0)
+		return -EINVAL;
+
+	lock_sock(sk);
+	if (msk->sched)
+		strscpy(name, msk->sched->name, sizeof(name));
+	release_sock(sk);
+
+	len = min_t(unsigned int, len, MPTCP_SCHED_NAME_MAX);
+	if (put_user(len, optlen) || copy_to_user(optval, name, len))
+		return -EFAULT;
+
+	return 0;
+}
+
 static int mptcp_getsockopt_sol_mptcp(struct mptcp_sock *msk, int optname,
 				      char __user *optval, int __user *optlen)
 {
 	switch (optname) {
+	case MPTCP_SCHEDULER:
+		return mptcp_getsockopt_scheduler(msk, optval, optlen);
 	case MPTCP_INFO:
 		return mptcp_getsockopt_info(msk, optval, optlen);
 	case MPTCP_TCPINFO:
@@ -241,59 +241,77 @@ void ovs_dp_detach_port(struct vport *p)
 	ovs_vport_del(p);
 }
 
+/* Send a packet that missed the flow table to userspace, consumes @skb. */
+static void ovs_dp_process_miss(struct datapath *dp, struct sk_buff *skb,
+				const struct sw_flow_key *key)
+{
+	const struct vport *p = OVS_CB(skb)->input_vport;
+	struct dp_upcall_info upcall;
+	int error;
+
+	memset(&upcall, 0, sizeof(upcall));
+	upcall.cmd = OVS_PACKET_CMD_MISS;
+
+	if (dp->user_features & OVS_DP_F_DISPATCH_UPCALL_PER_CPU)
+		upcall.portid =
+		    ovs_dp_get_upcall_portid(dp, smp_processor_id());
+	else
+		upcall.portid = ovs_vport_find_upcall_portid(p, skb);
+
+	upcall.mru = OVS_CB(skb)->mru;
+	error = ovs_dp_upcall(dp, skb, key, &upcall, 0);
+	switch (error) {
+	case 0:
+	case -EAGAIN:
+	case -ERESTARTSYS:
+	case -EINTR:
+		consume_skb(skb);
+		break;
+	default:
+		kfree_skb(skb);
+		break;
+	}
+}
+
+static void ovs_dp_execute(struct datapath *dp, struct sk_buff *skb,
+			   const struct sw_flow_actions *sf_acts,
+			   struct sw_flow_key *key)
+{
+	int error;
+
+	error = ovs_execute_actions(dp, skb, sf_acts, key);
+	if (unlikely(error))
+		net_dbg_ratelimited("ovs: action execution error on datapath %s: %d\n",
+				    ovs_dp_name(dp), error);
+}
+
 /* Must be called with rcu_read_lock. */
 void ovs_dp_process_packet(struct sk_buff *skb, struct sw_flow_key *key)
 {
 	const struct vport *p = OVS_CB(skb)->input_vport;
 	struct datapath *dp = p->dp;
 	struct sw_flow *flow;
-	struct sw_flow_actions *sf_acts;
 	struct dp_stats_percpu *stats;
 	u64 *stats_counter;
 	u32 n_mask_hit;
 	u32 n_cache_hit;
-	int error;
+	u32 n_emc_hit;
+	u32 n_emc_miss;
 
 	stats = this_cpu_ptr(dp->stats_percpu);
 
 	/* Look up flow. */
 	flow = ovs_flow_tbl_lookup_stats(&dp->table, key, skb_get_hash(skb),
-					 &n_mask_hit, &n_cache_hit);
+					 &n_mask_hit, &n_cache_hit,
+					 &n_emc_hit, &n_emc_miss);
 	if (unlikely(!flow)) {
-		struct dp_upcall_info upcall;
-
-		memset(&upcall, 0, sizeof(upcall));
-		upcall.cmd = OVS_PACKET_CMD_MISS;
-
-		if (dp->user_features & OVS_DP_F_DISPATCH_UPCALL_PER_CPU)
-			upcall.portid =
-			    ovs_dp_get_upcall_portid(dp, smp_processor_id());
-		else
-			upcall.portid = ovs_vport_find_upcall_portid(p, skb);
-
-		upcall.mru = OVS_CB(skb)->mru;
-		error = ovs_dp_upcall(dp, skb, key, &upcall, 0);
-		switch (error) {
-		case 0:
-		case -EAGAIN:
-		case -ERESTARTSYS:
-		case -EINTR:
-			consume_skb(skb);
-			break;
-		default:
-			kfree_skb(skb);
-			break;
-		}
+		ovs_dp_process_miss(dp, skb, key);
 		stats_counter = &stats->n_missed;
 		goto out;
 	}
 
 	ovs_flow_stats_update(flow, key->tp.flags, skb);
-	sf_acts = rcu_dereference(flow->sf_acts);
-	error = ovs_execute_actions(dp, skb, sf_acts, key);
-	if (unlikely(error))
-		net_dbg_ratelimited("ovs: action execution error on datapath %s: %d\n",
-				    ovs_dp_name(dp), error);
+	ovs_dp_execute(dp, skb, rcu_dereference(flow->sf_acts), key);
 
 	stats_counter = &stats->n_hit;
 
@@ -303,6 +321,94 @@ void ovs_dp_process_packet(struct sk_buff *skb, struct sw_flow_key *key)
 	(*stats_counter)++;
 	stats->n_mask_hit += n_mask_hit;
 	stats->n_cache_hit += n_cache_hit;
+	stats->n_emc_hit += n_emc_hit;
+	stats->n_emc_miss += n_emc_miss;
+	u64_stats_update_end(&stats->syncp);
+}
+
+/* Process up to OVS_RX_BATCH_SIZE packets received on the same datapath
+ * stage by stage rather than packet by packet: look up all the flows,
+ * send the misses to userspace, then execute the actions of each flow on
+ * all its packets in a row, in arrival order, with a single flow stats
+ * update.  Packets of different flows may be reordered.
+ *
+ * Must be called with rcu_read_lock and BH disabled.
+ */
+void ovs_dp_process_batch(struct datapath *dp, struct sk_buff **skbs,
+			  struct sw_flow_key *keys, int count)
+{
+	u32 n_mask_hit = 0, n_cache_hit = 0, n_emc_hit = 0, n_emc_miss = 0;
+	struct sw_flow *flows[OVS_RX_BATCH_SIZE];
+	u8 group[OVS_RX_BATCH_SIZE];
+	struct dp_stats_percpu *stats;
+	u32 n_hit = 0, n_missed = 0;
+	int i, j, n;
+
+	if (WARN_ON_ONCE(count > OVS_RX_BATCH_SIZE))
+		count = OVS_RX_BATCH_SIZE;
+
+	for (i = 0; i < count; i++) {
+		u32 mask_hit, cache_hit, emc_hit, emc_miss;
+
+		flows[i] = ovs_flow_tbl_lookup_stats(&dp->table, &keys[i],
+						     skb_get_hash(skbs[i]),
+						     &mask_hit, &cache_hit,
+						     &emc_hit, &emc_miss);
+		if (flows[i])
+			prefetch(rcu_dereference(flows[i]->sf_acts));
+
+		n_mask_hit += mask_hit;
+		n_cache_hit += cache_hit;
+		n_emc_hit += emc_hit;
+		n_emc_miss += emc_miss;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (likely(flows[i]))
+			continue;
+
+		ovs_dp_process_miss(dp, skbs[i], &keys[i]);
+		n_missed++;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct sw_flow *flow = flows[i];
+		const struct sw_flow_actions *sf_acts;
+		__be16 tcp_flags = 0;
+		u64 bytes = 0;
+
+		if (!flow)
+			continue;
+
+		/* Gather the packets of this flow and account them at once,
+		 * before the actions get a chance to consume them.
+		 */
+		for (j = i, n = 0; j < count; j++) {
+			if (flows[j] != flow)
+				continue;
+
+			flows[j] = NULL;
+			tcp_flags |= keys[j].tp.flags;
+			bytes += ovs_flow_stats_len(skbs[j]);
+			group[n++] = j;
+		}
+		ovs_flow_stats_add(flow, tcp_flags, n, bytes);
+		n_hit += n;
+
+		sf_acts = rcu_dereference(flow->sf_acts);
+		for (j = 0; j < n; j++)
+			ovs_dp_execute(dp, skbs[group[j]], sf_acts,
+				       &keys[group[j]]);
+	}
+
+	stats = this_cpu_ptr(dp->stats_percpu);
+	u64_stats_update_begin(&stats->syncp);
+	stats->n_hit += n_hit;
+	stats->n_missed += n_missed;
+	stats->n_mask_hit += n_mask_hit;
+	stats->n_cache_hit += n_cache_hit;
+	stats->n_emc_hit += n_emc_hit;
+	stats->n_emc_miss += n_emc_miss;
 	u64_stats_update_end(&stats->syncp);
 }
 
@@ -720,11 +826,13 @@ static struct genl_family dp_packet_genl_family __ro_after_init = {
 };
 
 static void get_dp_stats(const struct datapath *dp, struct ovs_dp_stats *stats,
-			 struct ovs_dp_megaflow_stats *mega_stats)
+			 struct ovs_dp_megaflow_stats *mega_stats,
+			 struct ovs_dp_emc_stats *emc_stats)
 {
 	int i;
 
 	memset(mega_stats, 0, sizeof(*mega_stats));
+	memset(emc_stats, 0, sizeof(*emc_stats));
 
 	stats->n_flows = ovs_flow_tbl_count(&dp->table);
 	mega_stats->n_masks = ovs_flow_tbl_num_masks(&dp->table);
@@ -748,6 +856,8 @@ static void get_dp_stats(const struct datapath *dp, struct ovs_dp_stats *stats,
 		stats->n_lost += local_stats.n_lost;
 		mega_stats->n_mask_hit += local_stats.n_mask_hit;
 		mega_stats->n_cache_hit += local_stats.n_cache_hit;
+		emc_stats->n_hit += local_stats.n_emc_hit;
+		emc_stats->n_missed += local_stats.n_emc_miss;
 	}
 }
 
@@ -1555,6 +1665,9 @@ static size_t ovs_dp_cmd_msg_size(void)
 	msgsize += nla_total_size_64bit(sizeof(struct ovs_dp_megaflow_stats));
 	msgsize += nla_total_size(sizeof(u32)); /* OVS_DP_ATTR_USER_FEATURES */
 	msgsize += nla_total_size(sizeof(u32)); /* OVS_DP_ATTR_MASKS_CACHE_SIZE */
+	msgsize += nla_total_size(sizeof(u32)); /* OVS_DP_ATTR_EMC_SIZE */
+	msgsize += nla_total_size(sizeof(u32)); /* OVS_DP_ATTR_EMC_INSERT_INV_PROB */
+	msgsize += nla_total_size_64bit(sizeof(struct ovs_dp_emc_stats));
 	msgsize += nla_total_size(sizeof(u32) * nr_cpu_ids); /* OVS_DP_ATTR_PER_CPU_PIDS */
 
 	return msgsize;
@@ -1567,6 +1680,7 @@ static int ovs_dp_cmd_fill_info(struct datapath *dp, struct sk_buff *skb,
 	struct ovs_header *ovs_header;
 	struct ovs_dp_stats dp_stats;
 	struct ovs_dp_megaflow_stats dp_megaflow_stats;
+	struct ovs_dp_emc_stats dp_emc_stats;
 	struct dp_nlsk_pids *pids = ovsl_dereference(dp->upcall_portids);
 	int err, pids_len;
 
@@ -1581,7 +1695,7 @@ static int ovs_dp_cmd_fill_info(struct datapath *dp, struct sk_buff *skb,
 	if (err)
 		goto nla_put_failure;
 
-	get_dp_stats(dp, &dp_stats, &dp_megaflow_stats);
+	get_dp_stats(dp, &dp_stats, &dp_megaflow_stats, &dp_emc_stats);
 	if (nla_put_64bit(skb, OVS_DP_ATTR_STATS, sizeof(struct ovs_dp_stats),
 			  &dp_stats, OVS_DP_ATTR_PAD))
 		goto nla_put_failure;
@@ -1598,6 +1712,17 @@ static int ovs_dp_cmd_fill_info(struct datapath *dp, struct sk_buff *skb,
 			ovs_flow_tbl_masks_cache_size(&dp->table)))
 		goto nla_put_failure;
 
+	if (nla_put_u32(skb, OVS_DP_ATTR_EMC_SIZE,
+			ovs_flow_tbl_emc_size(&dp->table)) ||
+	    nla_put_u32(skb, OVS_DP_ATTR_EMC_INSERT_INV_PROB,
+			ovs_flow_tbl_emc_insert_inv_prob(&dp->table)))
+		goto nla_put_failure;
+
+	if (nla_put_64bit(skb, OVS_DP_ATTR_EMC_STATS,
+			  sizeof(struct ovs_dp_emc_stats),
+			  &dp_emc_stats, OVS_DP_ATTR_PAD))
+		goto nla_put_failure;
+
 	if (dp->user_features & OVS_DP_F_DISPATCH_UPCALL_PER_CPU && pids) {
 		pids_len = min(pids->n_pids, nr_cpu_ids) * sizeof(u32);
 		if (nla_put(skb, OVS_DP_ATTR_PER_CPU_PIDS, pids_len, &pids->pids))
@@ -1733,6 +1858,17 @@ static int ovs_dp_change(struct datapath *dp, struct nlattr *a[])
 			return err;
 	}
 
+	if (a[OVS_DP_ATTR_EMC_SIZE]) {
+		err = ovs_flow_tbl_emc_resize(&dp->table,
+					      nla_get_u32(a[OVS_DP_ATTR_EMC_SIZE]));
+		if (err)
+			return err;
+	}
+
+	if (a[OVS_DP_ATTR_EMC_INSERT_INV_PROB])
+		ovs_flow_tbl_emc_set_insert_inv_prob(&dp->table,
+			nla_get_u32(a[OVS_DP_ATTR_EMC_INSERT_INV_PROB]));
+
 	dp->user_features = user_features;
 
 	if (dp->user_features & OVS_DP_F_DISPATCH_UPCALL_PER_CPU &&
@@ -2050,6 +2186,9 @@ static const struct nla_policy datapath_policy[OVS_DP_ATTR_MAX + 1] = {
 	[OVS_DP_ATTR_MASKS_CACHE_SIZE] =  NLA_POLICY_RANGE(NLA_U32, 0,
 		PCPU_MIN_UNIT_SIZE / sizeof(struct mask_cache_entry)),
 	[OVS_DP_ATTR_IFINDEX] = NLA_POLICY_MIN(NLA_S32, 0),
+	[OVS_DP_ATTR_EMC_SIZE] = NLA_POLICY_RANGE(NLA_U32, 0,
+		PCPU_MIN_UNIT_SIZE / sizeof(struct emc_entry)),
+	[OVS_DP_ATTR_EMC_INSERT_INV_PROB] = NLA_POLICY_MIN(NLA_U32, 1),
 };
 
 static const struct genl_small_ops dp_datapath_genl_ops[] = {
@@ -40,6 +40,10 @@
  *   up per packet.
  * @n_cache_hit: The number of received packets that had their mask found using
  * the mask cache.
+ * @n_emc_hit: The number of received packets that had their flow found in the
+ * exact match cache.
+ * @n_emc_miss: The number of received packets that were looked up in the exact
+ * match cache without finding their flow there.
  */
 struct dp_stats_percpu {
 	u64 n_hit;
@@ -47,6 +51,8 @@ struct dp_stats_percpu {
 	u64 n_lost;
 	u64 n_mask_hit;
 	u64 n_cache_hit;
+	u64 n_emc_hit;
+	u64 n_emc_miss;
 	struct u64_stats_sync syncp;
 };
 
@@ -253,7 +259,12 @@ static inline struct datapath *get_dp(struct net *net, int dp_ifindex)
 extern struct notifier_block ovs_dp_device_notifier;
 extern struct genl_family dp_vport_genl_family;
 
+/* Maximum number of packets handled together by ovs_dp_process_batch(). */
+#define OVS_RX_BATCH_SIZE	16
+
 void ovs_dp_process_packet(struct sk_buff *skb, struct sw_flow_key *key);
+void ovs_dp_process_batch(struct datapath *dp, struct sk_buff **skbs,
+			  struct sw_flow_key *keys, int count);
 void ovs_dp_detach_port(struct vport *);
 int ovs_dp_upcall(struct datapath *, struct sk_buff *,
 		  const struct sw_flow_key *, const struct dp_upcall_info *,
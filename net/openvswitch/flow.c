@@ -58,12 +58,12 @@ u64 ovs_flow_used_time(unsigned long flow_jiffies)
 
 #define TCP_FLAGS_BE16(tp) (*(__be16 *)&tcp_flag_word(tp) & htons(0x0FFF))
 
-void ovs_flow_stats_update(struct sw_flow *flow, __be16 tcp_flags,
-			   const struct sk_buff *skb)
+/* Account @packets packets, @bytes bytes in total, to @flow. */
+void ovs_flow_stats_add(struct sw_flow *flow, __be16 tcp_flags,
+			u32 packets, u64 bytes)
 {
 	struct sw_flow_stats *stats;
 	unsigned int cpu = smp_processor_id();
-	int len = skb->len + (skb_vlan_tag_present(skb) ? VLAN_HLEN : 0);
 
 	stats = rcu_dereference(flow->stats[cpu]);
 
@@ -100,8 +100,8 @@ void ovs_flow_stats_update(struct sw_flow *flow, __be16 tcp_flags,
 							      numa_node_id());
 				if (likely(new_stats)) {
 					new_stats->used = jiffies;
-					new_stats->packet_count = 1;
-					new_stats->byte_count = len;
+					new_stats->packet_count = packets;
+					new_stats->byte_count = bytes;
 					new_stats->tcp_flags = tcp_flags;
 					spin_lock_init(&new_stats->lock);
 
@@ -117,13 +117,19 @@ void ovs_flow_stats_update(struct sw_flow *flow, __be16 tcp_flags,
 	}
 
 	stats->used = jiffies;
-	stats->packet_count++;
-	stats->byte_count += len;
+	stats->packet_count += packets;
+	stats->byte_count += bytes;
 	stats->tcp_flags |= tcp_flags;
 unlock:
 	spin_unlock(&stats->lock);
 }
 
+void ovs_flow_stats_update(struct sw_flow *flow, __be16 tcp_flags,
+			   const struct sk_buff *skb)
+{
+	ovs_flow_stats_add(flow, tcp_flags, 1, ovs_flow_stats_len(skb));
+}
+
 /* Must be called with rcu_read_lock or ovs_mutex. */
 void ovs_flow_stats_get(const struct sw_flow *flow,
 			struct ovs_flow_stats *ovs_stats,
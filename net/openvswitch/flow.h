@@ -278,6 +278,14 @@ static inline bool ovs_identifier_is_key(const struct sw_flow_id *sfid)
 	return !ovs_identifier_is_ufid(sfid);
 }
 
+/* Bytes accounted to a flow for @skb. */
+static inline unsigned int ovs_flow_stats_len(const struct sk_buff *skb)
+{
+	return skb->len + (skb_vlan_tag_present(skb) ? VLAN_HLEN : 0);
+}
+
+void ovs_flow_stats_add(struct sw_flow *, __be16 tcp_flags,
+			u32 packets, u64 bytes);
 void ovs_flow_stats_update(struct sw_flow *, __be16 tcp_flags,
 			   const struct sk_buff *);
 void ovs_flow_stats_get(const struct sw_flow *, struct ovs_flow_stats *,
@@ -42,6 +42,9 @@
 #define MC_HASH_SHIFT		8
 #define MC_HASH_SEGS		((sizeof(uint32_t) * 8) / MC_HASH_SHIFT)
 
+#define EMC_DEFAULT_ENTRIES		256
+#define EMC_DEFAULT_INSERT_INV_PROB	100
+
 static struct kmem_cache *flow_cache;
 struct kmem_cache *flow_stats_cache __read_mostly;
 
@@ -411,9 +414,95 @@ int ovs_flow_tbl_masks_cache_resize(struct flow_table *table, u32 size)
 	return 0;
 }
 
+static void __emc_cache_destroy(struct emc_cache *emc)
+{
+	free_percpu(emc->emc_cache);
+	kfree(emc);
+}
+
+static void emc_cache_rcu_cb(struct rcu_head *rcu)
+{
+	struct emc_cache *emc = container_of(rcu, struct emc_cache, rcu);
+
+	__emc_cache_destroy(emc);
+}
+
+static bool tbl_emc_size_valid(u32 size)
+{
+	return (is_power_of_2(size) || size == 0) &&
+	       (size * sizeof(struct emc_entry)) <= PCPU_MIN_UNIT_SIZE;
+}
+
+static struct emc_cache *tbl_emc_alloc(u32 size)
+{
+	struct emc_entry __percpu *cache = NULL;
+	struct emc_cache *new;
+
+	if (!tbl_emc_size_valid(size))
+		return NULL;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return NULL;
+
+	new->cache_size = size;
+	if (new->cache_size > 0) {
+		cache = __alloc_percpu(array_size(sizeof(struct emc_entry),
+						  new->cache_size),
+				       __alignof__(struct emc_entry));
+		if (!cache) {
+			kfree(new);
+			return NULL;
+		}
+	}
+
+	new->emc_cache = cache;
+	return new;
+}
+
+int ovs_flow_tbl_emc_resize(struct flow_table *table, u32 size)
+{
+	struct emc_cache *emc = rcu_dereference_ovsl(table->emc_cache);
+	struct emc_cache *new;
+
+	if (size == emc->cache_size)
+		return 0;
+
+	if (!tbl_emc_size_valid(size))
+		return -EINVAL;
+
+	new = tbl_emc_alloc(size);
+	if (!new)
+		return -ENOMEM;
+
+	rcu_assign_pointer(table->emc_cache, new);
+	call_rcu(&emc->rcu, emc_cache_rcu_cb);
+
+	return 0;
+}
+
+u32 ovs_flow_tbl_emc_size(const struct flow_table *table)
+{
+	struct emc_cache *emc = rcu_dereference_ovsl(table->emc_cache);
+
+	return READ_ONCE(emc->cache_size);
+}
+
+u32 ovs_flow_tbl_emc_insert_inv_prob(const struct flow_table *table)
+{
+	return READ_ONCE(table->emc_insert_inv_prob);
+}
+
+/* Must be called with OVS mutex held. */
+void ovs_flow_tbl_emc_set_insert_inv_prob(struct flow_table *table, u32 prob)
+{
+	WRITE_ONCE(table->emc_insert_inv_prob, max_t(u32, prob, 1));
+}
+
 int ovs_flow_tbl_init(struct flow_table *table)
 {
 	struct table_instance *ti, *ufid_ti;
+	struct emc_cache *emc;
 	struct mask_cache *mc;
 	struct mask_array *ma;
 
@@ -421,9 +510,13 @@ int ovs_flow_tbl_init(struct flow_table *table)
 	if (!mc)
 		return -ENOMEM;
 
+	emc = tbl_emc_alloc(EMC_DEFAULT_ENTRIES);
+	if (!emc)
+		goto free_mask_cache;
+
 	ma = tbl_mask_array_alloc(MASK_ARRAY_SIZE_MIN);
 	if (!ma)
-		goto free_mask_cache;
+		goto free_emc;
 
 	ti = table_instance_alloc(TBL_MIN_BUCKETS);
 	if (!ti)
@@ -437,6 +530,9 @@ int ovs_flow_tbl_init(struct flow_table *table)
 	rcu_assign_pointer(table->ufid_ti, ufid_ti);
 	rcu_assign_pointer(table->mask_array, ma);
 	rcu_assign_pointer(table->mask_cache, mc);
+	rcu_assign_pointer(table->emc_cache, emc);
+	table->emc_gen = 0;
+	table->emc_insert_inv_prob = EMC_DEFAULT_INSERT_INV_PROB;
 	table->last_rehash = jiffies;
 	table->count = 0;
 	table->ufid_count = 0;
@@ -446,6 +542,8 @@ int ovs_flow_tbl_init(struct flow_table *table)
 	__table_instance_destroy(ti);
 free_mask_array:
 	__mask_array_destroy(ma);
+free_emc:
+	__emc_cache_destroy(emc);
 free_mask_cache:
 	__mask_cache_destroy(mc);
 	return -ENOMEM;
@@ -472,6 +570,11 @@ static void table_instance_flow_free(struct flow_table *table,
 		table->ufid_count--;
 	}
 
+	/* Invalidate all the exact match cache entries: readers that see
+	 * the new generation also see the flow unlinked above.
+	 */
+	smp_store_release(&table->emc_gen, table->emc_gen + 1);
+
 	flow_mask_remove(table, flow->mask);
 }
 
@@ -519,8 +622,10 @@ void ovs_flow_tbl_destroy(struct flow_table *table)
 	struct table_instance *ufid_ti = rcu_dereference_raw(table->ufid_ti);
 	struct mask_cache *mc = rcu_dereference_raw(table->mask_cache);
 	struct mask_array *ma = rcu_dereference_raw(table->mask_array);
+	struct emc_cache *emc = rcu_dereference_raw(table->emc_cache);
 
 	call_rcu(&mc->rcu, mask_cache_rcu_cb);
+	call_rcu(&emc->rcu, emc_cache_rcu_cb);
 	call_rcu(&ma->rcu, mask_array_rcu_cb);
 	table_instance_destroy(ti, ufid_ti);
 }
@@ -783,11 +888,11 @@ static struct sw_flow *flow_lookup(struct flow_table *tbl,
  * This is per cpu cache and is divided in MC_HASH_SEGS segments.
  * In case of a hash collision the entry is hashed in next segment.
  * */
-struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
-					  const struct sw_flow_key *key,
-					  u32 skb_hash,
-					  u32 *n_mask_hit,
-					  u32 *n_cache_hit)
+static struct sw_flow *flow_lookup_mask_cache(struct flow_table *tbl,
+					      const struct sw_flow_key *key,
+					      u32 skb_hash,
+					      u32 *n_mask_hit,
+					      u32 *n_cache_hit)
 {
 	struct mask_cache *mc = rcu_dereference(tbl->mask_cache);
 	struct mask_array *ma = rcu_dereference(tbl->mask_array);
@@ -797,8 +902,6 @@ struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
 	u32 hash;
 	int seg;
 
-	*n_mask_hit = 0;
-	*n_cache_hit = 0;
 	if (unlikely(!skb_hash || mc->cache_size == 0)) {
 		u32 mask_index = 0;
 		u32 cache = 0;
@@ -807,12 +910,6 @@ struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
 				   &mask_index);
 	}
 
-	/* Pre and post recirulation flows usually have the same skb_hash
-	 * value. To avoid hash collisions, rehash the 'skb_hash' with
-	 * 'recirc_id'.  */
-	if (key->recirc_id)
-		skb_hash = jhash_1word(skb_hash, key->recirc_id);
-
 	ce = NULL;
 	hash = skb_hash;
 	entries = this_cpu_ptr(mc->mask_cache);
@@ -847,6 +944,78 @@ struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
 	return flow;
 }
 
+/* The exact match cache entry is only trusted after checking the packet
+ * key against the cached flow, under the flow's own mask: this costs a
+ * single masked compare instead of a hash and bucket walk per mask.
+ */
+static bool emc_flow_match(const struct sw_flow *flow,
+			   const struct sw_flow_key *key)
+{
+	const struct sw_flow_mask *mask = flow->mask;
+	struct sw_flow_key masked_key;
+
+	ovs_flow_mask_key(&masked_key, key, false, mask);
+	return flow_cmp_masked_key(flow, &masked_key, &mask->range);
+}
+
+/* Flow lookup for the packet processing path, must be called with BH
+ * disabled.  The per CPU exact match cache is consulted first; on a miss
+ * the flow is looked up through the mask cache and then, with probability
+ * 1 / emc_insert_inv_prob, installed in the exact match cache so that
+ * only long lived flows end up competing for its entries.
+ */
+struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
+					  const struct sw_flow_key *key,
+					  u32 skb_hash,
+					  u32 *n_mask_hit,
+					  u32 *n_cache_hit,
+					  u32 *n_emc_hit,
+					  u32 *n_emc_miss)
+{
+	struct emc_cache *emc = rcu_dereference(tbl->emc_cache);
+	struct emc_entry *e = NULL;
+	unsigned long gen = 0;
+	struct sw_flow *flow;
+	u32 inv_prob;
+
+	*n_mask_hit = 0;
+	*n_cache_hit = 0;
+	*n_emc_hit = 0;
+	*n_emc_miss = 0;
+
+	/* Pre and post recirulation flows usually have the same skb_hash
+	 * value. To avoid hash collisions, rehash the 'skb_hash' with
+	 * 'recirc_id'.  */
+	if (skb_hash && key->recirc_id)
+		skb_hash = jhash_1word(skb_hash, key->recirc_id);
+
+	if (likely(skb_hash && emc->cache_size)) {
+		/* Pairs with smp_store_release() in table_instance_flow_free() */
+		gen = smp_load_acquire(&tbl->emc_gen);
+		e = this_cpu_ptr(emc->emc_cache);
+		e += skb_hash & (emc->cache_size - 1);
+		if (e->skb_hash == skb_hash && e->gen == gen &&
+		    emc_flow_match(e->flow, key)) {
+			*n_emc_hit = 1;
+			return e->flow;
+		}
+		*n_emc_miss = 1;
+	}
+
+	flow = flow_lookup_mask_cache(tbl, key, skb_hash, n_mask_hit,
+				      n_cache_hit);
+	if (flow && e) {
+		inv_prob = READ_ONCE(tbl->emc_insert_inv_prob);
+		if (inv_prob <= 1 || !get_random_u32_below(inv_prob)) {
+			e->flow = flow;
+			e->gen = gen;
+			e->skb_hash = skb_hash;
+		}
+	}
+
+	return flow;
+}
+
 struct sw_flow *ovs_flow_tbl_lookup(struct flow_table *tbl,
 				    const struct sw_flow_key *key)
 {
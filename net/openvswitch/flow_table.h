@@ -33,6 +33,23 @@ struct mask_cache {
 	struct mask_cache_entry __percpu *mask_cache;
 };
 
+/* Exact match cache: per CPU, direct mapped by skb hash, caches the flow a
+ * given packet key resolved to.  An entry is only valid while its 'gen'
+ * matches the flow table 'emc_gen', which is bumped on every flow removal,
+ * so a stale entry never references a flow that may have been freed.
+ */
+struct emc_entry {
+	struct sw_flow *flow;
+	unsigned long gen;
+	u32 skb_hash;
+};
+
+struct emc_cache {
+	struct rcu_head rcu;
+	u32 cache_size;  /* Must be ^2 value. */
+	struct emc_entry __percpu *emc_cache;
+};
+
 struct mask_count {
 	int index;
 	u64 counter;
@@ -64,6 +81,9 @@ struct flow_table {
 	struct table_instance __rcu *ufid_ti;
 	struct mask_cache __rcu *mask_cache;
 	struct mask_array __rcu *mask_array;
+	struct emc_cache __rcu *emc_cache;
+	unsigned long emc_gen;
+	u32 emc_insert_inv_prob;
 	unsigned long last_rehash;
 	unsigned int count;
 	unsigned int ufid_count;
@@ -88,13 +108,19 @@ void ovs_flow_tbl_remove(struct flow_table *table, struct sw_flow *flow);
 int  ovs_flow_tbl_num_masks(const struct flow_table *table);
 u32  ovs_flow_tbl_masks_cache_size(const struct flow_table *table);
 int  ovs_flow_tbl_masks_cache_resize(struct flow_table *table, u32 size);
+u32  ovs_flow_tbl_emc_size(const struct flow_table *table);
+int  ovs_flow_tbl_emc_resize(struct flow_table *table, u32 size);
+u32  ovs_flow_tbl_emc_insert_inv_prob(const struct flow_table *table);
+void ovs_flow_tbl_emc_set_insert_inv_prob(struct flow_table *table, u32 prob);
 struct sw_flow *ovs_flow_tbl_dump_next(struct table_instance *table,
 				       u32 *bucket, u32 *idx);
 struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *,
 					  const struct sw_flow_key *,
 					  u32 skb_hash,
 					  u32 *n_mask_hit,
-					  u32 *n_cache_hit);
+					  u32 *n_cache_hit,
+					  u32 *n_emc_hit,
+					  u32 *n_emc_miss);
 struct sw_flow *ovs_flow_tbl_lookup(struct flow_table *,
 				    const struct sw_flow_key *);
 struct sw_flow *ovs_flow_tbl_lookup_exact(struct flow_table *tbl,
@@ -14,6 +14,7 @@
 #include <linux/skbuff.h>
 #include <linux/openvswitch.h>
 #include <linux/export.h>
+#include <linux/netdevice.h>
 
 #include <net/ip_tunnels.h>
 #include <net/rtnetlink.h>
@@ -25,9 +26,89 @@
 
 static struct vport_ops ovs_netdev_vport_ops;
 
-/* Must be called with rcu_read_lock. */
+/* The rx_handler is called one packet at a time.  Packets are queued per
+ * CPU instead and run through the datapath with ovs_vport_receive_list(),
+ * as soon as a full batch is queued or else from a NAPI instance of our
+ * own.  It is scheduled on the CPU that queued the packets and polled by
+ * net_rx_action() once the device polls already listed are done, so the
+ * batch is flushed by the NET_RX softirq without a hop to another softirq.
+ * Every packet of a CPU goes through its queue, in order.
+ */
+struct netdev_port_rxq {
+	struct sk_buff_head skbs;
+	struct napi_struct napi;
+};
+
+static DEFINE_PER_CPU(struct netdev_port_rxq, netdev_port_rxq);
+
+/* The NAPI instances need a device, they are not tied to any real one. */
+static struct net_device netdev_rx_dummy_dev;
+
+/* Called with BH disabled.  Each queued skb holds a reference on its dev.
+ * Returns the number of packets flushed.
+ */
+static int netdev_rx_flush(struct netdev_port_rxq *rxq)
+{
+	struct net_device *dev = NULL;
+	struct vport *vport = NULL;
+	struct sk_buff_head queue;
+	struct sk_buff *skb;
+	LIST_HEAD(batch);
+	int n = 0, done;
+
+	/* the datapath may queue more packets on this CPU */
+	__skb_queue_head_init(&queue);
+	skb_queue_splice_init(&rxq->skbs, &queue);
+	done = skb_queue_len(&queue);
+
+	rcu_read_lock();
+	while (true) {
+		skb = __skb_dequeue(&queue);
+		if (n && (!skb || skb->dev != dev)) {
+			if (vport)
+				ovs_vport_receive_list(vport, &batch);
+			while (n--)
+				dev_put(dev);
+			n = 0;
+		}
+		if (!skb)
+			break;
+
+		if (!n) {
+			dev = skb->dev;
+			vport = ovs_netdev_get_vport(dev);
+		}
+		n++;
+
+		if (likely(vport))
+			list_add_tail(&skb->list, &batch);
+		else
+			kfree_skb(skb);
+	}
+	rcu_read_unlock();
+
+	return done;
+}
+
+static int netdev_rx_poll(struct napi_struct *napi, int budget)
+{
+	struct netdev_port_rxq *rxq;
+	int done;
+
+	rxq = container_of(napi, struct netdev_port_rxq, napi);
+	done = netdev_rx_flush(rxq);
+	if (done >= budget)
+		return budget;
+
+	/* reschedules itself if more packets were queued meanwhile */
+	napi_complete_done(napi, done);
+	return done;
+}
+
+/* Must be called with rcu_read_lock and BH disabled. */
 static void netdev_port_receive(struct sk_buff *skb)
 {
+	struct netdev_port_rxq *rxq;
 	struct vport *vport;
 
 	vport = ovs_netdev_get_vport(skb->dev);
@@ -47,7 +128,16 @@ static void netdev_port_receive(struct sk_buff *skb)
 	if (skb->dev->type == ARPHRD_ETHER)
 		skb_push_rcsum(skb, ETH_HLEN);
 
-	ovs_vport_receive(vport, skb, skb_tunnel_info(skb));
+	/* the packet outlives this RCU section and the rx_handler */
+	skb_dst_force(skb);
+	dev_hold(skb->dev);
+
+	rxq = this_cpu_ptr(&netdev_port_rxq);
+	__skb_queue_tail(&rxq->skbs, skb);
+	if (skb_queue_len(&rxq->skbs) >= OVS_RX_BATCH_SIZE)
+		netdev_rx_flush(rxq);
+	else
+		napi_schedule(&rxq->napi);
 	return;
 error:
 	kfree_skb(skb);
@@ -198,12 +288,43 @@ static struct vport_ops ovs_netdev_vport_ops = {
 	.send		= dev_queue_xmit,
 };
 
+static void netdev_rx_napi_del(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct netdev_port_rxq *rxq = per_cpu_ptr(&netdev_port_rxq, cpu);
+
+		napi_disable(&rxq->napi);
+		netif_napi_del(&rxq->napi);
+	}
+}
+
 int __init ovs_netdev_init(void)
 {
-	return ovs_vport_ops_register(&ovs_netdev_vport_ops);
+	int cpu, err;
+
+	init_dummy_netdev(&netdev_rx_dummy_dev);
+
+	for_each_possible_cpu(cpu) {
+		struct netdev_port_rxq *rxq = per_cpu_ptr(&netdev_port_rxq, cpu);
+
+		__skb_queue_head_init(&rxq->skbs);
+		netif_napi_add(&netdev_rx_dummy_dev, &rxq->napi, netdev_rx_poll);
+		napi_enable(&rxq->napi);
+	}
+
+	err = ovs_vport_ops_register(&ovs_netdev_vport_ops);
+	if (err)
+		netdev_rx_napi_del();
+
+	return err;
 }
 
 void ovs_netdev_exit(void)
 {
 	ovs_vport_ops_unregister(&ovs_netdev_vport_ops);
+
+	/* no netdev vport is left, the queues are drained by their NAPI */
+	netdev_rx_napi_del();
 }
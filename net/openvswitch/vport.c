@@ -481,6 +481,26 @@ u32 ovs_vport_find_upcall_portid(const struct vport *vport,
 	return ids->ids[ids_index];
 }
 
+static int ovs_vport_rx_key_extract(struct vport *vport, struct sk_buff *skb,
+				    const struct ip_tunnel_info *tun_info,
+				    struct sw_flow_key *key)
+{
+	OVS_CB(skb)->input_vport = vport;
+	OVS_CB(skb)->mru = 0;
+	OVS_CB(skb)->cutlen = 0;
+	if (unlikely(dev_net(skb->dev) != ovs_dp_get_net(vport->dp))) {
+		u32 mark;
+
+		mark = skb->mark;
+		skb_scrub_packet(skb, true);
+		skb->mark = mark;
+		tun_info = NULL;
+	}
+
+	/* Extract flow from 'skb' into 'key'. */
+	return ovs_flow_key_extract(tun_info, skb, key);
+}
+
 /**
  *	ovs_vport_receive - pass up received packet to the datapath for processing
  *
@@ -497,20 +517,7 @@ int ovs_vport_receive(struct vport *vport, struct sk_buff *skb,
 	struct sw_flow_key key;
 	int error;
 
-	OVS_CB(skb)->input_vport = vport;
-	OVS_CB(skb)->mru = 0;
-	OVS_CB(skb)->cutlen = 0;
-	if (unlikely(dev_net(skb->dev) != ovs_dp_get_net(vport->dp))) {
-		u32 mark;
-
-		mark = skb->mark;
-		skb_scrub_packet(skb, true);
-		skb->mark = mark;
-		tun_info = NULL;
-	}
-
-	/* Extract flow from 'skb' into 'key'. */
-	error = ovs_flow_key_extract(tun_info, skb, &key);
+	error = ovs_vport_rx_key_extract(vport, skb, tun_info, &key);
 	if (unlikely(error)) {
 		kfree_skb(skb);
 		return error;
@@ -519,6 +526,67 @@ int ovs_vport_receive(struct vport *vport, struct sk_buff *skb,
 	return 0;
 }
 
+struct ovs_rx_batch {
+	bool busy;
+	struct sk_buff *skbs[OVS_RX_BATCH_SIZE];
+	struct sw_flow_key keys[OVS_RX_BATCH_SIZE];
+};
+
+static DEFINE_PER_CPU(struct ovs_rx_batch, ovs_rx_batch);
+
+/**
+ *	ovs_vport_receive_list - pass up a list of received packets to the
+ *	datapath for processing
+ *
+ * @vport: vport that received the packets
+ * @head: list of received skbs, emptied on return
+ *
+ * The keys of up to %OVS_RX_BATCH_SIZE packets are extracted in a row and
+ * the packets are then handed to ovs_dp_process_batch().  The tunnel
+ * metadata of each packet, if any, is taken from its dst.
+ *
+ * Must be called with rcu_read_lock and BH disabled, with the same
+ * constraints on the packets as ovs_vport_receive().
+ */
+void ovs_vport_receive_list(struct vport *vport, struct list_head *head)
+{
+	struct ovs_rx_batch *batch = this_cpu_ptr(&ovs_rx_batch);
+	struct sk_buff *skb, *next;
+	int count = 0;
+
+	/* The per-cpu batch is already in use further up the stack. */
+	if (unlikely(batch->busy)) {
+		list_for_each_entry_safe(skb, next, head, list) {
+			skb_list_del_init(skb);
+			ovs_vport_receive(vport, skb, skb_tunnel_info(skb));
+		}
+		return;
+	}
+
+	batch->busy = true;
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+		if (unlikely(ovs_vport_rx_key_extract(vport, skb,
+						      skb_tunnel_info(skb),
+						      &batch->keys[count]))) {
+			kfree_skb(skb);
+			continue;
+		}
+
+		batch->skbs[count++] = skb;
+		if (count == OVS_RX_BATCH_SIZE) {
+			ovs_dp_process_batch(vport->dp, batch->skbs,
+					     batch->keys, count);
+			count = 0;
+		}
+	}
+
+	if (count)
+		ovs_dp_process_batch(vport->dp, batch->skbs, batch->keys,
+				     count);
+	batch->busy = false;
+}
+
 static int packet_length(const struct sk_buff *skb,
 			 struct net_device *dev)
 {
@@ -190,6 +190,7 @@ static inline struct vport *vport_from_priv(void *priv)
 
 int ovs_vport_receive(struct vport *, struct sk_buff *,
 		      const struct ip_tunnel_info *);
+void ovs_vport_receive_list(struct vport *, struct list_head *);
 
 static inline const char *ovs_vport_name(struct vport *vport)
 {
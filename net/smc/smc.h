@@ -220,6 +220,15 @@ struct smc_connection {
 	atomic_t		bytes_to_rcv;	/* arrived data,
 						 * not yet received
 						 */
+	int			rmbe_peak;	/* max. bytes_to_rcv seen,
+						 * drives lgr rmb_size_hint
+						 */
+	struct list_head	rx_batch_list;	/* on per-cpu list of conns
+						 * with deferred CDC wakeups
+						 */
+	bool			rx_batch_queued;
+	bool			rx_batch_wake;	/* deferred sk_data_ready */
+	bool			rx_batch_tx;	/* deferred smc_tx_pending */
 	atomic_t		splice_pending;	/* number of spliced bytes
 						 * pending processing
 						 */
@@ -18,6 +18,7 @@
 #include "smc_tx.h"
 #include "smc_rx.h"
 #include "smc_close.h"
+#include "smc_stats.h"
 
 /********************************** send *************************************/
 
@@ -319,13 +320,39 @@ static void smc_cdc_msg_validate(struct smc_sock *smc, struct smc_cdc_msg *cdc,
 	}
 }
 
+/* Connections with wakeups deferred until the end of the current batch of
+ * CDC messages polled from the receive completion queue. Only used from the
+ * SMC-R receive tasklet, so a per-cpu list needs no further locking.
+ */
+static DEFINE_PER_CPU(struct list_head, smc_cdc_rx_batch);
+
+static void smc_cdc_data_ready(struct smc_sock *smc, bool batch)
+{
+	if (batch)
+		smc->conn.rx_batch_wake = true;
+	else
+		smc->sk.sk_data_ready(&smc->sk);
+}
+
+static void smc_cdc_tx_pending(struct smc_sock *smc, bool batch)
+{
+	if (batch)
+		smc->conn.rx_batch_tx = true;
+	else if (!sock_owned_by_user(&smc->sk))
+		smc_tx_pending(&smc->conn);
+	else
+		smc->conn.tx_in_release_sock = true;
+}
+
 static void smc_cdc_msg_recv_action(struct smc_sock *smc,
-				    struct smc_cdc_msg *cdc)
+				    struct smc_cdc_msg *cdc, bool batch)
 {
 	union smc_host_cursor cons_old, prod_old;
 	struct smc_connection *conn = &smc->conn;
 	int diff_cons, diff_prod;
 
+	SMC_STAT_INC(smc, cdc_rx_cnt);
+
 	smc_curs_copy(&prod_old, &conn->local_rx_ctrl.prod, conn);
 	smc_curs_copy(&cons_old, &conn->local_rx_ctrl.cons, conn);
 	smc_cdc_msg_to_host(&conn->local_rx_ctrl, cdc, conn);
@@ -352,10 +379,12 @@ static void smc_cdc_msg_recv_action(struct smc_sock *smc,
 		atomic_add(diff_prod, &conn->bytes_to_rcv);
 		/* guarantee 0 <= bytes_to_rcv <= rmb_desc->len */
 		smp_mb__after_atomic();
-		smc->sk.sk_data_ready(&smc->sk);
+		conn->rmbe_peak = max(conn->rmbe_peak,
+				      atomic_read(&conn->bytes_to_rcv));
+		smc_cdc_data_ready(smc, batch);
 	} else {
 		if (conn->local_rx_ctrl.prod_flags.write_blocked)
-			smc->sk.sk_data_ready(&smc->sk);
+			smc_cdc_data_ready(smc, batch);
 		if (conn->local_rx_ctrl.prod_flags.urg_data_pending)
 			conn->urg_state = SMC_URG_NOTYET;
 	}
@@ -363,12 +392,8 @@ static void smc_cdc_msg_recv_action(struct smc_sock *smc,
 	/* trigger sndbuf consumer: RDMA write into peer RMBE and CDC */
 	if ((diff_cons && smc_tx_prepared_sends(conn)) ||
 	    conn->local_rx_ctrl.prod_flags.cons_curs_upd_req ||
-	    conn->local_rx_ctrl.prod_flags.urg_data_pending) {
-		if (!sock_owned_by_user(&smc->sk))
-			smc_tx_pending(conn);
-		else
-			conn->tx_in_release_sock = true;
-	}
+	    conn->local_rx_ctrl.prod_flags.urg_data_pending)
+		smc_cdc_tx_pending(smc, batch);
 
 	if (diff_cons && conn->urg_tx_pend &&
 	    atomic_read(&conn->peer_rmbe_space) == conn->peer_rmbe_size) {
@@ -390,18 +415,56 @@ static void smc_cdc_msg_recv_action(struct smc_sock *smc,
 		if (!queue_work(smc_close_wq, &conn->close_work))
 			sock_put(&smc->sk);
 	}
+
+	if ((conn->rx_batch_wake || conn->rx_batch_tx) &&
+	    !conn->rx_batch_queued) {
+		conn->rx_batch_queued = true;
+		sock_hold(&smc->sk); /* sock_put in smc_cdc_rx_flush() */
+		list_add_tail(&conn->rx_batch_list,
+			      this_cpu_ptr(&smc_cdc_rx_batch));
+	}
 }
 
 /* called under tasklet context */
-static void smc_cdc_msg_recv(struct smc_sock *smc, struct smc_cdc_msg *cdc)
+static void smc_cdc_msg_recv(struct smc_sock *smc, struct smc_cdc_msg *cdc,
+			     bool batch)
 {
 	sock_hold(&smc->sk);
 	bh_lock_sock(&smc->sk);
-	smc_cdc_msg_recv_action(smc, cdc);
+	smc_cdc_msg_recv_action(smc, cdc, batch);
 	bh_unlock_sock(&smc->sk);
 	sock_put(&smc->sk); /* no free sk in softirq-context */
 }
 
+/* Run the wakeups deferred while processing a batch of CDC messages: a
+ * connection that received several CDC messages in one batch wakes up its
+ * reader and triggers its sender only once.
+ */
+static void smc_cdc_rx_flush(void)
+{
+	struct list_head *batch = this_cpu_ptr(&smc_cdc_rx_batch);
+	struct smc_connection *conn, *tmp;
+	struct smc_sock *smc;
+
+	list_for_each_entry_safe(conn, tmp, batch, rx_batch_list) {
+		smc = container_of(conn, struct smc_sock, conn);
+		bh_lock_sock(&smc->sk);
+		list_del(&conn->rx_batch_list);
+		conn->rx_batch_queued = false;
+		if (conn->rx_batch_wake) {
+			conn->rx_batch_wake = false;
+			smc->sk.sk_data_ready(&smc->sk);
+		}
+		if (conn->rx_batch_tx) {
+			conn->rx_batch_tx = false;
+			smc_cdc_tx_pending(smc, false);
+		}
+		bh_unlock_sock(&smc->sk);
+		SMC_STAT_INC(smc, cdc_batch_cnt);
+		sock_put(&smc->sk); /* sock_hold in smc_cdc_msg_recv_action() */
+	}
+}
+
 /* Schedule a tasklet for this connection. Triggered from the ISM device IRQ
  * handler to indicate update in the DMBE.
  *
@@ -422,7 +485,7 @@ static void smcd_cdc_rx_tsklet(struct tasklet_struct *t)
 	smcd_curs_copy(&cdc.prod, &data_cdc->prod, conn);
 	smcd_curs_copy(&cdc.cons, &data_cdc->cons, conn);
 	smc = container_of(conn, struct smc_sock, conn);
-	smc_cdc_msg_recv(smc, (struct smc_cdc_msg *)&cdc);
+	smc_cdc_msg_recv(smc, (struct smc_cdc_msg *)&cdc, false);
 }
 
 /* Initialize receive tasklet. Called from ISM device IRQ handler to start
@@ -466,12 +529,13 @@ static void smc_cdc_rx_handler(struct ib_wc *wc, void *buf)
 		/* received seqno is old */
 		return;
 
-	smc_cdc_msg_recv(smc, cdc);
+	smc_cdc_msg_recv(smc, cdc, true);
 }
 
 static struct smc_wr_rx_handler smc_cdc_rx_handlers[] = {
 	{
 		.handler	= smc_cdc_rx_handler,
+		.flush		= smc_cdc_rx_flush,
 		.type		= SMC_CDC_MSG_TYPE
 	},
 	{
@@ -482,7 +546,10 @@ static struct smc_wr_rx_handler smc_cdc_rx_handlers[] = {
 int __init smc_cdc_init(void)
 {
 	struct smc_wr_rx_handler *handler;
-	int rc = 0;
+	int cpu, rc = 0;
+
+	for_each_possible_cpu(cpu)
+		INIT_LIST_HEAD(per_cpu_ptr(&smc_cdc_rx_batch, cpu));
 
 	for (handler = smc_cdc_rx_handlers; handler->handler; handler++) {
 		INIT_HLIST_NODE(&handler->list);
@@ -1153,6 +1153,38 @@ static void smc_buf_unuse(struct smc_connection *conn,
 	}
 }
 
+/* Let the RMB size of future connections in the link group follow the
+ * receive buffer usage of the connections that went before: grow it when
+ * a connection filled its RMB, shrink it when one used less than a quarter
+ * of it. Connections that never received data and sockets with an explicit
+ * SO_RCVBUF do not count.
+ */
+static void smc_rmb_size_adapt(struct smc_connection *conn,
+			       struct smc_link_group *lgr)
+{
+	struct smc_sock *smc = container_of(conn, struct smc_sock, conn);
+	int len, hint, old;
+
+	if (!conn->rmb_desc || !conn->rmbe_peak ||
+	    (smc->sk.sk_userlocks & SOCK_RCVBUF_LOCK))
+		return;
+
+	len = conn->rmb_desc->len;
+	old = READ_ONCE(lgr->rmb_size_hint) ?: len;
+	if (conn->rmbe_peak >= len - len / 4)
+		hint = min_t(int, old * 2, READ_ONCE(sysctl_rmem_max) / 2);
+	else if (conn->rmbe_peak < len / 4)
+		hint = max_t(int, old / 2, SMC_BUF_MIN_SIZE);
+	else
+		return;
+
+	if (hint > old)
+		SMC_STAT_INC(smc, rmb_grow_cnt);
+	else if (hint < old)
+		SMC_STAT_INC(smc, rmb_shrink_cnt);
+	WRITE_ONCE(lgr->rmb_size_hint, hint);
+}
+
 /* remove a finished connection from its link group */
 void smc_conn_free(struct smc_connection *conn)
 {
@@ -1181,6 +1213,7 @@ void smc_conn_free(struct smc_connection *conn)
 			cancel_work_sync(&conn->abort_work);
 	}
 	if (!list_empty(&lgr->list)) {
+		smc_rmb_size_adapt(conn, lgr);
 		smc_buf_unuse(conn, lgr); /* allow buffer reuse */
 		smc_lgr_unregister_conn(conn);
 	}
@@ -2313,12 +2346,19 @@ static int __smc_buf_create(struct smc_sock *smc, bool is_smcd, bool is_rmb)
 	struct rw_semaphore *lock;	/* lock buffer list */
 	bool is_dgraded = false;
 
-	if (is_rmb)
-		/* use socket recv buffer size (w/o overhead) as start value */
+	if (is_rmb) {
+		/* use socket recv buffer size (w/o overhead) as start value,
+		 * unless it was not set explicitly and the link group learned
+		 * a better one from previous connections
+		 */
 		bufsize = smc->sk.sk_rcvbuf / 2;
-	else
+		if (!(smc->sk.sk_userlocks & SOCK_RCVBUF_LOCK) &&
+		    READ_ONCE(lgr->rmb_size_hint))
+			bufsize = READ_ONCE(lgr->rmb_size_hint);
+	} else {
 		/* use socket send buffer size (w/o overhead) as start value */
 		bufsize = smc->sk.sk_sndbuf / 2;
+	}
 
 	for (bufsize_comp = smc_compress_bufsize(bufsize, is_smcd, is_rmb);
 	     bufsize_comp >= 0; bufsize_comp--) {
@@ -2379,6 +2419,7 @@ static int __smc_buf_create(struct smc_sock *smc, bool is_smcd, bool is_rmb)
 		conn->rmbe_size_comp = bufsize_comp;
 		smc->sk.sk_rcvbuf = bufsize * 2;
 		atomic_set(&conn->bytes_to_rcv, 0);
+		conn->rmbe_peak = 0;
 		conn->rmbe_update_limit =
 			smc_rmb_wnd_update_limit(buf_desc->len);
 		if (is_smcd)
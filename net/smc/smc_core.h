@@ -271,6 +271,9 @@ struct smc_link_group {
 	u8			freeing : 1;	/* lgr is being freed */
 
 	refcount_t		refcnt;		/* lgr reference count */
+	int			rmb_size_hint;	/* RMB size for new conns,
+						 * 0 if not yet adapted
+						 */
 	bool			is_smcd;	/* SMC-R or SMC-D */
 	u8			smc_version;
 	u8			negotiated_eid[SMC_MAX_EID_LEN];
@@ -246,6 +246,22 @@ static int smc_nl_fill_stats_tech_data(struct sk_buff *skb,
 			      smc_tech->urg_data_cnt,
 			      SMC_NLA_STATS_PAD))
 		goto errattr;
+	if (nla_put_u64_64bit(skb, SMC_NLA_STATS_T_CDC_RX_CNT,
+			      smc_tech->cdc_rx_cnt,
+			      SMC_NLA_STATS_PAD))
+		goto errattr;
+	if (nla_put_u64_64bit(skb, SMC_NLA_STATS_T_CDC_BATCH_CNT,
+			      smc_tech->cdc_batch_cnt,
+			      SMC_NLA_STATS_PAD))
+		goto errattr;
+	if (nla_put_u64_64bit(skb, SMC_NLA_STATS_T_RMB_GROW_CNT,
+			      smc_tech->rmb_grow_cnt,
+			      SMC_NLA_STATS_PAD))
+		goto errattr;
+	if (nla_put_u64_64bit(skb, SMC_NLA_STATS_T_RMB_SHRINK_CNT,
+			      smc_tech->rmb_shrink_cnt,
+			      SMC_NLA_STATS_PAD))
+		goto errattr;
 
 	nla_nest_end(skb, attrs);
 	return 0;
@@ -80,6 +80,10 @@ struct smc_stats_tech {
 	u64			tx_bytes;
 	u64			rx_cnt;
 	u64			tx_cnt;
+	u64			cdc_rx_cnt;
+	u64			cdc_batch_cnt;
+	u64			rmb_grow_cnt;
+	u64			rmb_shrink_cnt;
 };
 
 struct smc_stats {
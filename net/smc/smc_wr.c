@@ -446,6 +446,20 @@ static inline void smc_wr_rx_demultiplex(struct ib_wc *wc)
 	}
 }
 
+/* Let the handlers finish the work they deferred while processing a batch
+ * of completions, e.g. waking up the connections that received data.
+ */
+static void smc_wr_rx_flush(void)
+{
+	struct smc_wr_rx_handler *handler;
+	int bkt;
+
+	hash_for_each(smc_wr_rx_hash, bkt, handler, list) {
+		if (handler->flush)
+			handler->flush();
+	}
+}
+
 static inline void smc_wr_rx_process_cqes(struct ib_wc wc[], int num)
 {
 	struct smc_link *link;
@@ -496,6 +510,7 @@ static void smc_wr_rx_tasklet_fn(struct tasklet_struct *t)
 		if (!rc)
 			break;
 		smc_wr_rx_process_cqes(&wc[0], rc);
+		smc_wr_rx_flush();
 	} while (rc > 0);
 	if (polled == 1)
 		goto again;
@@ -43,6 +43,7 @@ typedef void (*smc_wr_tx_dismisser)(struct smc_wr_tx_pend_priv *);
 struct smc_wr_rx_handler {
 	struct hlist_node	list;	/* hash table collision resolution */
 	void			(*handler)(struct ib_wc *, void *);
+	void			(*flush)(void);	/* end of polled batch */
 	u8			type;
 };
 
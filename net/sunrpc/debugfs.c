@@ -179,6 +179,8 @@ xprt_info_show(struct seq_file *f, void *v)
 	seq_printf(f, "addr:  %s\n", xprt->address_strings[RPC_DISPLAY_ADDR]);
 	seq_printf(f, "port:  %s\n", xprt->address_strings[RPC_DISPLAY_PORT]);
 	seq_printf(f, "state: 0x%lx\n", xprt->state);
+	if (xprt->ops->print_debug_stats)
+		xprt->ops->print_debug_stats(xprt, f);
 	return 0;
 }
 
@@ -47,6 +47,10 @@ static LIST_HEAD(svc_xprt_class_list);
 /* SMP locking strategy:
  *
  *	svc_pool->sp_lock protects most of the fields of that pool.
+ *	Transports are queued on svc_pool->sp_xprts without any lock, only
+ *	the threads dequeuing them serialise on sp_lock. Idle threads push
+ *	themselves on svc_pool->sp_idle_threads, removals from that list
+ *	are serialised by svc_pool->sp_idle_lock.
  *	svc_serv->sv_lock protects sv_tempsocks, sv_permsocks, sv_tmpcnt.
  *	when both need to be taken (rare), svc_serv->sv_lock is first.
  *	The "service mutex" protects svc_serv->sv_nrthread.
@@ -179,6 +183,17 @@ void svc_xprt_put(struct svc_xprt *xprt)
 }
 EXPORT_SYMBOL_GPL(svc_xprt_put);
 
+/* A transport that is not on a pool queue points to itself */
+static void svc_xprt_clear_queued(struct svc_xprt *xprt)
+{
+	xprt->xpt_ready.next = &xprt->xpt_ready;
+}
+
+static bool svc_xprt_queued(const struct svc_xprt *xprt)
+{
+	return xprt->xpt_ready.next != &xprt->xpt_ready;
+}
+
 /*
  * Called by transport drivers to initialize the transport independent
  * portion of the transport instance.
@@ -192,7 +207,7 @@ void svc_xprt_init(struct net *net, struct svc_xprt_class *xcl,
 	kref_init(&xprt->xpt_ref);
 	xprt->xpt_server = serv;
 	INIT_LIST_HEAD(&xprt->xpt_list);
-	INIT_LIST_HEAD(&xprt->xpt_ready);
+	svc_xprt_clear_queued(xprt);
 	INIT_LIST_HEAD(&xprt->xpt_deferred);
 	INIT_LIST_HEAD(&xprt->xpt_users);
 	mutex_init(&xprt->xpt_mutex);
@@ -439,6 +454,82 @@ static bool svc_xprt_ready(struct svc_xprt *xprt)
 	return false;
 }
 
+static bool svc_pool_has_xprts(struct svc_pool *pool)
+{
+	return !llist_empty(&pool->sp_xprts) || READ_ONCE(pool->sp_xprts_ready);
+}
+
+/*
+ * Hand the pool's most recently idled thread some work. Returns the
+ * thread woken up, or NULL if all the threads are busy.
+ *
+ * Must be called under rcu_read_lock().
+ */
+static struct svc_rqst *svc_pool_wake_idle_thread(struct svc_pool *pool)
+{
+	struct svc_rqst	*rqstp = NULL;
+	struct llist_node *ln;
+
+	/* Pairs with the llist_add() in svc_get_next_xprt(): either this
+	 * sees the idle thread, or that thread sees the queued work.
+	 */
+	if (llist_empty(&pool->sp_idle_threads))
+		return NULL;
+
+	spin_lock_bh(&pool->sp_idle_lock);
+	ln = llist_del_first(&pool->sp_idle_threads);
+	if (ln) {
+		rqstp = llist_entry(ln, struct svc_rqst, rq_idle);
+		rqstp->rq_qtime = ktime_get();
+		smp_mb__before_atomic();
+		set_bit(RQ_BUSY, &rqstp->rq_flags);
+	}
+	spin_unlock_bh(&pool->sp_idle_lock);
+	if (!rqstp)
+		return NULL;
+
+	percpu_counter_inc(&pool->sp_threads_woken);
+	wake_up_process(rqstp->rq_task);
+	return rqstp;
+}
+
+/*
+ * Take @rqstp off the idle list after it woke up. Returns true if it was
+ * handed some work by svc_pool_wake_idle_thread(), false if it woke up
+ * for some other reason.
+ */
+static bool svc_rqst_leave_idle(struct svc_pool *pool, struct svc_rqst *rqstp)
+{
+	struct llist_node *node = &rqstp->rq_idle, *first, **pp;
+	bool woken = true;
+
+	if (test_bit(RQ_BUSY, &rqstp->rq_flags))
+		return true;
+
+	spin_lock_bh(&pool->sp_idle_lock);
+	if (test_bit(RQ_BUSY, &rqstp->rq_flags))
+		goto out;
+
+	/* New threads may be pushed concurrently, so unlinking the first
+	 * entry has to be done with a cmpxchg. Anything further down the
+	 * list is only changed under sp_idle_lock.
+	 */
+	first = node;
+	if (!try_cmpxchg(&pool->sp_idle_threads.first, &first, node->next)) {
+		for (pp = &first->next; *pp; pp = &(*pp)->next) {
+			if (*pp == node) {
+				*pp = node->next;
+				break;
+			}
+		}
+	}
+	set_bit(RQ_BUSY, &rqstp->rq_flags);
+	woken = false;
+out:
+	spin_unlock_bh(&pool->sp_idle_lock);
+	return woken;
+}
+
 /**
  * svc_xprt_enqueue - Queue a transport on an idle nfsd thread
  * @xprt: transport with data pending
@@ -447,7 +538,7 @@ static bool svc_xprt_ready(struct svc_xprt *xprt)
 void svc_xprt_enqueue(struct svc_xprt *xprt)
 {
 	struct svc_pool *pool;
-	struct svc_rqst	*rqstp = NULL;
+	struct svc_rqst	*rqstp;
 
 	if (!svc_xprt_ready(xprt))
 		return;
@@ -463,43 +554,40 @@ void svc_xprt_enqueue(struct svc_xprt *xprt)
 	pool = svc_pool_for_cpu(xprt->xpt_server);
 
 	percpu_counter_inc(&pool->sp_sockets_queued);
-	spin_lock_bh(&pool->sp_lock);
-	list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
-	spin_unlock_bh(&pool->sp_lock);
+	llist_add(&xprt->xpt_ready, &pool->sp_xprts);
 
 	/* find a thread for this xprt */
 	rcu_read_lock();
-	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
-		if (test_and_set_bit(RQ_BUSY, &rqstp->rq_flags))
-			continue;
-		percpu_counter_inc(&pool->sp_threads_woken);
-		rqstp->rq_qtime = ktime_get();
-		wake_up_process(rqstp->rq_task);
-		goto out_unlock;
-	}
-	set_bit(SP_CONGESTED, &pool->sp_flags);
-	rqstp = NULL;
-out_unlock:
+	rqstp = svc_pool_wake_idle_thread(pool);
+	if (!rqstp)
+		set_bit(SP_CONGESTED, &pool->sp_flags);
 	rcu_read_unlock();
 	trace_svc_xprt_enqueue(xprt, rqstp);
 }
 EXPORT_SYMBOL_GPL(svc_xprt_enqueue);
 
 /*
- * Dequeue the first transport, if there is one.
+ * Dequeue the first transport, if there is one. Transports are queued
+ * in LIFO order on sp_xprts; whenever sp_xprts_ready runs empty, the
+ * whole queue is taken over and reversed so they are served in FIFO
+ * order.
  */
 static struct svc_xprt *svc_xprt_dequeue(struct svc_pool *pool)
 {
 	struct svc_xprt	*xprt = NULL;
+	struct llist_node *ln;
 
-	if (list_empty(&pool->sp_sockets))
+	if (!svc_pool_has_xprts(pool))
 		goto out;
 
 	spin_lock_bh(&pool->sp_lock);
-	if (likely(!list_empty(&pool->sp_sockets))) {
-		xprt = list_first_entry(&pool->sp_sockets,
-					struct svc_xprt, xpt_ready);
-		list_del_init(&xprt->xpt_ready);
+	ln = pool->sp_xprts_ready;
+	if (!ln)
+		ln = llist_reverse_order(llist_del_all(&pool->sp_xprts));
+	if (likely(ln)) {
+		WRITE_ONCE(pool->sp_xprts_ready, ln->next);
+		xprt = llist_entry(ln, struct svc_xprt, xpt_ready);
+		svc_xprt_clear_queued(xprt);
 		svc_xprt_get(xprt);
 	}
 	spin_unlock_bh(&pool->sp_lock);
@@ -587,13 +675,10 @@ void svc_wake_up(struct svc_serv *serv)
 	pool = &serv->sv_pools[0];
 
 	rcu_read_lock();
-	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
-		/* skip any that aren't queued */
-		if (test_bit(RQ_BUSY, &rqstp->rq_flags))
-			continue;
-		rcu_read_unlock();
-		wake_up_process(rqstp->rq_task);
+	rqstp = svc_pool_wake_idle_thread(pool);
+	if (rqstp) {
 		trace_svc_wake_up(rqstp->rq_task->pid);
+		rcu_read_unlock();
 		return;
 	}
 	rcu_read_unlock();
@@ -726,7 +811,7 @@ rqst_should_sleep(struct svc_rqst *rqstp)
 		return false;
 
 	/* was a socket queued? */
-	if (!list_empty(&pool->sp_sockets))
+	if (svc_pool_has_xprts(pool))
 		return false;
 
 	/* are we shutting down? */
@@ -760,7 +845,8 @@ static struct svc_xprt *svc_get_next_xprt(struct svc_rqst *rqstp, long timeout)
 	smp_mb__before_atomic();
 	clear_bit(SP_CONGESTED, &pool->sp_flags);
 	clear_bit(RQ_BUSY, &rqstp->rq_flags);
-	smp_mb__after_atomic();
+	/* implies a full barrier, see svc_pool_wake_idle_thread() */
+	llist_add(&rqstp->rq_idle, &pool->sp_idle_threads);
 
 	if (likely(rqst_should_sleep(rqstp)))
 		time_left = schedule_timeout(timeout);
@@ -769,7 +855,10 @@ static struct svc_xprt *svc_get_next_xprt(struct svc_rqst *rqstp, long timeout)
 
 	try_to_freeze();
 
-	set_bit(RQ_BUSY, &rqstp->rq_flags);
+	if (svc_rqst_leave_idle(pool, rqstp))
+		percpu_counter_add(&pool->sp_wake_ns,
+				   ktime_to_ns(ktime_sub(ktime_get(),
+							 rqstp->rq_qtime)));
 	smp_mb__after_atomic();
 	rqstp->rq_xprt = svc_xprt_dequeue(pool);
 	if (rqstp->rq_xprt)
@@ -1058,7 +1147,7 @@ static void svc_delete_xprt(struct svc_xprt *xprt)
 
 	spin_lock_bh(&serv->sv_lock);
 	list_del_init(&xprt->xpt_list);
-	WARN_ON_ONCE(!list_empty(&xprt->xpt_ready));
+	WARN_ON_ONCE(svc_xprt_queued(xprt));
 	if (test_bit(XPT_TEMP, &xprt->xpt_flags))
 		serv->sv_tmpcnt--;
 	spin_unlock_bh(&serv->sv_lock);
@@ -1111,19 +1200,26 @@ static int svc_close_list(struct svc_serv *serv, struct list_head *xprt_list, st
 
 static struct svc_xprt *svc_dequeue_net(struct svc_serv *serv, struct net *net)
 {
+	struct llist_node **pp, *ln;
 	struct svc_pool *pool;
 	struct svc_xprt *xprt;
-	struct svc_xprt *tmp;
 	int i;
 
 	for (i = 0; i < serv->sv_nrpools; i++) {
 		pool = &serv->sv_pools[i];
 
 		spin_lock_bh(&pool->sp_lock);
-		list_for_each_entry_safe(xprt, tmp, &pool->sp_sockets, xpt_ready) {
+		/* move everything queued so far behind the ready list */
+		for (pp = &pool->sp_xprts_ready; *pp; pp = &(*pp)->next)
+			;
+		*pp = llist_reverse_order(llist_del_all(&pool->sp_xprts));
+
+		for (pp = &pool->sp_xprts_ready; (ln = *pp); pp = &ln->next) {
+			xprt = llist_entry(ln, struct svc_xprt, xpt_ready);
 			if (xprt->xpt_net != net)
 				continue;
-			list_del_init(&xprt->xpt_ready);
+			WRITE_ONCE(*pp, ln->next);
+			svc_xprt_clear_queued(xprt);
 			spin_unlock_bh(&pool->sp_lock);
 			return xprt;
 		}
@@ -1442,18 +1538,23 @@ static void svc_pool_stats_stop(struct seq_file *m, void *p)
 static int svc_pool_stats_show(struct seq_file *m, void *p)
 {
 	struct svc_pool *pool = p;
+	u64 woken, wake_ns;
 
 	if (p == SEQ_START_TOKEN) {
-		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout\n");
+		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout wake-latency-ns\n");
 		return 0;
 	}
 
-	seq_printf(m, "%u %llu %llu %llu %llu\n",
+	woken = percpu_counter_sum_positive(&pool->sp_threads_woken);
+	wake_ns = percpu_counter_sum_positive(&pool->sp_wake_ns);
+
+	seq_printf(m, "%u %llu %llu %llu %llu %llu\n",
 		pool->sp_id,
 		percpu_counter_sum_positive(&pool->sp_sockets_queued),
 		percpu_counter_sum_positive(&pool->sp_sockets_queued),
-		percpu_counter_sum_positive(&pool->sp_threads_woken),
-		percpu_counter_sum_positive(&pool->sp_threads_timedout));
+		woken,
+		percpu_counter_sum_positive(&pool->sp_threads_timedout),
+		woken ? div64_u64(wake_ns, woken) : 0);
 
 	return 0;
 }
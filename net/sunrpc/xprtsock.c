@@ -670,6 +670,7 @@ xs_read_stream(struct sock_xprt *transport, int flags)
 	if (xs_read_stream_request_done(transport)) {
 		trace_xs_stream_read_request(transport);
 		transport->recv.copied = 0;
+		transport->recv_stats.records++;
 	}
 	transport->recv.offset = 0;
 	transport->recv.len = 0;
@@ -703,12 +704,18 @@ static void xs_poll_check_readable(struct sock_xprt *transport)
 
 static void xs_stream_data_receive(struct sock_xprt *transport)
 {
+	unsigned long records;
 	size_t read = 0;
 	ssize_t ret = 0;
 
 	mutex_lock(&transport->recv_mutex);
 	if (transport->sock == NULL)
 		goto out;
+	/* XPRT_SOCK_DATA_READY already folds data_ready callbacks into a
+	 * single worker run, and the loop below drains every queued record.
+	 * Only count how many records a run picks up.
+	 */
+	records = transport->recv_stats.records;
 	for (;;) {
 		ret = xs_read_stream(transport, MSG_DONTWAIT);
 		if (ret < 0)
@@ -716,6 +723,10 @@ static void xs_stream_data_receive(struct sock_xprt *transport)
 		read += ret;
 		cond_resched();
 	}
+	records = transport->recv_stats.records - records;
+	transport->recv_stats.runs++;
+	if (records > transport->recv_stats.max_records)
+		transport->recv_stats.max_records = records;
 	if (ret == -ESHUTDOWN)
 		kernel_sock_shutdown(transport->sock, SHUT_RDWR);
 	else
@@ -1044,7 +1055,18 @@ static int xs_tcp_send_request(struct rpc_rqst *req)
 	 * to cope with writespace callbacks arriving _after_ we have
 	 * called sendmsg(). */
 	req->rq_xtime = ktime_get();
-	tcp_sock_set_cork(transport->inet, true);
+
+	/* Only cork the socket when more requests are queued behind this
+	 * one. xprt_transmit() still hands us one request at a time, and
+	 * the cork lets TCP coalesce their records into full segments. A
+	 * lone request goes out on its own without the two extra socket
+	 * lock round trips of corking and uncorking.
+	 */
+	if (atomic_long_read(&xprt->xmit_queuelen) > 1 &&
+	    !test_and_set_bit(XPRT_SOCK_CORKED, &transport->sock_state)) {
+		tcp_sock_set_cork(transport->inet, true);
+		transport->xmit_stats.batches++;
+	}
 
 	vm_wait = sk_stream_is_writeable(transport->inet) ? true : false;
 
@@ -1062,7 +1084,12 @@ static int xs_tcp_send_request(struct rpc_rqst *req)
 		if (likely(req->rq_bytes_sent >= msglen)) {
 			req->rq_xmit_bytes_sent += transport->xmit.offset;
 			transport->xmit.offset = 0;
-			if (atomic_long_read(&xprt->xmit_queuelen) == 1)
+			transport->xmit_stats.records++;
+			if (test_bit(XPRT_SOCK_CORKED, &transport->sock_state))
+				transport->xmit_stats.batched++;
+			if (atomic_long_read(&xprt->xmit_queuelen) == 1 &&
+			    test_and_clear_bit(XPRT_SOCK_CORKED,
+					       &transport->sock_state))
 				tcp_sock_set_cork(transport->inet, false);
 			return 0;
 		}
@@ -1122,6 +1149,7 @@ static void xs_sock_reset_state_flags(struct rpc_xprt *xprt)
 	clear_bit(XPRT_SOCK_WAKE_WRITE, &transport->sock_state);
 	clear_bit(XPRT_SOCK_WAKE_DISCONNECT, &transport->sock_state);
 	clear_bit(XPRT_SOCK_NOSPACE, &transport->sock_state);
+	clear_bit(XPRT_SOCK_CORKED, &transport->sock_state);
 }
 
 static void xs_run_error_worker(struct sock_xprt *transport, unsigned int nr)
@@ -2527,6 +2555,27 @@ static void xs_tcp_print_stats(struct rpc_xprt *xprt, struct seq_file *seq)
 			xprt->stat.pending_u);
 }
 
+/**
+ * xs_tcp_print_debug_stats - display TCP batching stats in debugfs
+ * @xprt: rpc_xprt struct containing statistics
+ * @seq: output file
+ *
+ */
+static void xs_tcp_print_debug_stats(struct rpc_xprt *xprt,
+				     struct seq_file *seq)
+{
+	struct sock_xprt *transport = container_of(xprt, struct sock_xprt, xprt);
+
+	seq_printf(seq, "xmit:  records %lu batches %lu batched %lu\n",
+		   READ_ONCE(transport->xmit_stats.records),
+		   READ_ONCE(transport->xmit_stats.batches),
+		   READ_ONCE(transport->xmit_stats.batched));
+	seq_printf(seq, "recv:  runs %lu records %lu max %lu\n",
+		   READ_ONCE(transport->recv_stats.runs),
+		   READ_ONCE(transport->recv_stats.records),
+		   READ_ONCE(transport->recv_stats.max_records));
+}
+
 /*
  * Allocate a bunch of pages for a scratch buffer for the rpc code. The reason
  * we allocate pages instead doing a kmalloc like rpc_malloc is because we want
@@ -2717,6 +2766,7 @@ static const struct rpc_xprt_ops xs_tcp_ops = {
 	.destroy		= xs_destroy,
 	.set_connect_timeout	= xs_tcp_set_connect_timeout,
 	.print_stats		= xs_tcp_print_stats,
+	.print_debug_stats	= xs_tcp_print_debug_stats,
 	.enable_swap		= xs_enable_swap,
 	.disable_swap		= xs_disable_swap,
 	.inject_disconnect	= xs_inject_disconnect,
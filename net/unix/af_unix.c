@@ -832,6 +832,35 @@ static void unix_show_fdinfo(struct seq_file *m, struct socket *sock)
 #define unix_show_fdinfo NULL
 #endif
 
+/* sock_setsockopt() only accepts SO_ZEROCOPY for inet and RDS sockets, so
+ * stream sockets handle SOL_SOCKET themselves (SOCK_CUSTOM_SOCKOPT) to let
+ * senders opt in to MSG_ZEROCOPY.
+ */
+static int unix_stream_setsockopt(struct socket *sock, int level, int optname,
+				  sockptr_t optval, unsigned int optlen)
+{
+	struct sock *sk = sock->sk;
+	int val;
+
+	if (level != SOL_SOCKET)
+		return -EOPNOTSUPP;
+
+	if (optname != SO_ZEROCOPY)
+		return sock_setsockopt(sock, level, optname, optval, optlen);
+
+	if (optlen < sizeof(int))
+		return -EINVAL;
+	if (copy_from_sockptr(&val, optval, sizeof(val)))
+		return -EFAULT;
+	if (val < 0 || val > 1)
+		return -EINVAL;
+
+	lock_sock(sk);
+	sock_valbool_flag(sk, SOCK_ZEROCOPY, val);
+	release_sock(sk);
+	return 0;
+}
+
 static const struct proto_ops unix_stream_ops = {
 	.family =	PF_UNIX,
 	.owner =	THIS_MODULE,
@@ -849,6 +878,7 @@ static const struct proto_ops unix_stream_ops = {
 #endif
 	.listen =	unix_listen,
 	.shutdown =	unix_shutdown,
+	.setsockopt =	unix_stream_setsockopt,
 	.sendmsg =	unix_stream_sendmsg,
 	.recvmsg =	unix_stream_recvmsg,
 	.read_skb =	unix_stream_read_skb,
@@ -1009,6 +1039,8 @@ static int unix_create(struct net *net, struct socket *sock, int protocol,
 	switch (sock->type) {
 	case SOCK_STREAM:
 		sock->ops = &unix_stream_ops;
+		/* for SO_ZEROCOPY, see unix_stream_setsockopt() */
+		set_bit(SOCK_CUSTOM_SOCKOPT, &sock->flags);
 		break;
 		/*
 		 *	Believe it or not BSD has AF_UNIX, SOCK_RAW though
@@ -1675,6 +1707,8 @@ static void unix_sock_inherit_flags(const struct socket *old,
 		set_bit(SOCK_PASSCRED, &new->flags);
 	if (test_bit(SOCK_PASSSEC, &old->flags))
 		set_bit(SOCK_PASSSEC, &new->flags);
+	if (test_bit(SOCK_CUSTOM_SOCKOPT, &old->flags))
+		set_bit(SOCK_CUSTOM_SOCKOPT, &new->flags);
 }
 
 static int unix_accept(struct socket *sock, struct socket *newsock, int flags,
@@ -2160,6 +2194,28 @@ static int queue_oob(struct socket *sock, struct msghdr *msg, struct sock *other
 }
 #endif
 
+/* Pin the user pages backing the next @size bytes of @msg into the frags
+ * of @skb.  The receiver copies straight out of them, and @uarg reports
+ * the completion on the sender's error queue once the skb is consumed.
+ */
+static int unix_stream_zerocopy_fill(struct sk_buff *skb, struct msghdr *msg,
+				     int size, struct ubuf_info *uarg)
+{
+	int err;
+
+	/* A NULL sk charges the pinned pages to skb->sk->sk_wmem_alloc,
+	 * which is what sock_wfree() returns when the skb is freed.
+	 */
+	err = __zerocopy_sg_from_iter(msg, NULL, skb, &msg->msg_iter, size);
+	if (err == -EMSGSIZE && skb->len)
+		err = 0;	/* out of frags, the rest goes in the next skb */
+	if (err)
+		return err;
+
+	skb_zcopy_set(skb, uarg, NULL);
+	return 0;
+}
+
 static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			       size_t len)
 {
@@ -2170,6 +2226,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	int sent = 0;
 	struct scm_cookie scm;
 	bool fds_sent = false;
+	struct ubuf_info *uarg = NULL;
 	int data_len;
 
 	wait_for_unix_gc();
@@ -2200,22 +2257,41 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	if ((msg->msg_flags & MSG_ZEROCOPY) && len &&
+	    sock_flag(sk, SOCK_ZEROCOPY)) {
+		uarg = msg_zerocopy_realloc(sk, len, NULL);
+		if (!uarg) {
+			err = -ENOBUFS;
+			goto out_err;
+		}
+	}
+
 	while (sent < len) {
 		size = len - sent;
 
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
 
-		/* allow fallback to order-0 allocations */
-		size = min_t(int, size, SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ);
+		if (uarg) {
+			/* The sender's pages go straight into the frags,
+			 * leave one slot for a buffer that is not page
+			 * aligned.
+			 */
+			size = min_t(int, size, (MAX_SKB_FRAGS - 1) * PAGE_SIZE);
+			data_len = size;
+		} else {
+			/* allow fallback to order-0 allocations */
+			size = min_t(int, size, SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ);
 
-		data_len = max_t(int, 0, size - SKB_MAX_HEAD(0));
+			data_len = max_t(int, 0, size - SKB_MAX_HEAD(0));
 
-		data_len = min_t(size_t, size, PAGE_ALIGN(data_len));
+			data_len = min_t(size_t, size, PAGE_ALIGN(data_len));
+		}
 
-		skb = sock_alloc_send_pskb(sk, size - data_len, data_len,
+		skb = sock_alloc_send_pskb(sk, size - data_len,
+					   uarg ? 0 : data_len,
 					   msg->msg_flags & MSG_DONTWAIT, &err,
-					   get_order(UNIX_SKB_FRAGS_SZ));
+					   uarg ? 0 : get_order(UNIX_SKB_FRAGS_SZ));
 		if (!skb)
 			goto out_err;
 
@@ -2227,13 +2303,23 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		}
 		fds_sent = true;
 
-		skb_put(skb, size - data_len);
-		skb->data_len = data_len;
-		skb->len = size;
-		err = skb_copy_datagram_from_iter(skb, 0, &msg->msg_iter, size);
-		if (err) {
-			kfree_skb(skb);
-			goto out_err;
+		if (uarg) {
+			err = unix_stream_zerocopy_fill(skb, msg, size, uarg);
+			if (err) {
+				kfree_skb(skb);
+				goto out_err;
+			}
+			size = skb->len;
+		} else {
+			skb_put(skb, size - data_len);
+			skb->data_len = data_len;
+			skb->len = size;
+			err = skb_copy_datagram_from_iter(skb, 0, &msg->msg_iter,
+							  size);
+			if (err) {
+				kfree_skb(skb);
+				goto out_err;
+			}
 		}
 
 		unix_state_lock(other);
@@ -2259,6 +2345,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	}
 #endif
 
+	net_zcopy_put(uarg);
 	scm_destroy(&scm);
 
 	return sent;
@@ -2271,6 +2358,11 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		send_sig(SIGPIPE, current, 0);
 	err = -EPIPE;
 out_err:
+	/* the skbs already queued still report their completion */
+	if (sent)
+		net_zcopy_put(uarg);
+	else
+		net_zcopy_put_abort(uarg, true);
 	scm_destroy(&scm);
 	return sent ? : err;
 }
@@ -2338,7 +2430,7 @@ static ssize_t unix_stream_sendpage(struct socket *socket, struct page *page,
 	skb = skb_peek_tail(&other->sk_receive_queue);
 	if (tail && tail == skb) {
 		skb = newskb;
-	} else if (!skb || !unix_skb_scm_eq(skb, &scm)) {
+	} else if (!skb || skb_zcopy(skb) || !unix_skb_scm_eq(skb, &scm)) {
 		if (newskb) {
 			skb = newskb;
 		} else {
@@ -2950,11 +3042,17 @@ static int unix_stream_recvmsg(struct socket *sock, struct msghdr *msg,
 		.size = size,
 		.flags = flags
 	};
-
-#ifdef CONFIG_BPF_SYSCALL
 	struct sock *sk = sock->sk;
+#ifdef CONFIG_BPF_SYSCALL
 	const struct proto *prot = READ_ONCE(sk->sk_prot);
+#endif
 
+	/* MSG_ZEROCOPY completions */
+	if (unlikely(flags & MSG_ERRQUEUE))
+		return sock_recv_errqueue(sk, msg, size, SOL_SOCKET,
+					  SO_ZEROCOPY);
+
+#ifdef CONFIG_BPF_SYSCALL
 	if (prot != &unix_stream_proto)
 		return prot->recvmsg(sk, msg, size, flags, NULL);
 #endif
@@ -2965,9 +3063,37 @@ static int unix_stream_splice_actor(struct sk_buff *skb,
 				    int skip, int chunk,
 				    struct unix_stream_read_state *state)
 {
-	return skb_splice_bits(skb, state->socket->sk,
-			       UNIXCB(skb).consumed + skip,
-			       state->pipe, chunk, state->splice_flags);
+	struct ubuf_info *uarg = skb_zcopy(skb);
+	struct sk_buff *copy;
+	int ret;
+
+	if (likely(!uarg))
+		return skb_splice_bits(skb, state->socket->sk,
+				       UNIXCB(skb).consumed + skip,
+				       state->pipe, chunk, state->splice_flags);
+
+	/* The frags of a MSG_ZEROCOPY skb are the sender's user pages.  A
+	 * pipe would keep referencing them after the sender was told it may
+	 * reuse its buffer, so splice from a private copy of the chunk.  The
+	 * skb itself may be shared with a reader, it can't be modified.
+	 */
+	copy = alloc_skb(chunk, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	ret = skb_copy_bits(skb, UNIXCB(skb).consumed + skip,
+			    skb_put(copy, chunk), chunk);
+	if (!ret) {
+		/* report SO_EE_CODE_ZEROCOPY_COPIED on completion */
+		net_zcopy_get(uarg);
+		uarg->callback(NULL, uarg, false);
+
+		ret = skb_splice_bits(copy, state->socket->sk, 0,
+				      state->pipe, chunk, state->splice_flags);
+	}
+
+	consume_skb(copy);
+	return ret;
 }
 
 static ssize_t unix_stream_splice_read(struct socket *sock,  loff_t *ppos,
@@ -3166,7 +3292,8 @@ static __poll_t unix_poll(struct file *file, struct socket *sock, poll_table *wa
 	shutdown = READ_ONCE(sk->sk_shutdown);
 
 	/* exceptional events? */
-	if (READ_ONCE(sk->sk_err))
+	if (READ_ONCE(sk->sk_err) ||
+	    !skb_queue_empty_lockless(&sk->sk_error_queue))
 		mask |= EPOLLERR;
 	if (shutdown == SHUTDOWN_MASK)
 		mask |= EPOLLHUP;
@@ -75,6 +75,8 @@
 #include <linux/proc_fs.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/cred.h>
 
 #include <net/sock.h>
 #include <net/af_unix.h>
@@ -86,7 +88,6 @@
 /* Internal data structures and random procedures: */
 
 static LIST_HEAD(gc_candidates);
-static DECLARE_WAIT_QUEUE_HEAD(unix_gc_wait);
 
 static void scan_inflight(struct sock *x, void (*func)(struct unix_sock *),
 			  struct sk_buff_head *hitlist)
@@ -187,22 +188,9 @@ static void inc_inflight_move_tail(struct unix_sock *u)
 
 static bool gc_in_progress;
 #define UNIX_INFLIGHT_TRIGGER_GC 16000
+#define UNIX_INFLIGHT_SANE_USER (SCM_MAX_FD * 8)
 
-void wait_for_unix_gc(void)
-{
-	/* If number of inflight sockets is insane,
-	 * force a garbage collect right now.
-	 * Paired with the WRITE_ONCE() in unix_inflight(),
-	 * unix_notinflight() and gc_in_progress().
-	 */
-	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
-	    !READ_ONCE(gc_in_progress))
-		unix_gc();
-	wait_event(unix_gc_wait, gc_in_progress == false);
-}
-
-/* The external entry point: unix_gc() */
-void unix_gc(void)
+static void __unix_gc(struct work_struct *work)
 {
 	struct sk_buff *next_skb, *skb;
 	struct unix_sock *u;
@@ -213,13 +201,6 @@ void unix_gc(void)
 
 	spin_lock(&unix_gc_lock);
 
-	/* Avoid a recursive GC. */
-	if (gc_in_progress)
-		goto out;
-
-	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
-	WRITE_ONCE(gc_in_progress, true);
-
 	/* First, select candidates for garbage collection.  Only
 	 * in-flight sockets are considered, and from those only ones
 	 * which don't have any external reference.
@@ -328,8 +309,51 @@ void unix_gc(void)
 	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
 	WRITE_ONCE(gc_in_progress, false);
 
-	wake_up(&unix_gc_wait);
+	spin_unlock(&unix_gc_lock);
+}
+
+static DECLARE_WORK(unix_gc_work, __unix_gc);
 
+/* The external entry point: unix_gc()
+ *
+ * The collection itself runs from a workqueue, so neither the last
+ * close() of a socket nor a sender in wait_for_unix_gc() has to sit
+ * through a full scan of the in-flight graph.
+ */
+void unix_gc(void)
+{
+	spin_lock(&unix_gc_lock);
+
+	/* Avoid a recursive GC. */
+	if (gc_in_progress)
+		goto out;
+
+	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
+	WRITE_ONCE(gc_in_progress, true);
+
+	queue_work(system_unbound_wq, &unix_gc_work);
  out:
 	spin_unlock(&unix_gc_lock);
 }
+
+void wait_for_unix_gc(void)
+{
+	/* If number of inflight sockets is insane,
+	 * kick the garbage collector.
+	 * Paired with the WRITE_ONCE() in unix_inflight(),
+	 * unix_notinflight() and __unix_gc().
+	 */
+	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
+	    !READ_ONCE(gc_in_progress))
+		unix_gc();
+
+	/* Only throttle a user that keeps piling up fds in flight;
+	 * everybody else goes on without waiting for the collector.
+	 * user->unix_inflight is read locklessly, see too_many_unix_fds().
+	 */
+	if (READ_ONCE(current_user()->unix_inflight) < UNIX_INFLIGHT_SANE_USER)
+		return;
+
+	if (READ_ONCE(gc_in_progress))
+		flush_work(&unix_gc_work);
+}
@@ -44,13 +44,15 @@ EXPORT_SYMBOL(unix_get_socket);
 
 /* Keep the number of times in flight count for the file
  * descriptor if it is for an AF_UNIX socket.
+ *
+ * The caller holds unix_gc_lock, which lets unix_attach_fds() and
+ * unix_detach_fds() account a whole SCM_RIGHTS array under a single
+ * lock round trip instead of one per descriptor.
  */
-void unix_inflight(struct user_struct *user, struct file *fp)
+static void __unix_inflight(struct user_struct *user, struct file *fp)
 {
 	struct sock *s = unix_get_socket(fp);
 
-	spin_lock(&unix_gc_lock);
-
 	if (s) {
 		struct unix_sock *u = unix_sk(s);
 
@@ -63,16 +65,14 @@ void unix_inflight(struct user_struct *user, struct file *fp)
 		/* Paired with READ_ONCE() in wait_for_unix_gc() */
 		WRITE_ONCE(unix_tot_inflight, unix_tot_inflight + 1);
 	}
-	user->unix_inflight++;
-	spin_unlock(&unix_gc_lock);
+	/* Paired with READ_ONCE() in wait_for_unix_gc() */
+	WRITE_ONCE(user->unix_inflight, user->unix_inflight + 1);
 }
 
-void unix_notinflight(struct user_struct *user, struct file *fp)
+static void __unix_notinflight(struct user_struct *user, struct file *fp)
 {
 	struct sock *s = unix_get_socket(fp);
 
-	spin_lock(&unix_gc_lock);
-
 	if (s) {
 		struct unix_sock *u = unix_sk(s);
 
@@ -84,7 +84,21 @@ void unix_notinflight(struct user_struct *user, struct file *fp)
 		/* Paired with READ_ONCE() in wait_for_unix_gc() */
 		WRITE_ONCE(unix_tot_inflight, unix_tot_inflight - 1);
 	}
-	user->unix_inflight--;
+	/* Paired with READ_ONCE() in wait_for_unix_gc() */
+	WRITE_ONCE(user->unix_inflight, user->unix_inflight - 1);
+}
+
+void unix_inflight(struct user_struct *user, struct file *fp)
+{
+	spin_lock(&unix_gc_lock);
+	__unix_inflight(user, fp);
+	spin_unlock(&unix_gc_lock);
+}
+
+void unix_notinflight(struct user_struct *user, struct file *fp)
+{
+	spin_lock(&unix_gc_lock);
+	__unix_notinflight(user, fp);
 	spin_unlock(&unix_gc_lock);
 }
 
@@ -119,8 +133,10 @@ int unix_attach_fds(struct scm_cookie *scm, struct sk_buff *skb)
 	if (!UNIXCB(skb).fp)
 		return -ENOMEM;
 
+	spin_lock(&unix_gc_lock);
 	for (i = scm->fp->count - 1; i >= 0; i--)
-		unix_inflight(scm->fp->user, scm->fp->fp[i]);
+		__unix_inflight(scm->fp->user, scm->fp->fp[i]);
+	spin_unlock(&unix_gc_lock);
 	return 0;
 }
 EXPORT_SYMBOL(unix_attach_fds);
@@ -132,8 +148,10 @@ void unix_detach_fds(struct scm_cookie *scm, struct sk_buff *skb)
 	scm->fp = UNIXCB(skb).fp;
 	UNIXCB(skb).fp = NULL;
 
+	spin_lock(&unix_gc_lock);
 	for (i = scm->fp->count-1; i >= 0; i--)
-		unix_notinflight(scm->fp->user, scm->fp->fp[i]);
+		__unix_notinflight(scm->fp->user, scm->fp->fp[i]);
+	spin_unlock(&unix_gc_lock);
 }
 EXPORT_SYMBOL(unix_detach_fds);
 
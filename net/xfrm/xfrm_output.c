@@ -24,6 +24,7 @@
 #endif
 
 #include "xfrm_inout.h"
+#include "xfrm_state_priv.h"
 
 static int xfrm_output2(struct net *net, struct sock *sk, struct sk_buff *skb);
 static int xfrm_inner_extract_output(struct xfrm_state *x, struct sk_buff *skb);
@@ -531,9 +532,7 @@ static int xfrm_output_one(struct sk_buff *skb, int err)
 			goto error;
 		}
 
-		x->curlft.bytes += skb->len;
-		x->curlft.packets++;
-		x->lastused = ktime_get_real_seconds();
+		xfrm_state_account(x, skb->len, true);
 
 		spin_unlock_bh(&x->lock);
 
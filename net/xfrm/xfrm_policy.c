@@ -28,6 +28,7 @@
 #include <linux/cpu.h>
 #include <linux/audit.h>
 #include <linux/rhashtable.h>
+#include <linux/sort.h>
 #include <linux/if_tunnel.h>
 #include <net/dst.h>
 #include <net/flow.h>
@@ -166,6 +167,7 @@ static int stale_bundle(struct dst_entry *dst);
 static int xfrm_bundle_ok(struct xfrm_dst *xdst);
 static void xfrm_policy_queue_process(struct timer_list *t);
 
+static void xfrm_pol_cls_changed(struct net *net);
 static void __xfrm_policy_link(struct xfrm_policy *pol, int dir);
 static struct xfrm_policy *__xfrm_policy_unlink(struct xfrm_policy *pol,
 						int dir);
@@ -1290,6 +1292,8 @@ static void xfrm_hash_rebuild(struct work_struct *work)
 			goto out_unlock;
 	}
 
+	xfrm_pol_cls_changed(net);
+
 	/* reset the bydst and inexact table in all directions */
 	for (dir = 0; dir < XFRM_POLICY_MAX; dir++) {
 		struct hlist_node *n;
@@ -2146,6 +2150,506 @@ xfrm_policy_eval_candidates(struct xfrm_pol_inexact_candidates *cand,
 	return prefer;
 }
 
+/* Compiled policy classifier
+ *
+ * The inexact bins return up to four candidate lists that all have to be
+ * evaluated with xfrm_selector_match(); with many overlapping policies
+ * those lists get long. The classifier does a tuple space search instead:
+ * the inexact policies of each direction are grouped by the shape of
+ * their selector (family, address prefix lengths, protocol and port
+ * masks). Within a tuple, the masked packet fields hash straight to the
+ * policies whose selector can match, so a lookup costs one hash probe per
+ * tuple. Tuples are visited in order of their best priority and the walk
+ * stops as soon as no remaining tuple can beat the best match.
+ *
+ * The tuples are compiled from a snapshot of the policies by a delayed
+ * work and swapped in under RCU. Policies unlinked afterwards stay in the
+ * tuples and are skipped at lookup time. Inexact policies linked
+ * afterwards are appended to a short per direction list that is searched
+ * linearly, both in the published classifier and in the one being built,
+ * so a build that raced with new policies can still be installed. A
+ * direction whose list overflowed falls back to the inexact bins until
+ * the next build, which every link schedules at most XFRM_POL_CLS_DELAY
+ * ahead.
+ * Rebuilding the inexact bins (xfrm_hash_rebuild()) bumps policy_cls_gen
+ * and invalidates the classifier as a whole.
+ */
+#define XFRM_POL_CLS_DELAY	(HZ / 10)
+#define XFRM_POL_CLS_ADDED	32
+
+struct xfrm_pol_cls_key {
+	xfrm_address_t			daddr;
+	xfrm_address_t			saddr;
+	u32				if_id;
+	__be16				dport;
+	__be16				sport;
+	u8				proto;
+	u8				type;
+	u16				pad;
+};
+
+struct xfrm_pol_cls_entry {
+	struct xfrm_pol_cls_entry	*next;
+	struct xfrm_policy		*pol;
+	struct xfrm_pol_cls_key		key;
+};
+
+struct xfrm_pol_cls_tuple {
+	/* priority of the best policy in this tuple */
+	u32				min_priority;
+	u16				family;
+	u8				prefixlen_d;
+	u8				prefixlen_s;
+	u8				proto_mask;
+	__be16				dport_mask;
+	__be16				sport_mask;
+	unsigned int			count;
+	unsigned int			hmask;
+	/* chains are sorted by priority and position, like policy_inexact */
+	struct xfrm_pol_cls_entry	**table;
+};
+
+struct xfrm_pol_cls {
+	unsigned int			gen;
+	/* inexact policies linked after the snapshot, XFRM_POL_CLS_ADDED + 1
+	 * once the list overflowed
+	 */
+	unsigned int			nr_added[XFRM_POLICY_MAX];
+	struct xfrm_policy		*added[XFRM_POLICY_MAX][XFRM_POL_CLS_ADDED];
+	/* policies[first[dir]] .. policies[first[dir + 1] - 1] */
+	unsigned int			first[XFRM_POLICY_MAX + 1];
+	struct xfrm_policy		**policies;
+	struct xfrm_pol_cls_entry	*entries;
+	unsigned int			nr_tuples[XFRM_POLICY_MAX];
+	struct xfrm_pol_cls_tuple	*tuples[XFRM_POLICY_MAX];
+};
+
+static void xfrm_pol_cls_changed(struct net *net)
+{
+	lockdep_assert_held(&net->xfrm.xfrm_policy_lock);
+
+	WRITE_ONCE(net->xfrm.policy_cls_gen, net->xfrm.policy_cls_gen + 1);
+	schedule_delayed_work(&net->xfrm.policy_cls_work, XFRM_POL_CLS_DELAY);
+}
+
+static void xfrm_pol_cls_add(struct xfrm_pol_cls *cls,
+			     struct xfrm_policy *pol, int dir)
+{
+	unsigned int n = cls->nr_added[dir];
+
+	if (n > XFRM_POL_CLS_ADDED)
+		return;
+	if (n < XFRM_POL_CLS_ADDED) {
+		xfrm_pol_hold(pol);
+		cls->added[dir][n] = pol;
+	}
+	/* Paired with smp_load_acquire() in xfrm_policy_lookup_bytype() */
+	smp_store_release(&cls->nr_added[dir], n + 1);
+}
+
+/* An inexact policy was linked: make it visible to the classifier in use
+ * and to the one being built, and fold it into the tuples later on.
+ */
+static void xfrm_pol_cls_link(struct net *net, struct xfrm_policy *pol,
+			      int dir)
+{
+	struct xfrm_pol_cls *cls;
+
+	lockdep_assert_held(&net->xfrm.xfrm_policy_lock);
+
+	cls = rcu_dereference_protected(net->xfrm.policy_cls,
+				lockdep_is_held(&net->xfrm.xfrm_policy_lock));
+	if (cls)
+		xfrm_pol_cls_add(cls, pol, dir);
+	if (net->xfrm.policy_cls_next)
+		xfrm_pol_cls_add(net->xfrm.policy_cls_next, pol, dir);
+	schedule_delayed_work(&net->xfrm.policy_cls_work, XFRM_POL_CLS_DELAY);
+}
+
+static bool xfrm_pol_cls_unlinked(const struct xfrm_policy *pol)
+{
+	return READ_ONCE(pol->walk.dead) || list_empty(&pol->walk.all);
+}
+
+static void xfrm_pol_cls_mask_addr(xfrm_address_t *dst,
+				   const xfrm_address_t *addr,
+				   u8 prefixlen, u16 family)
+{
+	unsigned int bits, i;
+
+	memset(dst, 0, sizeof(*dst));
+
+	switch (family) {
+	case AF_INET:
+		if (prefixlen)
+			dst->a4 = addr->a4 & htonl(~0U << (32 - prefixlen));
+		break;
+	case AF_INET6:
+		for (i = 0; i < ARRAY_SIZE(dst->a6) && prefixlen; i++) {
+			bits = min_t(unsigned int, prefixlen, 32);
+			dst->a6[i] = addr->a6[i] & htonl(~0U << (32 - bits));
+			prefixlen -= bits;
+		}
+		break;
+	}
+}
+
+static u32 xfrm_pol_cls_hash(const struct xfrm_pol_cls_key *key)
+{
+	return jhash2((const u32 *)key, sizeof(*key) / sizeof(u32), 0);
+}
+
+static void xfrm_pol_cls_tuple_init(struct xfrm_pol_cls_tuple *t,
+				    const struct xfrm_policy *pol)
+{
+	const struct xfrm_selector *sel = &pol->selector;
+	u8 max = pol->family == AF_INET ? 32 : 128;
+
+	memset(t, 0, sizeof(*t));
+	t->min_priority = pol->priority;
+	t->family = pol->family;
+	t->prefixlen_d = min(sel->prefixlen_d, max);
+	t->prefixlen_s = min(sel->prefixlen_s, max);
+	t->proto_mask = sel->proto ? 0xff : 0;
+	t->dport_mask = sel->dport_mask;
+	t->sport_mask = sel->sport_mask;
+}
+
+static bool xfrm_pol_cls_tuple_eq(const struct xfrm_pol_cls_tuple *a,
+				  const struct xfrm_pol_cls_tuple *b)
+{
+	return a->family == b->family &&
+	       a->prefixlen_d == b->prefixlen_d &&
+	       a->prefixlen_s == b->prefixlen_s &&
+	       a->proto_mask == b->proto_mask &&
+	       a->dport_mask == b->dport_mask &&
+	       a->sport_mask == b->sport_mask;
+}
+
+static int xfrm_pol_cls_tuple_cmp(const void *a, const void *b)
+{
+	const struct xfrm_pol_cls_tuple *ta = a, *tb = b;
+
+	if (ta->min_priority != tb->min_priority)
+		return ta->min_priority < tb->min_priority ? -1 : 1;
+	return 0;
+}
+
+static void xfrm_pol_cls_free(struct xfrm_pol_cls *cls)
+{
+	unsigned int i, n;
+	int dir;
+
+	if (!cls)
+		return;
+
+	for (dir = 0; dir < XFRM_POLICY_MAX; dir++) {
+		for (i = 0; i < cls->nr_tuples[dir]; i++)
+			kvfree(cls->tuples[dir][i].table);
+		kfree(cls->tuples[dir]);
+	}
+	for (dir = 0; dir < XFRM_POLICY_MAX; dir++) {
+		n = min_t(unsigned int, cls->nr_added[dir], XFRM_POL_CLS_ADDED);
+		for (i = 0; i < n; i++)
+			xfrm_pol_put(cls->added[dir][i]);
+	}
+	for (i = 0; i < cls->first[XFRM_POLICY_MAX]; i++)
+		xfrm_pol_put(cls->policies[i]);
+	kvfree(cls->policies);
+	kvfree(cls->entries);
+	kfree(cls);
+}
+
+static unsigned int xfrm_pol_cls_count(struct net *net)
+{
+	unsigned int n;
+	int dir;
+
+	for (n = 0, dir = 0; dir < XFRM_POLICY_MAX; dir++)
+		n += net->xfrm.policy_count[dir];
+	return n;
+}
+
+/* Take a reference on all the inexact policies, in lookup order, and
+ * register the new classifier as policy_cls_next so that policies linked
+ * from now on are added to it.
+ */
+static struct xfrm_pol_cls *xfrm_pol_cls_snapshot(struct net *net)
+{
+	struct xfrm_policy *pol;
+	struct xfrm_pol_cls *cls;
+	unsigned int n, i;
+	int dir;
+
+	cls = kzalloc(sizeof(*cls), GFP_KERNEL);
+	if (!cls)
+		return NULL;
+
+	spin_lock_bh(&net->xfrm.xfrm_policy_lock);
+	n = xfrm_pol_cls_count(net);
+	spin_unlock_bh(&net->xfrm.xfrm_policy_lock);
+
+	for (;;) {
+		cls->policies = kvmalloc_array(max(n, 1U),
+					       sizeof(*cls->policies),
+					       GFP_KERNEL);
+		cls->entries = kvmalloc_array(max(n, 1U),
+					      sizeof(*cls->entries),
+					      GFP_KERNEL);
+		if (!cls->policies || !cls->entries)
+			goto err;
+
+		spin_lock_bh(&net->xfrm.xfrm_policy_lock);
+		i = xfrm_pol_cls_count(net);
+		if (i <= n)
+			break;
+		spin_unlock_bh(&net->xfrm.xfrm_policy_lock);
+
+		kvfree(cls->policies);
+		kvfree(cls->entries);
+		n = i;
+	}
+
+	i = 0;
+	for (dir = 0; dir < XFRM_POLICY_MAX; dir++) {
+		cls->first[dir] = i;
+		hlist_for_each_entry(pol, &net->xfrm.policy_inexact[dir],
+				     bydst_inexact_list) {
+			if (WARN_ON_ONCE(i == n))
+				break;
+			xfrm_pol_hold(pol);
+			cls->policies[i++] = pol;
+		}
+	}
+	cls->first[XFRM_POLICY_MAX] = i;
+	cls->gen = net->xfrm.policy_cls_gen;
+	WARN_ON_ONCE(net->xfrm.policy_cls_next);
+	net->xfrm.policy_cls_next = cls;
+	spin_unlock_bh(&net->xfrm.xfrm_policy_lock);
+
+	return cls;
+
+err:
+	xfrm_pol_cls_free(cls);
+	return NULL;
+}
+
+static void xfrm_pol_cls_sel_key(struct xfrm_pol_cls_key *key,
+				 const struct xfrm_policy *pol,
+				 const struct xfrm_pol_cls_tuple *t)
+{
+	const struct xfrm_selector *sel = &pol->selector;
+
+	memset(key, 0, sizeof(*key));
+	xfrm_pol_cls_mask_addr(&key->daddr, &sel->daddr, t->prefixlen_d,
+			       t->family);
+	xfrm_pol_cls_mask_addr(&key->saddr, &sel->saddr, t->prefixlen_s,
+			       t->family);
+	key->if_id = pol->if_id;
+	key->dport = sel->dport & t->dport_mask;
+	key->sport = sel->sport & t->sport_mask;
+	key->proto = sel->proto & t->proto_mask;
+	key->type = pol->type;
+}
+
+static int xfrm_pol_cls_compile_dir(struct xfrm_pol_cls *cls, int dir)
+{
+	unsigned int first = cls->first[dir], last = cls->first[dir + 1];
+	struct xfrm_pol_cls_tuple *t, *tuples = NULL, tmp;
+	unsigned int i, j, nr = 0, size = 0;
+	struct xfrm_pol_cls_entry *e;
+	u32 *idx;
+
+	if (first == last)
+		return 0;
+
+	idx = kvmalloc_array(last - first, sizeof(*idx), GFP_KERNEL);
+	if (!idx)
+		return -ENOMEM;
+
+	/* the policies are sorted by priority, so the first policy of a
+	 * tuple sets its min_priority
+	 */
+	for (i = first; i < last; i++) {
+		xfrm_pol_cls_tuple_init(&tmp, cls->policies[i]);
+		for (j = 0; j < nr; j++)
+			if (xfrm_pol_cls_tuple_eq(&tuples[j], &tmp))
+				break;
+
+		if (j == nr) {
+			if (nr == size) {
+				size = size ? size * 2 : 8;
+				t = krealloc_array(tuples, size, sizeof(*t),
+						   GFP_KERNEL);
+				if (!t)
+					goto err;
+				tuples = t;
+				cls->tuples[dir] = tuples;
+			}
+			tuples[nr] = tmp;
+			cls->nr_tuples[dir] = ++nr;
+		}
+		tuples[j].count++;
+		idx[i - first] = j;
+	}
+
+	for (j = 0; j < nr; j++) {
+		t = &tuples[j];
+		t->hmask = roundup_pow_of_two(t->count) - 1;
+		t->table = kvcalloc(t->hmask + 1, sizeof(*t->table),
+				    GFP_KERNEL);
+		if (!t->table)
+			goto err;
+	}
+
+	/* insert backwards so that the chains end up in lookup order */
+	for (i = last; i-- > first; ) {
+		t = &tuples[idx[i - first]];
+		e = &cls->entries[i];
+		e->pol = cls->policies[i];
+		xfrm_pol_cls_sel_key(&e->key, e->pol, t);
+		j = xfrm_pol_cls_hash(&e->key) & t->hmask;
+		e->next = t->table[j];
+		t->table[j] = e;
+	}
+
+	sort(tuples, nr, sizeof(*tuples), xfrm_pol_cls_tuple_cmp, NULL);
+	kvfree(idx);
+	return 0;
+
+err:
+	kvfree(idx);
+	return -ENOMEM;
+}
+
+static void xfrm_pol_cls_work(struct work_struct *work)
+{
+	struct net *net = container_of(work, struct net,
+				       xfrm.policy_cls_work.work);
+	struct xfrm_pol_cls *cls, *old = NULL;
+	int dir, err = 0;
+
+	cls = xfrm_pol_cls_snapshot(net);
+	if (!cls)
+		return;
+
+	for (dir = 0; dir < XFRM_POLICY_MAX && !err; dir++)
+		err = xfrm_pol_cls_compile_dir(cls, dir);
+
+	/* Policies linked during the build are on the added lists of the new
+	 * classifier, which is installed even if some of those overflowed:
+	 * the affected directions use the inexact bins until the build that
+	 * the overflowing link scheduled.
+	 */
+	spin_lock_bh(&net->xfrm.xfrm_policy_lock);
+	net->xfrm.policy_cls_next = NULL;
+	if (!err && cls->gen == net->xfrm.policy_cls_gen) {
+		old = rcu_replace_pointer(net->xfrm.policy_cls, cls,
+				lockdep_is_held(&net->xfrm.xfrm_policy_lock));
+		cls = NULL;
+	}
+	spin_unlock_bh(&net->xfrm.xfrm_policy_lock);
+
+	if (old) {
+		synchronize_rcu();
+		xfrm_pol_cls_free(old);
+	}
+	xfrm_pol_cls_free(cls);
+}
+
+/* Returns the best inexact policy matching @fl if it is preferred over
+ * @prefer, NULL otherwise. Called under rcu_read_lock().
+ */
+static struct xfrm_policy *
+xfrm_pol_cls_lookup(const struct xfrm_pol_cls *cls, struct xfrm_policy *prefer,
+		    const struct flowi *fl, u8 type, u16 family, u8 dir,
+		    u32 if_id)
+{
+	u32 priority = prefer ? prefer->priority : ~0U;
+	struct xfrm_policy *pol, *cur = prefer, *best = NULL;
+	const xfrm_address_t *daddr, *saddr;
+	const struct xfrm_pol_cls_tuple *t;
+	const struct xfrm_pol_cls_entry *e;
+	const union flowi_uli *uli;
+	struct xfrm_pol_cls_key key;
+	__be16 dport, sport;
+	unsigned int i, n;
+	int err;
+
+	daddr = xfrm_flowi_daddr(fl, family);
+	saddr = xfrm_flowi_saddr(fl, family);
+	uli = family == AF_INET ? &fl->u.ip4.uli : &fl->u.ip6.uli;
+	dport = xfrm_flowi_dport(fl, uli);
+	sport = xfrm_flowi_sport(fl, uli);
+
+	for (i = 0; i < cls->nr_tuples[dir]; i++) {
+		t = &cls->tuples[dir][i];
+		if (t->min_priority > priority)
+			break;
+		if (t->family != family)
+			continue;
+
+		memset(&key, 0, sizeof(key));
+		xfrm_pol_cls_mask_addr(&key.daddr, daddr, t->prefixlen_d,
+				       family);
+		xfrm_pol_cls_mask_addr(&key.saddr, saddr, t->prefixlen_s,
+				       family);
+		key.if_id = if_id;
+		key.dport = dport & t->dport_mask;
+		key.sport = sport & t->sport_mask;
+		key.proto = fl->flowi_proto & t->proto_mask;
+		key.type = type;
+
+		e = t->table[xfrm_pol_cls_hash(&key) & t->hmask];
+		for (; e; e = e->next) {
+			pol = e->pol;
+			if (pol->priority > priority)
+				break;
+			if (memcmp(&e->key, &key, sizeof(key)) ||
+			    xfrm_pol_cls_unlinked(pol))
+				continue;
+			/* same tie break as __xfrm_policy_eval_candidates() */
+			if (cur && pol->priority == cur->priority &&
+			    cur->pos < pol->pos)
+				break;
+
+			err = xfrm_policy_match(pol, fl, type, family, if_id);
+			if (err) {
+				if (err != -ESRCH)
+					return ERR_PTR(err);
+				continue;
+			}
+
+			best = cur = pol;
+			priority = pol->priority;
+			break;
+		}
+	}
+
+	n = min_t(unsigned int, smp_load_acquire(&cls->nr_added[dir]),
+		  XFRM_POL_CLS_ADDED);
+	for (i = 0; i < n; i++) {
+		pol = cls->added[dir][i];
+		if (pol->priority > priority || xfrm_pol_cls_unlinked(pol))
+			continue;
+		if (cur && pol->priority == cur->priority &&
+		    cur->pos < pol->pos)
+			continue;
+
+		err = xfrm_policy_match(pol, fl, type, family, if_id);
+		if (err) {
+			if (err != -ESRCH)
+				return ERR_PTR(err);
+			continue;
+		}
+
+		best = cur = pol;
+		priority = pol->priority;
+	}
+
+	return best;
+}
+
 static struct xfrm_policy *xfrm_policy_lookup_bytype(struct net *net, u8 type,
 						     const struct flowi *fl,
 						     u16 family, u8 dir,
@@ -2155,6 +2659,7 @@ static struct xfrm_policy *xfrm_policy_lookup_bytype(struct net *net, u8 type,
 	const xfrm_address_t *daddr, *saddr;
 	struct xfrm_pol_inexact_bin *bin;
 	struct xfrm_policy *pol, *ret;
+	struct xfrm_pol_cls *cls;
 	struct hlist_head *chain;
 	unsigned int sequence;
 	int err;
@@ -2189,13 +2694,23 @@ static struct xfrm_policy *xfrm_policy_lookup_bytype(struct net *net, u8 type,
 	if (ret && ret->xdo.type == XFRM_DEV_OFFLOAD_PACKET)
 		goto skip_inexact;
 
-	bin = xfrm_policy_inexact_lookup_rcu(net, type, family, dir, if_id);
-	if (!bin || !xfrm_policy_find_inexact_candidates(&cand, bin, saddr,
+	cls = rcu_dereference(net->xfrm.policy_cls);
+	if (cls && cls->gen == READ_ONCE(net->xfrm.policy_cls_gen) &&
+	    /* Paired with smp_store_release() in xfrm_pol_cls_add() */
+	    smp_load_acquire(&cls->nr_added[dir]) <= XFRM_POL_CLS_ADDED) {
+		pol = xfrm_pol_cls_lookup(cls, ret, fl, type, family, dir,
+					  if_id);
+	} else {
+		bin = xfrm_policy_inexact_lookup_rcu(net, type, family, dir,
+						     if_id);
+		if (!bin ||
+		    !xfrm_policy_find_inexact_candidates(&cand, bin, saddr,
 							 daddr))
-		goto skip_inexact;
+			goto skip_inexact;
 
-	pol = xfrm_policy_eval_candidates(&cand, ret, fl, type,
-					  family, if_id);
+		pol = xfrm_policy_eval_candidates(&cand, ret, fl, type,
+						  family, if_id);
+	}
 	if (pol) {
 		ret = pol;
 		if (IS_ERR(pol))
@@ -2280,6 +2795,8 @@ static void __xfrm_policy_link(struct xfrm_policy *pol, int dir)
 	list_add(&pol->walk.all, &net->xfrm.policy_all);
 	net->xfrm.policy_count[dir]++;
 	xfrm_pol_hold(pol);
+	if (dir < XFRM_POLICY_MAX && !hlist_unhashed(&pol->bydst_inexact_list))
+		xfrm_pol_cls_link(net, pol, dir);
 }
 
 static struct xfrm_policy *__xfrm_policy_unlink(struct xfrm_policy *pol,
@@ -2299,6 +2816,12 @@ static struct xfrm_policy *__xfrm_policy_unlink(struct xfrm_policy *pol,
 
 	list_del_init(&pol->walk.all);
 	net->xfrm.policy_count[dir]--;
+	/* the classifier skips unlinked policies, just drop the reference
+	 * it holds with the next build
+	 */
+	if (dir < XFRM_POLICY_MAX)
+		schedule_delayed_work(&net->xfrm.policy_cls_work,
+				      XFRM_POL_CLS_DELAY);
 
 	return pol;
 }
@@ -4153,6 +4676,7 @@ static int __net_init xfrm_policy_init(struct net *net)
 	INIT_LIST_HEAD(&net->xfrm.inexact_bins);
 	INIT_WORK(&net->xfrm.policy_hash_work, xfrm_hash_resize);
 	INIT_WORK(&net->xfrm.policy_hthresh.work, xfrm_hash_rebuild);
+	INIT_DELAYED_WORK(&net->xfrm.policy_cls_work, xfrm_pol_cls_work);
 	return 0;
 
 out_bydst:
@@ -4179,6 +4703,10 @@ static void xfrm_policy_fini(struct net *net)
 #endif
 	xfrm_policy_flush(net, XFRM_POLICY_TYPE_MAIN, false);
 
+	cancel_delayed_work_sync(&net->xfrm.policy_cls_work);
+	xfrm_pol_cls_free(rcu_dereference_protected(net->xfrm.policy_cls, 1));
+	RCU_INIT_POINTER(net->xfrm.policy_cls, NULL);
+
 	WARN_ON(!list_empty(&net->xfrm.policy_all));
 
 	for (dir = 0; dir < XFRM_POLICY_MAX; dir++) {
@@ -7,21 +7,37 @@
  */
 
 #include <linux/export.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
 #include <net/xfrm.h>
 
+#include "xfrm_state_priv.h"
+
 u32 xfrm_replay_seqhi(struct xfrm_state *x, __be32 net_seq)
 {
-	u32 seq, seq_hi, bottom;
+	u32 seq, seq_hi, bottom, top, wsize;
 	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
+	struct xfrm_replay_window *rwin = xfrm_state_priv(x)->rwin;
 
 	if (!(x->props.flags & XFRM_STATE_ESN))
 		return 0;
 
+	if (rwin) {
+		u64 top64 = atomic64_read(&rwin->top);
+
+		top = lower_32_bits(top64);
+		seq_hi = upper_32_bits(top64);
+		wsize = READ_ONCE(rwin->size);
+	} else {
+		top = replay_esn->seq;
+		seq_hi = replay_esn->seq_hi;
+		wsize = replay_esn->replay_window;
+	}
+
 	seq = ntohl(net_seq);
-	seq_hi = replay_esn->seq_hi;
-	bottom = replay_esn->seq - replay_esn->replay_window + 1;
+	bottom = top - wsize + 1;
 
-	if (likely(replay_esn->seq >= replay_esn->replay_window - 1)) {
+	if (likely(top >= wsize - 1)) {
 		/* A. same subspace */
 		if (unlikely(seq < bottom))
 			seq_hi++;
@@ -359,6 +375,7 @@ static void xfrm_replay_notify_esn(struct xfrm_state *x, int event)
 	struct km_event c;
 	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
 	struct xfrm_replay_state_esn *preplay_esn = x->preplay_esn;
+	struct xfrm_replay_window *rwin = xfrm_state_priv(x)->rwin;
 
 	/* we send notify messages in case
 	 *  1. we updated on of the sequence numbers, and the seqno difference
@@ -370,6 +387,13 @@ static void xfrm_replay_notify_esn(struct xfrm_state *x, int event)
 	 *  The state structure must be locked!
 	 */
 
+	if (rwin) {
+		u64 top = atomic64_read(&rwin->top);
+
+		replay_esn->seq = lower_32_bits(top);
+		replay_esn->seq_hi = upper_32_bits(top);
+	}
+
 	switch (event) {
 	case XFRM_REPLAY_UPDATE:
 		if (x->replay_maxdiff) {
@@ -399,6 +423,8 @@ static void xfrm_replay_notify_esn(struct xfrm_state *x, int event)
 		break;
 
 	case XFRM_REPLAY_TIMEOUT:
+		if (rwin)
+			xfrm_replay_esn_snapshot(x, replay_esn);
 		if (memcmp(x->replay_esn, x->preplay_esn,
 			   xfrm_replay_state_esn_len(replay_esn)) == 0) {
 			x->xflags |= XFRM_TIME_DEFER;
@@ -408,6 +434,8 @@ static void xfrm_replay_notify_esn(struct xfrm_state *x, int event)
 		break;
 	}
 
+	if (rwin)
+		xfrm_replay_esn_snapshot(x, replay_esn);
 	memcpy(x->preplay_esn, x->replay_esn,
 	       xfrm_replay_state_esn_len(replay_esn));
 	c.event = XFRM_MSG_NEWAE;
@@ -448,6 +476,119 @@ static int xfrm_replay_overflow_esn(struct xfrm_state *x, struct sk_buff *skb)
 	return err;
 }
 
+static atomic64_t *xfrm_replay_window_slot(struct xfrm_replay_window *rwin,
+					   u64 seq)
+{
+	return &rwin->slots[(seq >> 5) & rwin->mask];
+}
+
+static bool xfrm_replay_window_test(struct xfrm_replay_window *rwin, u64 seq)
+{
+	u64 v = atomic64_read(xfrm_replay_window_slot(rwin, seq));
+
+	return upper_32_bits(v) == (u32)(seq >> 5) && (v & BIT_ULL(seq & 0x1F));
+}
+
+/* Move the slots of the blocks in (@from, @to] to those blocks, unless a
+ * packet got there first.  This keeps every tag within one lap of the top,
+ * so that tags compare as signed 32-bit distances.
+ */
+static void xfrm_replay_window_retag(struct xfrm_replay_window *rwin,
+				     u64 from, u64 to)
+{
+	u64 block = (from >> 5) + 1, last = to >> 5;
+
+	if (last < block)
+		return;
+	if (last - block > rwin->mask)
+		block = last - rwin->mask;
+
+	for (; block <= last; block++) {
+		atomic64_t *slot = &rwin->slots[block & rwin->mask];
+		s64 old = atomic64_read(slot);
+
+		while ((s32)(upper_32_bits(old) - (u32)block) < 0 &&
+		       !atomic64_try_cmpxchg(slot, &old, (u64)block << 32))
+			;
+	}
+}
+
+/* Mark @seq as received.  Returns -ERANGE if it is below the window and
+ * -EEXIST if it was already received.
+ */
+static int xfrm_replay_window_set(struct xfrm_replay_window *rwin,
+				  u32 wsize, u64 seq)
+{
+	atomic64_t *slot = xfrm_replay_window_slot(rwin, seq);
+	s64 top = atomic64_read(&rwin->top);
+	u64 bit = BIT_ULL(seq & 0x1F);
+	u32 block = seq >> 5;
+	s64 old, new;
+
+	if (seq <= top && top - seq >= wsize)
+		return -ERANGE;
+
+	old = atomic64_read(slot);
+	do {
+		s32 ahead = upper_32_bits(old) - block;
+
+		if (ahead > 0)
+			/* recycled for a later block, we left the window */
+			return -ERANGE;
+		if (ahead < 0) {
+			new = ((u64)block << 32) | bit;
+		} else {
+			if (old & bit)
+				return -EEXIST;
+			new = old | bit;
+		}
+	} while (!atomic64_try_cmpxchg(slot, &old, new));
+
+	while (seq > top) {
+		if (atomic64_try_cmpxchg(&rwin->top, &top, seq)) {
+			xfrm_replay_window_retag(rwin, top, seq);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int xfrm_replay_check_window(struct xfrm_state *x,
+				    struct xfrm_replay_window *rwin,
+				    struct sk_buff *skb, __be32 net_seq)
+{
+	u32 wsize = READ_ONCE(rwin->size);
+	u64 top, seq;
+
+	if (!wsize)
+		return 0;
+
+	top = atomic64_read(&rwin->top);
+	seq = ((u64)xfrm_replay_seqhi(x, net_seq) << 32) | ntohl(net_seq);
+	if (unlikely(!seq))
+		goto err;
+
+	if (likely(seq > top))
+		return 0;
+
+	if (top - seq >= wsize) {
+		x->stats.replay_window++;
+		goto err;
+	}
+
+	if (xfrm_replay_window_test(rwin, seq)) {
+		x->stats.replay++;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	xfrm_audit_state_replay(x, skb, net_seq);
+	return -EINVAL;
+}
+
 static int xfrm_replay_check_esn(struct xfrm_state *x,
 				 struct sk_buff *skb, __be32 net_seq)
 {
@@ -459,6 +600,10 @@ static int xfrm_replay_check_esn(struct xfrm_state *x,
 	u32 wsize = replay_esn->replay_window;
 	u32 top = replay_esn->seq;
 	u32 bottom = top - wsize + 1;
+	struct xfrm_replay_window *rwin = xfrm_state_priv(x)->rwin;
+
+	if (rwin)
+		return xfrm_replay_check_window(x, rwin, skb, net_seq);
 
 	if (!wsize)
 		return 0;
@@ -608,6 +753,65 @@ static void xfrm_replay_advance_esn(struct xfrm_state *x, __be32 net_seq)
 		xfrm_replay_notify(x, XFRM_REPLAY_UPDATE);
 }
 
+/* Recheck and advance the window of an ESN state with an atomic window,
+ * without x->lock.  Two CPUs can't both accept the same sequence number.
+ */
+int xfrm_replay_advance_lockless(struct xfrm_state *x,
+				 struct sk_buff *skb, __be32 net_seq)
+{
+	struct xfrm_replay_window *rwin = xfrm_state_priv(x)->rwin;
+	u32 seq_hi = ntohl(XFRM_SKB_CB(skb)->seq.input.hi);
+	u32 wsize = READ_ONCE(rwin->size);
+	u64 seq;
+
+	if (unlikely(seq_hi != xfrm_replay_seqhi(x, net_seq))) {
+		x->stats.replay_window++;
+		return -EINVAL;
+	}
+
+	if (!wsize)
+		return 0;
+
+	seq = ((u64)seq_hi << 32) | ntohl(net_seq);
+	if (unlikely(!seq))
+		goto err;
+
+	switch (xfrm_replay_window_set(rwin, wsize, seq)) {
+	case 0:
+		return 0;
+	case -ERANGE:
+		x->stats.replay_window++;
+		break;
+	default:
+		x->stats.replay++;
+		break;
+	}
+err:
+	xfrm_audit_state_replay(x, skb, net_seq);
+	return -EINVAL;
+}
+
+/* x->lock is held */
+int xfrm_replay_recheck_advance(struct xfrm_state *x,
+				struct sk_buff *skb, __be32 net_seq)
+{
+	int err;
+
+	if (xfrm_state_priv(x)->rwin) {
+		err = xfrm_replay_advance_lockless(x, skb, net_seq);
+		if (!err && xfrm_aevent_is_on(xs_net(x)))
+			xfrm_replay_notify(x, XFRM_REPLAY_UPDATE);
+		return err;
+	}
+
+	err = xfrm_replay_recheck(x, skb, net_seq);
+	if (err)
+		return err;
+
+	xfrm_replay_advance(x, net_seq);
+	return 0;
+}
+
 #ifdef CONFIG_XFRM_OFFLOAD
 static int xfrm_replay_overflow_offload(struct xfrm_state *x, struct sk_buff *skb)
 {
@@ -793,3 +997,105 @@ int xfrm_init_replay(struct xfrm_state *x, struct netlink_ext_ack *extack)
 	return 0;
 }
 EXPORT_SYMBOL(xfrm_init_replay);
+
+/* Switch an ESN state that isn't offloaded over to the atomic replay window,
+ * before it gets hashed.  It stays on the locked one if that fails.
+ */
+void xfrm_replay_window_init(struct xfrm_state *x)
+{
+	struct xfrm_state_priv *priv = xfrm_state_priv(x);
+	struct xfrm_replay_window *rwin;
+	unsigned int nslots;
+
+	if (x->repl_mode != XFRM_REPLAY_MODE_ESN || x->xso.dev || priv->rwin)
+		return;
+
+	/* room for the largest window the bitmap allows, plus one block */
+	nslots = roundup_pow_of_two(x->replay_esn->bmp_len + 1);
+	rwin = kzalloc(struct_size(rwin, slots, nslots), GFP_ATOMIC);
+	if (!rwin)
+		return;
+
+	rwin->mask = nslots - 1;
+	priv->rwin = rwin;
+	xfrm_replay_window_load(x);
+}
+
+/* Reset the atomic window from x->replay_esn, after userspace set it */
+void xfrm_replay_window_load(struct xfrm_state *x)
+{
+	struct xfrm_replay_window *rwin = xfrm_state_priv(x)->rwin;
+	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
+	u32 wsize = replay_esn->replay_window;
+	u32 diff, pos, bitnr;
+	u64 top, block;
+	unsigned int i;
+
+	if (!rwin)
+		return;
+
+	top = ((u64)replay_esn->seq_hi << 32) | replay_esn->seq;
+	block = top >> 5;
+	for (i = 0; i <= rwin->mask; i++)
+		atomic64_set(&rwin->slots[i],
+			     (block - ((block - i) & rwin->mask)) << 32);
+	WRITE_ONCE(rwin->size, wsize);
+	atomic64_set(&rwin->top, top);
+
+	if (!wsize)
+		return;
+
+	pos = (replay_esn->seq - 1) % wsize;
+	for (diff = 0; diff < wsize && diff < top; diff++) {
+		if (pos >= diff)
+			bitnr = (pos - diff) % wsize;
+		else
+			bitnr = wsize - (diff - pos);
+
+		if (replay_esn->bmp[bitnr >> 5] & (1U << (bitnr & 0x1F)))
+			atomic64_or(BIT_ULL((top - diff) & 0x1F),
+				    xfrm_replay_window_slot(rwin, top - diff));
+	}
+}
+EXPORT_SYMBOL(xfrm_replay_window_load);
+
+/* Copy x->replay_esn to @dst with the sequence number and bitmap of the
+ * atomic window, if there is one.  @dst may be x->replay_esn itself, which
+ * then needs x->lock.
+ */
+void xfrm_replay_esn_snapshot(struct xfrm_state *x,
+			      struct xfrm_replay_state_esn *dst)
+{
+	struct xfrm_replay_window *rwin = xfrm_state_priv(x)->rwin;
+	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
+	u32 wsize = replay_esn->replay_window;
+	u32 diff, pos, bitnr;
+	u64 top;
+
+	if (dst != replay_esn)
+		memcpy(dst, replay_esn, xfrm_replay_state_esn_len(replay_esn));
+	if (!rwin)
+		return;
+
+	top = atomic64_read(&rwin->top);
+	dst->seq = lower_32_bits(top);
+	dst->seq_hi = upper_32_bits(top);
+	memset(dst->bmp, 0, dst->bmp_len * sizeof(__u32));
+
+	if (!wsize)
+		return;
+
+	pos = (dst->seq - 1) % wsize;
+	for (diff = 0; diff < wsize && diff < top; diff++) {
+		if (!xfrm_replay_window_test(rwin, top - diff))
+			continue;
+
+		if (pos >= diff)
+			bitnr = (pos - diff) % wsize;
+		else
+			bitnr = wsize - (diff - pos);
+
+		dst->bmp[bitnr >> 5] |= 1U << (bitnr & 0x1F);
+	}
+}
+EXPORT_SYMBOL(xfrm_replay_esn_snapshot);
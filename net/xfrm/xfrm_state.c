@@ -27,10 +27,12 @@
 #include <linux/slab.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
+#include <linux/hash.h>
 
 #include <crypto/aead.h>
 
 #include "xfrm_hash.h"
+#include "xfrm_state_priv.h"
 
 #define xfrm_state_deref_prot(table, net) \
 	rcu_dereference_protected((table), lockdep_is_held(&(net)->xfrm.xfrm_state_lock))
@@ -50,6 +52,33 @@ static struct kmem_cache *xfrm_state_cache __ro_after_init;
 static DECLARE_WORK(xfrm_state_gc_work, xfrm_state_gc_task);
 static HLIST_HEAD(xfrm_state_gc_list);
 
+/* Per-CPU cache of the last states returned by xfrm_state_lookup(), indexed
+ * by SPI. Any change to the byspi chains bumps xfrm_state_lookup_gen, which
+ * invalidates all the slots: a slot with the current generation therefore
+ * refers to a state that is still hashed, and to the one the chain walk
+ * would return for the same key and mark.
+ */
+#define XFRM_STATE_LOOKUP_CACHE_BITS	4
+
+struct xfrm_state_lookup_slot {
+	struct xfrm_state	*x;
+	const struct net	*net;
+	unsigned int		gen;
+	u32			mark;
+};
+
+struct xfrm_state_lookup_cache {
+	struct xfrm_state_lookup_slot	slots[1 << XFRM_STATE_LOOKUP_CACHE_BITS];
+};
+
+static DEFINE_PER_CPU(struct xfrm_state_lookup_cache, xfrm_state_lookup_cache);
+static atomic_t xfrm_state_lookup_gen;
+
+static inline void xfrm_state_lookup_invalidate(void)
+{
+	atomic_inc(&xfrm_state_lookup_gen);
+}
+
 static inline bool xfrm_state_hold_rcu(struct xfrm_state __rcu *x)
 {
 	return refcount_inc_not_zero(&x->refcnt);
@@ -515,7 +544,11 @@ static const struct xfrm_mode *xfrm_get_mode(unsigned int encap, int family)
 
 void xfrm_state_free(struct xfrm_state *x)
 {
-	kmem_cache_free(xfrm_state_cache, x);
+	struct xfrm_state_priv *priv = xfrm_state_priv(x);
+
+	kfree(priv->rwin);
+	free_percpu(priv->lft);
+	kmem_cache_free(xfrm_state_cache, priv);
 }
 EXPORT_SYMBOL(xfrm_state_free);
 
@@ -560,6 +593,77 @@ static void xfrm_state_gc_task(struct work_struct *work)
 		___xfrm_state_destroy(x);
 }
 
+/* Add what the per-CPU lifetime counters gained since the last call to
+ * x->curlft.  x->lock is held.
+ */
+static void xfrm_state_fold_curlft(struct xfrm_state *x)
+{
+	struct xfrm_state_priv *priv = xfrm_state_priv(x);
+	u64 bytes = 0, packets = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct xfrm_state_lft_pcpu *lft;
+		unsigned int start;
+		u64 b, p;
+
+		lft = per_cpu_ptr(priv->lft, cpu);
+		do {
+			start = u64_stats_fetch_begin(&lft->syncp);
+			b = u64_stats_read(&lft->bytes);
+			p = u64_stats_read(&lft->packets);
+		} while (u64_stats_fetch_retry(&lft->syncp, start));
+
+		bytes += b;
+		packets += p;
+	}
+
+	x->curlft.bytes += bytes - priv->lft_bytes;
+	x->curlft.packets += packets - priv->lft_packets;
+	priv->lft_bytes = bytes;
+	priv->lft_packets = packets;
+}
+
+#define XFRM_STATE_LFT_FOLD	256
+
+/* Account a packet of @len bytes to @x.  xfrm_state_check_expire() needs
+ * exact counters to enforce byte and packet limits, without limits they go
+ * to per-CPU counters that are folded in from the timer and every
+ * XFRM_STATE_LFT_FOLD packets per CPU.  BHs are disabled, x->lock is held if
+ * @locked.
+ */
+void xfrm_state_account(struct xfrm_state *x, unsigned int len, bool locked)
+{
+	struct xfrm_state_lft_pcpu *lft;
+	time64_t now;
+
+	now = ktime_get_real_seconds();
+	if (READ_ONCE(x->lastused) != now)
+		WRITE_ONCE(x->lastused, now);
+
+	if (locked && !xfrm_state_lft_unlimited(x)) {
+		x->curlft.bytes += len;
+		x->curlft.packets++;
+		return;
+	}
+
+	lft = this_cpu_ptr(xfrm_state_priv(x)->lft);
+	u64_stats_update_begin(&lft->syncp);
+	u64_stats_add(&lft->bytes, len);
+	u64_stats_inc(&lft->packets);
+	u64_stats_update_end(&lft->syncp);
+
+	if (u64_stats_read(&lft->packets) & (XFRM_STATE_LFT_FOLD - 1))
+		return;
+
+	if (locked) {
+		xfrm_state_fold_curlft(x);
+	} else if (spin_trylock(&x->lock)) {
+		xfrm_state_fold_curlft(x);
+		spin_unlock(&x->lock);
+	}
+}
+
 static enum hrtimer_restart xfrm_timer_handler(struct hrtimer *me)
 {
 	struct xfrm_state *x = container_of(me, struct xfrm_state, mtimer);
@@ -571,6 +675,7 @@ static enum hrtimer_restart xfrm_timer_handler(struct hrtimer *me)
 
 	spin_lock(&x->lock);
 	xfrm_dev_state_update_curlft(x);
+	xfrm_state_fold_curlft(x);
 
 	if (x->km.state == XFRM_STATE_DEAD)
 		goto out;
@@ -654,9 +759,22 @@ static void xfrm_replay_timer_handler(struct timer_list *t);
 
 struct xfrm_state *xfrm_state_alloc(struct net *net)
 {
-	struct xfrm_state *x;
+	struct xfrm_state_priv *priv;
+	struct xfrm_state *x = NULL;
+	int cpu;
 
-	x = kmem_cache_zalloc(xfrm_state_cache, GFP_ATOMIC);
+	priv = kmem_cache_zalloc(xfrm_state_cache, GFP_ATOMIC);
+	if (priv) {
+		priv->lft = alloc_percpu_gfp(struct xfrm_state_lft_pcpu,
+					     GFP_ATOMIC);
+		if (!priv->lft) {
+			kmem_cache_free(xfrm_state_cache, priv);
+			return NULL;
+		}
+		for_each_possible_cpu(cpu)
+			u64_stats_init(&per_cpu_ptr(priv->lft, cpu)->syncp);
+		x = &priv->x;
+	}
 
 	if (x) {
 		write_pnet(&x->xs_net, net);
@@ -712,8 +830,10 @@ int __xfrm_state_delete(struct xfrm_state *x)
 		hlist_del_rcu(&x->bysrc);
 		if (x->km.seq)
 			hlist_del_rcu(&x->byseq);
-		if (x->id.spi)
+		if (x->id.spi) {
 			hlist_del_rcu(&x->byspi);
+			xfrm_state_lookup_invalidate();
+		}
 		net->xfrm.state_num--;
 		spin_unlock(&net->xfrm.xfrm_state_lock);
 
@@ -1305,6 +1425,7 @@ xfrm_state_find(const xfrm_address_t *daddr, const xfrm_address_t *saddr,
 				XFRM_STATE_INSERT(byspi, &x->byspi,
 						  net->xfrm.state_byspi + h,
 						  x->xso.type);
+				xfrm_state_lookup_invalidate();
 			}
 			if (x->km.seq) {
 				h = xfrm_seq_hash(net, x->km.seq);
@@ -1419,6 +1540,8 @@ static void __xfrm_state_insert(struct xfrm_state *x)
 	struct net *net = xs_net(x);
 	unsigned int h;
 
+	xfrm_replay_window_init(x);
+
 	list_add(&x->km.all, &net->xfrm.state_all);
 
 	h = xfrm_dst_hash(net, &x->id.daddr, &x->props.saddr,
@@ -1436,6 +1559,7 @@ static void __xfrm_state_insert(struct xfrm_state *x)
 
 		XFRM_STATE_INSERT(byspi, &x->byspi, net->xfrm.state_byspi + h,
 				  x->xso.type);
+		xfrm_state_lookup_invalidate();
 	}
 
 	if (x->km.seq) {
@@ -1723,6 +1847,7 @@ static struct xfrm_state *xfrm_state_clone(struct xfrm_state *orig,
 	if (orig->replay_esn) {
 		if (xfrm_replay_clone(x, orig))
 			goto error;
+		xfrm_replay_esn_snapshot(orig, x->replay_esn);
 	}
 
 	memcpy(&x->mark, &orig->mark, sizeof(x->mark));
@@ -1898,6 +2023,8 @@ int xfrm_state_update(struct xfrm_state *x)
 		}
 		if (!use_spi && memcmp(&x1->sel, &x->sel, sizeof(x1->sel)))
 			memcpy(&x1->sel, &x->sel, sizeof(x1->sel));
+		/* limits may need exact counters from now on */
+		xfrm_state_fold_curlft(x1);
 		memcpy(&x1->lft, &x->lft, sizeof(x1->lft));
 		x1->km.dying = 0;
 
@@ -1961,11 +2088,33 @@ struct xfrm_state *
 xfrm_state_lookup(struct net *net, u32 mark, const xfrm_address_t *daddr, __be32 spi,
 		  u8 proto, unsigned short family)
 {
+	struct xfrm_state_lookup_slot *slot;
+	unsigned int gen;
 	struct xfrm_state *x;
 
+	local_bh_disable();
 	rcu_read_lock();
+	gen = atomic_read(&xfrm_state_lookup_gen);
+	slot = this_cpu_ptr(&xfrm_state_lookup_cache.slots[
+			hash_32((__force u32)spi, XFRM_STATE_LOOKUP_CACHE_BITS)]);
+	x = slot->x;
+	if (x && slot->gen == gen && slot->net == net && slot->mark == mark &&
+	    x->id.spi == spi && x->id.proto == proto &&
+	    x->props.family == family &&
+	    xfrm_addr_equal(&x->id.daddr, daddr, family) &&
+	    xfrm_state_hold_rcu(x))
+		goto out;
+
 	x = __xfrm_state_lookup(net, mark, daddr, spi, proto, family);
+	if (x) {
+		slot->x = x;
+		slot->net = net;
+		slot->gen = gen;
+		slot->mark = mark;
+	}
+out:
 	rcu_read_unlock();
+	local_bh_enable();
 	return x;
 }
 EXPORT_SYMBOL(xfrm_state_lookup);
@@ -2247,6 +2396,7 @@ int xfrm_alloc_spi(struct xfrm_state *x, u32 low, u32 high,
 		h = xfrm_spi_hash(net, &x->id.daddr, x->id.spi, x->id.proto, x->props.family);
 		XFRM_STATE_INSERT(byspi, &x->byspi, net->xfrm.state_byspi + h,
 				  x->xso.type);
+		xfrm_state_lookup_invalidate();
 		spin_unlock_bh(&net->xfrm.xfrm_state_lock);
 
 		err = 0;
@@ -2874,8 +3024,10 @@ int __net_init xfrm_state_init(struct net *net)
 	unsigned int sz;
 
 	if (net_eq(net, &init_net))
-		xfrm_state_cache = KMEM_CACHE(xfrm_state,
-					      SLAB_HWCACHE_ALIGN | SLAB_PANIC);
+		xfrm_state_cache = kmem_cache_create("xfrm_state",
+					sizeof(struct xfrm_state_priv),
+					__alignof__(struct xfrm_state_priv),
+					SLAB_HWCACHE_ALIGN | SLAB_PANIC, NULL);
 
 	INIT_LIST_HEAD(&net->xfrm.state_all);
 
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _XFRM_STATE_PRIV_H
+#define _XFRM_STATE_PRIV_H
+
+#include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
+#include <net/xfrm.h>
+
+/* Inbound ESN replay window that CPUs check and advance with cmpxchg rather
+ * than under x->lock.  Each slot covers 32 consecutive sequence numbers: the
+ * upper half holds the low 32 bits of the block number (seq >> 5), the lower
+ * half the bitmap of the block.  There is at least one slot more than the
+ * window needs, so a slot is only recycled for a block that has left the
+ * window.  The seq, seq_hi and bmp of x->replay_esn are only brought up to
+ * date by xfrm_replay_esn_snapshot().
+ */
+struct xfrm_replay_window {
+	atomic64_t	top;	/* highest 64-bit sequence number accepted */
+	u32		size;	/* replay_window */
+	u32		mask;	/* number of slots - 1 */
+	atomic64_t	slots[];
+};
+
+/* Lifetime bytes and packets accounted without x->lock, folded into
+ * x->curlft by xfrm_state_fold_curlft().
+ */
+struct xfrm_state_lft_pcpu {
+	u64_stats_t		bytes;
+	u64_stats_t		packets;
+	struct u64_stats_sync	syncp;
+};
+
+/* What xfrm_state_alloc() actually allocates */
+struct xfrm_state_priv {
+	struct xfrm_state		x;
+	struct xfrm_state_lft_pcpu __percpu *lft;
+	/* per-CPU sums already added to x.curlft, under x.lock */
+	u64				lft_bytes;
+	u64				lft_packets;
+	/* NULL unless the state is ESN and not offloaded */
+	struct xfrm_replay_window	*rwin;
+};
+
+static inline struct xfrm_state_priv *xfrm_state_priv(const struct xfrm_state *x)
+{
+	return container_of(x, struct xfrm_state_priv, x);
+}
+
+static inline bool xfrm_state_lft_unlimited(const struct xfrm_state *x)
+{
+	return x->lft.soft_byte_limit == XFRM_INF &&
+	       x->lft.soft_packet_limit == XFRM_INF &&
+	       x->lft.hard_byte_limit == XFRM_INF &&
+	       x->lft.hard_packet_limit == XFRM_INF;
+}
+
+/* The input path doesn't need x->lock when the replay window is atomic,
+ * xfrm_state_check_expire() has nothing to do (use time set, no byte or
+ * packet limits) and no one listens to replay events.
+ */
+static inline bool xfrm_state_input_lockless(const struct xfrm_state *x)
+{
+	return xfrm_state_priv(x)->rwin &&
+	       READ_ONCE(x->curlft.use_time) &&
+	       xfrm_state_lft_unlimited(x) &&
+	       !xfrm_aevent_is_on(xs_net(x));
+}
+
+void xfrm_state_account(struct xfrm_state *x, unsigned int len, bool locked);
+
+void xfrm_replay_window_init(struct xfrm_state *x);
+void xfrm_replay_window_load(struct xfrm_state *x);
+void xfrm_replay_esn_snapshot(struct xfrm_state *x,
+			      struct xfrm_replay_state_esn *dst);
+int xfrm_replay_recheck_advance(struct xfrm_state *x,
+				struct sk_buff *skb, __be32 net_seq);
+int xfrm_replay_advance_lockless(struct xfrm_state *x,
+				 struct sk_buff *skb, __be32 net_seq);
+
+#endif /* _XFRM_STATE_PRIV_H */
@@ -35,6 +35,8 @@
 #endif
 #include <asm/unaligned.h>
 
+#include "xfrm_state_priv.h"
+
 static int verify_one_alg(struct nlattr **attrs, enum xfrm_attr_type_t type,
 			  struct netlink_ext_ack *extack)
 {
@@ -635,6 +637,7 @@ static void xfrm_update_ae_params(struct xfrm_state *x, struct nlattr **attrs,
 		       xfrm_replay_state_esn_len(replay_esn));
 		memcpy(x->preplay_esn, replay_esn,
 		       xfrm_replay_state_esn_len(replay_esn));
+		xfrm_replay_window_load(x);
 	}
 
 	if (rp) {
@@ -1094,6 +1097,20 @@ static int xfrm_smark_put(struct sk_buff *skb, struct xfrm_mark *m)
 	return ret;
 }
 
+/* The window in x->replay_esn lags behind the one the input path updates */
+static int xfrm_replay_esn_put(struct sk_buff *skb, struct xfrm_state *x)
+{
+	struct nlattr *attr;
+
+	attr = nla_reserve(skb, XFRMA_REPLAY_ESN_VAL,
+			   xfrm_replay_state_esn_len(x->replay_esn));
+	if (!attr)
+		return -EMSGSIZE;
+
+	xfrm_replay_esn_snapshot(x, nla_data(attr));
+	return 0;
+}
+
 /* Don't change this without updating xfrm_sa_len! */
 static int copy_to_user_state_extra(struct xfrm_state *x,
 				    struct xfrm_usersa_info *p,
@@ -1160,9 +1177,7 @@ static int copy_to_user_state_extra(struct xfrm_state *x,
 		goto out;
 
 	if (x->replay_esn)
-		ret = nla_put(skb, XFRMA_REPLAY_ESN_VAL,
-			      xfrm_replay_state_esn_len(x->replay_esn),
-			      x->replay_esn);
+		ret = xfrm_replay_esn_put(skb, x);
 	else
 		ret = nla_put(skb, XFRMA_REPLAY_VAL, sizeof(x->replay),
 			      &x->replay);
@@ -2423,9 +2438,7 @@ static int build_aevent(struct sk_buff *skb, struct xfrm_state *x, const struct
 	id->flags = c->data.aevent;
 
 	if (x->replay_esn) {
-		err = nla_put(skb, XFRMA_REPLAY_ESN_VAL,
-			      xfrm_replay_state_esn_len(x->replay_esn),
-			      x->replay_esn);
+		err = xfrm_replay_esn_put(skb, x);
 	} else {
 		err = nla_put(skb, XFRMA_REPLAY_VAL, sizeof(x->replay),
 			      &x->replay);
@@ -0,0 +1,234 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+
+# Exercise the per-CPU FDB learning cache of the bridge: entries that keep
+# being refreshed only through the cache must not age out, entries must
+# still age out once the traffic stops, roaming must still be detected,
+# and learning the same address on several CPUs must be served by the
+# per-CPU caches instead of the shared entry.
+
+ALL_TESTS="
+	ageing_refreshed
+	ageing_expired
+	roaming
+	learning_multi_cpu
+"
+NUM_NETIFS=4
+source lib.sh
+
+SRC_MAC=00:11:22:33:44:55
+AGEING_SEC=10
+
+h1_create()
+{
+	simple_if_init $h1 192.0.2.1/24
+}
+
+h1_destroy()
+{
+	simple_if_fini $h1 192.0.2.1/24
+}
+
+h2_create()
+{
+	simple_if_init $h2 192.0.2.2/24
+}
+
+h2_destroy()
+{
+	simple_if_fini $h2 192.0.2.2/24
+}
+
+switch_create()
+{
+	ip link add dev br0 type bridge \
+		ageing_time $((AGEING_SEC * 100))
+
+	ip link set dev $swp1 master br0
+	ip link set dev $swp2 master br0
+
+	ip link set dev br0 up
+	ip link set dev $swp1 up
+	ip link set dev $swp2 up
+}
+
+switch_destroy()
+{
+	ip link set dev $swp2 down
+	ip link set dev $swp1 down
+
+	ip link del dev br0
+}
+
+setup_prepare()
+{
+	h1=${NETIFS[p1]}
+	swp1=${NETIFS[p2]}
+
+	swp2=${NETIFS[p3]}
+	h2=${NETIFS[p4]}
+
+	vrf_prepare
+
+	h1_create
+	h2_create
+
+	switch_create
+}
+
+cleanup()
+{
+	pre_cleanup
+
+	switch_destroy
+
+	h2_destroy
+	h1_destroy
+
+	vrf_cleanup
+}
+
+learn_cache_hits()
+{
+	cat /sys/class/net/br0/bridge/fdb_learn_cache_hits
+}
+
+fdb_entry_port()
+{
+	bridge fdb show br br0 | grep -i "$SRC_MAC" | grep -v permanent | \
+		awk '{ print $3 }'
+}
+
+# $1: interface, $2: duration in seconds
+send_from()
+{
+	local dev=$1; shift
+	local sec=$1; shift
+
+	timeout $sec $MZ $dev -c 0 -d 1msec -a $SRC_MAC -b bcast \
+		-t udp "sp=54321,dp=12345" -q &
+}
+
+ageing_refreshed()
+{
+	RET=0
+
+	# Keep the address active for longer than the ageing time: the
+	# shared entry timestamp is only refreshed lazily, the cleanup
+	# must merge the per-CPU state instead of deleting the entry.
+	send_from $h1 $((AGEING_SEC * 2))
+	sleep $((AGEING_SEC * 2 - 2))
+
+	[[ $(fdb_entry_port) == $swp1 ]]
+	check_err $? "Active entry aged out"
+
+	wait
+	log_test "Active FDB entry is kept"
+}
+
+ageing_expired()
+{
+	RET=0
+
+	send_from $h1 2
+	wait
+
+	[[ $(fdb_entry_port) == $swp1 ]]
+	check_err $? "Entry not learned"
+
+	sleep $((AGEING_SEC + 3))
+
+	[[ -z $(fdb_entry_port) ]]
+	check_err $? "Inactive entry not aged out"
+
+	log_test "Inactive FDB entry ages out"
+}
+
+roaming()
+{
+	RET=0
+
+	send_from $h1 3
+	wait
+	[[ $(fdb_entry_port) == $swp1 ]]
+	check_err $? "Entry not learned on $swp1"
+
+	# The learn cache slots of the old port must not hide the move.
+	send_from $h2 1
+	wait
+	[[ $(fdb_entry_port) == $swp2 ]]
+	check_err $? "Entry did not roam to $swp2"
+
+	log_test "FDB entry roaming"
+}
+
+learning_multi_cpu()
+{
+	local cpus=$(nproc)
+	local t0 t1 hits0 hits1 notifs
+	local mon mon_pid pids=()
+
+	RET=0
+
+	if (( cpus < 2 )); then
+		log_test_skip "Learning from several CPUs" "Needs at least 2 CPUs"
+		return
+	fi
+	(( cpus > 4 )) && cpus=4
+
+	if [[ ! -r /sys/class/net/br0/bridge/fdb_learn_cache_hits ]]; then
+		log_test_skip "Learning from several CPUs" \
+			"No FDB learn cache counters"
+		return
+	fi
+
+	bridge fdb flush dev $swp1
+	mon=$(mktemp)
+	bridge monitor fdb > $mon &
+	mon_pid=$!
+	sleep 1
+
+	# The same address is learned from every CPU at once: each CPU
+	# fills its own cache slot, but the shared entry must be created
+	# once and must not be reported again while it stays on $swp1.
+	# Nearly every frame must be learned from the CPU local slot; a
+	# slot is refilled from the shared entry at most once per second.
+	hits0=$(learn_cache_hits)
+	t0=$(link_stats_tx_packets_get $swp2)
+	for ((cpu = 0; cpu < cpus; cpu++)); do
+		taskset -c $cpu timeout 5 $MZ $h1 -c 0 -d 100usec \
+			-a $SRC_MAC -b bcast -t udp "sp=54321,dp=12345" -q &
+		pids+=($!)
+	done
+	wait ${pids[@]}
+	t1=$(link_stats_tx_packets_get $swp2)
+	hits1=$(learn_cache_hits)
+	sleep 1
+
+	kill $mon_pid && wait $mon_pid 2>/dev/null
+
+	(( t1 > t0 ))
+	check_err $? "No traffic forwarded"
+
+	[[ $(fdb_entry_port) == $swp1 ]]
+	check_err $? "Entry not learned on $swp1"
+
+	(( (hits1 - hits0) * 2 > t1 - t0 ))
+	check_err $? "Only $((hits1 - hits0)) learn cache hits for $((t1 - t0)) frames"
+
+	notifs=$(grep -i "$SRC_MAC" $mon | grep -vc permanent)
+	(( notifs == 1 ))
+	check_err $? "Expected one FDB notification, got $notifs"
+
+	rm -f $mon
+	log_test "Learning from several CPUs"
+}
+
+trap cleanup EXIT
+
+setup_prepare
+setup_wait
+
+tests_run
+
+exit $EXIT_STATUS
@@ -39,6 +39,12 @@ extern int optind;
 #ifndef TCP_ULP
 #define TCP_ULP 31
 #endif
+#ifndef SOL_MPTCP
+#define SOL_MPTCP 284
+#endif
+#ifndef MPTCP_SCHEDULER
+#define MPTCP_SCHEDULER 4
+#endif
 
 static int  poll_timeout = 10 * 1000;
 static bool listen_mode;
@@ -71,6 +77,7 @@ static unsigned int cfg_do_w;
 static int cfg_wait;
 static uint32_t cfg_mark;
 static char *cfg_input;
+static const char *cfg_sched;
 static int cfg_repeat = 1;
 static int cfg_truncate;
 static int cfg_rcv_trunc;
@@ -107,7 +114,7 @@ static void die_usage(void)
 {
 	fprintf(stderr, "Usage: mptcp_connect [-6] [-c cmsg] [-f offset] [-i file] [-I num] [-j] [-l] "
 		"[-m mode] [-M mark] [-o option] [-p port] [-P mode] [-r num] [-R num] "
-		"[-s MPTCP|TCP] [-S num] [-t num] [-T num] [-w sec] connect_address\n");
+		"[-s MPTCP|TCP] [-S num] [-t num] [-T num] [-w sec] [-x sched] connect_address\n");
 	fprintf(stderr, "\t-6 use ipv6\n");
 	fprintf(stderr, "\t-c cmsg -- test cmsg type <cmsg>\n");
 	fprintf(stderr, "\t-f offset -- stop the I/O after receiving and sending the specified amount "
@@ -134,6 +141,7 @@ static void die_usage(void)
 	fprintf(stderr, "\t-t num -- set poll timeout to num\n");
 	fprintf(stderr, "\t-T num -- set expected runtime to num ms\n");
 	fprintf(stderr, "\t-w num -- wait num sec before closing the socket\n");
+	fprintf(stderr, "\t-x sched -- set the MPTCP packet scheduler of the connection\n");
 	exit(1);
 }
 
@@ -224,6 +232,17 @@ static void set_mark(int fd, uint32_t mark)
 	}
 }
 
+static void set_sched(int fd, const char *name)
+{
+	int err;
+
+	err = setsockopt(fd, SOL_MPTCP, MPTCP_SCHEDULER, name, strlen(name));
+	if (err) {
+		perror("set MPTCP_SCHEDULER");
+		exit(1);
+	}
+}
+
 static void set_transparent(int fd, int pf)
 {
 	int one = 1;
@@ -1107,6 +1126,9 @@ int main_loop_s(int listensock)
 
 		SOCK_TEST_TCPULP(remotesock, 0);
 
+		if (cfg_sched)
+			set_sched(remotesock, cfg_sched);
+
 		memset(&winfo, 0, sizeof(winfo));
 		copyfd_io(fd, remotesock, 1, true, &winfo);
 	} else {
@@ -1270,6 +1292,8 @@ int main_loop(void)
 		set_rcvbuf(fd, cfg_rcvbuf);
 	if (cfg_sndbuf)
 		set_sndbuf(fd, cfg_sndbuf);
+	if (cfg_sched)
+		set_sched(fd, cfg_sched);
 	if (cfg_cmsg_types.cmsg_enabled)
 		apply_cmsg_types(fd, &cfg_cmsg_types);
 
@@ -1387,7 +1411,7 @@ static void parse_opts(int argc, char **argv)
 {
 	int c;
 
-	while ((c = getopt(argc, argv, "6c:f:hi:I:jlm:M:o:p:P:r:R:s:S:t:T:w:")) != -1) {
+	while ((c = getopt(argc, argv, "6c:f:hi:I:jlm:M:o:p:P:r:R:s:S:t:T:w:x:")) != -1) {
 		switch (c) {
 		case 'f':
 			cfg_truncate = atoi(optarg);
@@ -1465,6 +1489,9 @@ static void parse_opts(int argc, char **argv)
 		case 'o':
 			parse_setsock_options(optarg);
 			break;
+		case 'x':
+			cfg_sched = optarg;
+			break;
 		}
 	}
 
@@ -0,0 +1,234 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Compare the in-kernel MPTCP packet schedulers over two paths with
+# different delays: goodput of a bulk transfer and tail latency of many
+# short transfers.
+
+. "$(dirname "${0}")/mptcp_lib.sh"
+
+sec=$(date +%s)
+rndh=$(printf %x $sec)-$(mktemp -u XXXXXX)
+ns1="ns1-$rndh"
+ns2="ns2-$rndh"
+ns3="ns3-$rndh"
+ksft_skip=4
+timeout_poll=30
+timeout_test=$((timeout_poll * 2 + 1))
+test_cnt=1
+short_runs=20
+ret=0
+
+cleanup()
+{
+	rm -f "$cout" "$sout" "$large" "$small" "$times"
+
+	local netns
+	for netns in "$ns1" "$ns2" "$ns3";do
+		ip netns del $netns
+	done
+}
+
+mptcp_lib_check_mptcp
+
+ip -Version > /dev/null 2>&1
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not run test without ip tool"
+	exit $ksft_skip
+fi
+
+#  "$ns1"              ns2                    ns3
+#     ns1eth1    ns2eth1   ns2eth3      ns3eth1
+#            netem
+#     ns1eth2    ns2eth2
+#            netem
+
+setup()
+{
+	large=$(mktemp)
+	small=$(mktemp)
+	sout=$(mktemp)
+	cout=$(mktemp)
+	times=$(mktemp)
+
+	dd if=/dev/zero of=$small bs=1024 count=4 >/dev/null 2>&1
+	dd if=/dev/zero of=$large bs=4096 count=2048 >/dev/null 2>&1
+
+	trap cleanup EXIT
+
+	for i in "$ns1" "$ns2" "$ns3";do
+		ip netns add $i || exit $ksft_skip
+		ip -net $i link set lo up
+		ip netns exec $i sysctl -q net.ipv4.conf.all.rp_filter=0
+		ip netns exec $i sysctl -q net.ipv4.conf.default.rp_filter=0
+	done
+
+	ip link add ns1eth1 netns "$ns1" type veth peer name ns2eth1 netns "$ns2"
+	ip link add ns1eth2 netns "$ns1" type veth peer name ns2eth2 netns "$ns2"
+	ip link add ns2eth3 netns "$ns2" type veth peer name ns3eth1 netns "$ns3"
+
+	ip -net "$ns1" addr add 10.0.1.1/24 dev ns1eth1
+	ip -net "$ns1" link set ns1eth1 up mtu 1500
+	ip -net "$ns1" route add default via 10.0.1.2
+
+	ip -net "$ns1" addr add 10.0.2.1/24 dev ns1eth2
+	ip -net "$ns1" link set ns1eth2 up mtu 1500
+	ip -net "$ns1" route add default via 10.0.2.2 metric 101
+
+	ip netns exec "$ns1" ./pm_nl_ctl limits 1 1
+	ip netns exec "$ns1" ./pm_nl_ctl add 10.0.2.1 dev ns1eth2 flags subflow
+
+	ip -net "$ns2" addr add 10.0.1.2/24 dev ns2eth1
+	ip -net "$ns2" link set ns2eth1 up mtu 1500
+	ip -net "$ns2" addr add 10.0.2.2/24 dev ns2eth2
+	ip -net "$ns2" link set ns2eth2 up mtu 1500
+	ip -net "$ns2" addr add 10.0.3.2/24 dev ns2eth3
+	ip -net "$ns2" link set ns2eth3 up mtu 1500
+	ip netns exec "$ns2" sysctl -q net.ipv4.ip_forward=1
+
+	ip -net "$ns3" addr add 10.0.3.3/24 dev ns3eth1
+	ip -net "$ns3" link set ns3eth1 up mtu 1500
+	ip -net "$ns3" route add default via 10.0.3.2
+
+	ip netns exec "$ns3" ./pm_nl_ctl limits 1 1
+
+	# a fast, low delay path and a slow, high delay, lossy one
+	tc -n $ns1 qdisc add dev ns1eth1 root netem rate 20mbit delay 5ms
+	tc -n $ns1 qdisc add dev ns1eth2 root netem rate 20mbit delay 40ms loss 1%
+	tc -n $ns2 qdisc add dev ns2eth1 root netem rate 20mbit delay 5ms
+	tc -n $ns2 qdisc add dev ns2eth2 root netem rate 20mbit delay 40ms loss 1%
+}
+
+# $1: ns, $2: port
+wait_local_port_listen()
+{
+	local listener_ns="${1}"
+	local port="${2}"
+
+	local port_hex i
+
+	port_hex="$(printf "%04X" "${port}")"
+	for i in $(seq 10); do
+		ip netns exec "${listener_ns}" cat /proc/net/tcp* | \
+			awk "BEGIN {rc=1} {if (\$2 ~ /:${port_hex}\$/ && \$4 ~ /0A/) {rc=0; exit}} END {exit rc}" &&
+			break
+		sleep 0.1
+	done
+}
+
+# $1: client input, $2: server input, $3: scheduler
+# prints the transfer time in ms, returns non zero on failure
+do_transfer()
+{
+	local cin=$1
+	local sin=$2
+	local sched=$3
+	local port start end
+
+	port=$((10000+$test_cnt))
+	test_cnt=$((test_cnt+1))
+
+	:> "$cout"
+	:> "$sout"
+
+	timeout ${timeout_test} \
+		ip netns exec ${ns3} \
+			./mptcp_connect -jt ${timeout_poll} -l -p $port \
+				-x $sched 0.0.0.0 < "$sin" > "$sout" &
+	local spid=$!
+
+	wait_local_port_listen "${ns3}" "${port}"
+
+	start=$(date +%s%N)
+	timeout ${timeout_test} \
+		ip netns exec ${ns1} \
+			./mptcp_connect -jt ${timeout_poll} -p $port \
+				-x $sched 10.0.3.3 < "$cin" > "$cout" &
+	local cpid=$!
+
+	wait $cpid
+	local retc=$?
+	end=$(date +%s%N)
+	wait $spid
+	local rets=$?
+
+	echo $(((end - start) / 1000000))
+
+	[ $retc -eq 0 ] && [ $rets -eq 0 ] && \
+		cmp $sin $cout > /dev/null 2>&1 && \
+		cmp $cin $sout > /dev/null 2>&1
+}
+
+# $1: netns
+get_redundant_segs()
+{
+	ip netns exec $1 nstat -asz MPTcpExtRedundantSegs | \
+		awk 'NR==1 {next} {print $2}'
+}
+
+# $1: scheduler name
+run_test()
+{
+	local sched=$1
+	local ms goodput p90 max red
+
+	printf "%-12s" "$sched"
+
+	red=$(get_redundant_segs $ns1)
+	if ! ms=$(do_transfer $large $small $sched); then
+		echo "[ fail ] bulk transfer"
+		ret=1
+		return
+	fi
+	goodput=$(( $(stat -c %s $large) * 8 / (ms * 1000 + 1) ))
+
+	:> "$times"
+	for i in $(seq $short_runs); do
+		if ! ms=$(do_transfer $small $small $sched); then
+			echo "[ fail ] short transfer $i"
+			ret=1
+			return
+		fi
+		echo $ms >> "$times"
+	done
+	p90=$(sort -n "$times" | awk -v n=$short_runs 'NR == int(n * 0.9) { print }')
+	max=$(sort -n "$times" | tail -n 1)
+	red=$(( $(get_redundant_segs $ns1) - red ))
+
+	printf "goodput %5d mbit/s  short p90 %5d ms max %5d ms" $goodput $p90 $max
+
+	# only the redundant scheduler sends copies
+	if [ "$sched" = "redundant" ] && [ $red -eq 0 ]; then
+		echo "  [ fail ] no redundant segment sent"
+		ret=1
+		return
+	elif [ "$sched" != "redundant" ] && [ $red -ne 0 ]; then
+		echo "  [ fail ] $red redundant segments sent"
+		ret=1
+		return
+	fi
+	echo "  [ OK ]"
+}
+
+setup
+
+for sched in default redundant wrr; do
+	if ! ip netns exec $ns1 sysctl -q net.mptcp.scheduler=$sched; then
+		echo "SKIP: scheduler $sched not available"
+		exit $ksft_skip
+	fi
+done
+
+if ip netns exec $ns1 sysctl -q net.mptcp.scheduler=nosuchsched 2>/dev/null; then
+	echo "unknown scheduler accepted [ fail ]"
+	ret=1
+fi
+
+# the scheduler under test is picked with the MPTCP_SCHEDULER sockopt
+ip netns exec $ns1 sysctl -q net.mptcp.scheduler=default
+
+for sched in default redundant wrr; do
+	run_test $sched
+done
+
+exit $ret